@@ -0,0 +1,163 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace bench {
+
+class Timer {
+public:
+    Timer() : Start_(std::chrono::steady_clock::now()) {}
+
+    void Reset() {
+        Start_ = std::chrono::steady_clock::now();
+    }
+
+    double ElapsedSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start_).count();
+    }
+
+    uint64_t ElapsedNanos() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point Start_;
+};
+
+// Instructions retired in user space by the calling thread since Reset(), read through perf_event_open.
+// Where perf events are not permitted (containers, kernel.perf_event_paranoid) Available() is false and Read() gives 0.
+class InstructionCounter {
+public:
+    InstructionCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        Fd_ = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~InstructionCounter() {
+        if (Fd_ >= 0) {
+            ::close(Fd_);
+        }
+    }
+
+    InstructionCounter(const InstructionCounter&) = delete;
+    InstructionCounter& operator=(const InstructionCounter&) = delete;
+
+    bool Available() const {
+        return Fd_ >= 0;
+    }
+
+    void Reset() {
+        if (Fd_ >= 0) {
+            ::ioctl(Fd_, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(Fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    uint64_t Read() const {
+        uint64_t count = 0;
+        if (Fd_ < 0 || ::read(Fd_, &count, sizeof(count)) != sizeof(count)) {
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    int Fd_;
+};
+
+// Read the Index'th positional argument as a number, falling back to Default when it wasn't given
+inline uint64_t GetArg(int argc, char** argv, int Index, uint64_t Default) {
+    if (Index < argc) {
+        return std::strtoull(argv[Index], nullptr, 10);
+    }
+    return Default;
+}
+
+// Print one result row as "<name>  <ops/s>  <ns/op>"
+inline void Report(const std::string& Name, uint64_t Ops, double Seconds) {
+    std::cout << std::left << std::setw(48) << Name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(14) << (Seconds > 0 ? Ops / Seconds : 0) << " ops/s" << std::setprecision(1)
+              << std::setw(14) << (Ops > 0 ? Seconds * 1e9 / Ops : 0) << " ns/op" << std::endl;
+}
+
+// Keep the optimizer from throwing away a computed value
+template <typename T>
+inline void DoNotOptimize(const T& Value) {
+    asm volatile("" : : "r,m"(Value) : "memory");
+}
+
+// xorshift64*, good enough to shuffle benchmark keys and much cheaper than <random>
+class Random {
+public:
+    explicit Random(uint64_t Seed = 0x9E3779B97F4A7C15ULL) : State_(Seed ? Seed : 1) {}
+
+    uint64_t Next() {
+        State_ ^= State_ >> 12;
+        State_ ^= State_ << 25;
+        State_ ^= State_ >> 27;
+        return State_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint64_t Uniform(uint64_t N) {
+        return Next() % N;
+    }
+
+private:
+    uint64_t State_;
+};
+
+// Zipfian distribution over [0, N) following Gray et al. "Quickly generating billion-record synthetic databases".
+// Item 0 is the most popular one, Theta close to 1 makes the distribution more skewed.
+class Zipfian {
+public:
+    Zipfian(uint64_t N, double Theta = 0.99, uint64_t Seed = 42) : N_(N), Theta_(Theta), Random_(Seed) {
+        for (uint64_t i = 1; i <= N; i++) {
+            Zetan_ += 1.0 / std::pow(static_cast<double>(i), Theta);
+        }
+        const double zeta2 = 1.0 + 1.0 / std::pow(2.0, Theta);
+        Alpha_ = 1.0 / (1.0 - Theta);
+        Eta_ = (1.0 - std::pow(2.0 / N, 1.0 - Theta)) / (1.0 - zeta2 / Zetan_);
+    }
+
+    uint64_t Next() {
+        const double u = static_cast<double>(Random_.Next() >> 11) / static_cast<double>(1ULL << 53);
+        const double uz = u * Zetan_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, Theta_)) {
+            return 1;
+        }
+        return std::min<uint64_t>(N_ - 1, static_cast<uint64_t>(N_ * std::pow(Eta_ * u - Eta_ + 1.0, Alpha_)));
+    }
+
+private:
+    uint64_t N_;
+    double Theta_;
+    double Zetan_{};
+    double Alpha_{};
+    double Eta_{};
+    Random Random_;
+};
+
+}
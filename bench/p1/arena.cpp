@@ -0,0 +1,48 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Compares the arena backed AVLTree against per node new/delete
+//
+//     bench_arena [keys] [rounds]
+//
+// Every round inserts the same shuffled keys and then clears the tree, like a memtable being refilled after a flush
+
+template <typename Tree>
+void Run(const std::string& Name, const std::vector<uint64_t>& Keys, uint64_t Rounds) {
+    Tree tree;
+    double insertSeconds = 0;
+    double clearSeconds = 0;
+    for (uint64_t round = 0; round < Rounds; round++) {
+        bench::Timer timer;
+        for (uint64_t key : Keys) {
+            tree.Put(key, key);
+        }
+        insertSeconds += timer.ElapsedSeconds();
+
+        timer.Reset();
+        tree.Clear();
+        clearSeconds += timer.ElapsedSeconds();
+    }
+
+    bench::Report(Name + " insert", Keys.size() * Rounds, insertSeconds);
+    std::cout << "    clear latency: " << (clearSeconds / Rounds) * 1e6 << " us/clear" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 1'000'000);
+    const uint64_t rounds = bench::GetArg(argc, argv, 2, 5);
+
+    std::vector<uint64_t> keys(numKeys);
+    bench::Random rng;
+    for (uint64_t& key : keys) {
+        key = rng.Next();
+    }
+
+    std::cout << numKeys << " keys, " << rounds << " rounds" << std::endl;
+    Run<p1::AVLTree<uint64_t, uint64_t, p1::HeapAllocator>>("new/delete", keys, rounds);
+    Run<p1::AVLTree<uint64_t, uint64_t, p1::Arena>>("arena", keys, rounds);
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "../bench.hpp"
+#include "p1/art.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Adaptive radix tree against the AVLTree for 64-bit keys
+//
+//     bench_art [keys] [lookups] [scans] [scan length]
+//
+// Each tree gets the same inserts, hitting lookups and short range scans for three key distributions: dense (0..n-1,
+// inner nodes fill up to Node256), sparse (multiples of 2^20, long shared prefixes) and random (uniform 64-bit).
+// Inserts go in random order for all three.
+
+namespace {
+
+template <typename Tree>
+void Run(const std::string& Name, const std::vector<uint64_t>& Keys, const std::vector<uint64_t>& Lookups,
+         const std::vector<uint64_t>& Starts, uint64_t Width) {
+    Tree tree;
+    bench::Timer timer;
+    for (uint64_t key : Keys) {
+        tree.Put(key, key);
+    }
+    bench::Report(Name + " insert", Keys.size(), timer.ElapsedSeconds());
+
+    timer.Reset();
+    uint64_t sum = 0;
+    for (uint64_t key : Lookups) {
+        sum += *tree.Find(key);
+    }
+    bench::DoNotOptimize(sum);
+    bench::Report(Name + " lookup", Lookups.size(), timer.ElapsedSeconds());
+
+    timer.Reset();
+    uint64_t entries = 0;
+    for (uint64_t start : Starts) {
+        tree.Scan(start, start + Width, [&entries](const uint64_t&, const uint64_t&) {
+            entries++;
+            return true;
+        });
+    }
+    bench::DoNotOptimize(entries);
+    bench::Report(Name + " scan", Starts.size(), timer.ElapsedSeconds());
+    std::cout << "    " << static_cast<double>(entries) / Starts.size() << " entries/scan, "
+              << tree.GetTotalDataSize() / Keys.size() << " bytes/key" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 10'000'000);
+    const uint64_t numScans = bench::GetArg(argc, argv, 3, 1'000'000);
+    const uint64_t scanLength = bench::GetArg(argc, argv, 4, 16);
+
+    struct Distribution {
+        const char* Name_;
+        uint64_t Shift_;
+        bool Random_;
+    };
+    for (const Distribution& distribution : {Distribution{"dense", 0, false}, Distribution{"sparse", 20, false},
+                                             Distribution{"random", 0, true}}) {
+        bench::Random rng;
+        std::vector<uint64_t> keys(numKeys);
+        for (uint64_t i = 0; i < numKeys; i++) {
+            keys[i] = distribution.Random_ ? rng.Next() : i << distribution.Shift_;
+        }
+        // Insert in random order
+        for (uint64_t i = numKeys - 1; i > 0; i--) {
+            std::swap(keys[i], keys[rng.Uniform(i + 1)]);
+        }
+        std::vector<uint64_t> lookups(numLookups);
+        for (uint64_t& key : lookups) {
+            key = keys[rng.Uniform(numKeys)];
+        }
+        std::vector<uint64_t> starts(numScans);
+        for (uint64_t& start : starts) {
+            start = keys[rng.Uniform(numKeys)];
+        }
+        // Wide enough for scanLength keys on average
+        const uint64_t width = distribution.Random_ ? (UINT64_MAX / numKeys) * scanLength
+                                                    : (scanLength - 1) << distribution.Shift_;
+
+        std::cout << distribution.Name_ << " keys" << std::endl;
+        Run<p1::AVLTree<uint64_t, uint64_t>>("  avl", keys, lookups, starts, width);
+        Run<p1::AdaptiveRadixTree<uint64_t, uint64_t>>("  art", keys, lookups, starts, width);
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "../bench.hpp"
+#include "p1/arena.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Insert, lookup, full traversal and destruction of the AVL tree against the recursive implementation it replaced
+//
+//     bench_avl_tree [keys] [lookups]
+//
+// The baseline below is the old recursive code on the same node layout and allocator: InsertKey recursing down and
+// recomputing every height on the way back, GetValue recursing down, InOrderTraversal passing its std::function by
+// value into every frame and FreeAVLTree recursing over both children. Both trees use the HeapAllocator so that
+// destruction really visits every node. Instructions per operation are only shown where perf events are permitted.
+
+namespace {
+
+template <typename Allocator>
+class RecursiveTree {
+public:
+    ~RecursiveTree() {
+        Free(Root_);
+    }
+
+    void Put(uint64_t Key, uint64_t Value) {
+        Root_ = Insert(Root_, Key, Value);
+    }
+
+    const uint64_t& Get(uint64_t Key) const {
+        return GetValue(Root_, Key);
+    }
+
+    void InOrderTraversal(std::function<bool(const uint64_t&, const uint64_t&)> callback) const {
+        Traverse(Root_, callback);
+    }
+
+private:
+    struct Node {
+        uint64_t Key_;
+        uint64_t Value_;
+        Node* Left_{};
+        Node* Right_{};
+        int Height_ = 1;
+        bool Deleted_{};
+    };
+
+    Node* Root_{};
+    Allocator Allocator_;
+
+    static int Height(Node* Root) {
+        return Root != nullptr ? Root->Height_ : 0;
+    }
+
+    static void Update(Node* Root) {
+        Root->Height_ = 1 + std::max(Height(Root->Left_), Height(Root->Right_));
+    }
+
+    static Node* RotateLeft(Node* Root) {
+        Node* top = Root->Right_;
+        Root->Right_ = top->Left_;
+        top->Left_ = Root;
+        Update(Root);
+        Update(top);
+        return top;
+    }
+
+    static Node* RotateRight(Node* Root) {
+        Node* top = Root->Left_;
+        Root->Left_ = top->Right_;
+        top->Right_ = Root;
+        Update(Root);
+        Update(top);
+        return top;
+    }
+
+    Node* Insert(Node* Root, uint64_t Key, uint64_t Value) {
+        if (Root == nullptr) {
+            Node* node = new (Allocator_.Allocate(sizeof(Node), alignof(Node))) Node;
+            node->Key_ = Key;
+            node->Value_ = Value;
+            return node;
+        }
+        if (Key < Root->Key_) {
+            Root->Left_ = Insert(Root->Left_, Key, Value);
+        } else if (Root->Key_ < Key) {
+            Root->Right_ = Insert(Root->Right_, Key, Value);
+        } else {
+            Root->Value_ = Value;
+            return Root;
+        }
+        Update(Root);
+        const int balance = Height(Root->Left_) - Height(Root->Right_);
+        if (balance > 1) {
+            if (Height(Root->Left_->Left_) < Height(Root->Left_->Right_)) {
+                Root->Left_ = RotateLeft(Root->Left_);
+            }
+            return RotateRight(Root);
+        }
+        if (balance < -1) {
+            if (Height(Root->Right_->Right_) < Height(Root->Right_->Left_)) {
+                Root->Right_ = RotateRight(Root->Right_);
+            }
+            return RotateLeft(Root);
+        }
+        return Root;
+    }
+
+    static const uint64_t& GetValue(Node* Root, uint64_t Key) {
+        if (Root == nullptr) {
+            throw std::runtime_error("Could not find provided key");
+        }
+        if (Key < Root->Key_) {
+            return GetValue(Root->Left_, Key);
+        }
+        if (Root->Key_ < Key) {
+            return GetValue(Root->Right_, Key);
+        }
+        return Root->Value_;
+    }
+
+    static bool Traverse(Node* Root, std::function<bool(const uint64_t&, const uint64_t&)> callback) {
+        if (Root == nullptr) {
+            return true;
+        }
+        return Traverse(Root->Left_, callback) && callback(Root->Key_, Root->Value_) &&
+               Traverse(Root->Right_, callback);
+    }
+
+    void Free(Node* Root) {
+        if (Root != nullptr) {
+            Free(Root->Left_);
+            Free(Root->Right_);
+            Allocator_.Deallocate(Root, sizeof(Node), alignof(Node));
+        }
+    }
+};
+
+template <typename Function>
+void Measure(const std::string& Name, uint64_t Ops, Function&& function) {
+    bench::InstructionCounter counter;
+    bench::Timer timer;
+    counter.Reset();
+    function();
+    const uint64_t instructions = counter.Read();
+    bench::Report(Name, Ops, timer.ElapsedSeconds());
+    if (counter.Available()) {
+        std::cout << "    " << static_cast<double>(instructions) / Ops << " instructions/op" << std::endl;
+    }
+}
+
+// Each phase runs on both trees before the next one starts, so that neither tree gets built in heap memory the other one
+// just freed
+template <typename... Trees>
+void Run(const std::vector<uint64_t>& Keys, const std::vector<uint64_t>& Lookups,
+         std::pair<std::string, std::unique_ptr<Trees>>&... Variants) {
+    auto insert = [&](auto& Variant) {
+        Measure(Variant.first + " insert", Keys.size(), [&] {
+            for (uint64_t key : Keys) {
+                Variant.second->Put(key, key);
+            }
+        });
+    };
+    auto lookup = [&](auto& Variant) {
+        Measure(Variant.first + " lookup", Lookups.size(), [&] {
+            uint64_t sum = 0;
+            for (uint64_t key : Lookups) {
+                sum += Variant.second->Get(key);
+            }
+            bench::DoNotOptimize(sum);
+        });
+    };
+    auto traverse = [&](auto& Variant) {
+        Measure(Variant.first + " traversal", Keys.size(), [&] {
+            uint64_t sum = 0;
+            Variant.second->InOrderTraversal([&sum](const uint64_t&, const uint64_t& Value) {
+                sum += Value;
+                return true;
+            });
+            bench::DoNotOptimize(sum);
+        });
+    };
+    auto free = [&](auto& Variant) { Measure(Variant.first + " free", Keys.size(), [&] { Variant.second.reset(); }); };
+
+    (insert(Variants), ...);
+    (lookup(Variants), ...);
+    (traverse(Variants), ...);
+    (free(Variants), ...);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 10'000'000);
+
+    bench::Random rng;
+    std::vector<uint64_t> keys(numKeys);
+    for (uint64_t& key : keys) {
+        key = rng.Next();
+    }
+    // Every lookup hits, so that the recursive Get never throws and only the descent is compared
+    std::vector<uint64_t> lookups(numLookups);
+    for (uint64_t& key : lookups) {
+        key = keys[rng.Uniform(numKeys)];
+    }
+
+    auto recursive = std::make_pair(std::string("recursive"), std::make_unique<RecursiveTree<p1::HeapAllocator>>());
+    auto iterative =
+        std::make_pair(std::string("iterative"), std::make_unique<p1::AVLTree<uint64_t, uint64_t, p1::HeapAllocator>>());
+    Run(keys, lookups, recursive, iterative);
+    return 0;
+}
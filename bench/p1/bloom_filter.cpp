@@ -0,0 +1,62 @@
+#include "../bench.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Negative lookup throughput against a set of SSTs, with and without bloom filters
+//
+//     bench_bloom_filter [runs] [keys per run] [lookups]
+//
+// Every run covers the same key range (like flushed memtables do) so min/max pruning can't help, and the lookups are
+// for keys that are in none of them. Each lookup probes every run, the way a read that misses everywhere would.
+
+int main(int argc, char** argv) {
+    const uint64_t numRuns = bench::GetArg(argc, argv, 1, 8);
+    const uint64_t keysPerRun = bench::GetArg(argc, argv, 2, 500'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 3, 200'000);
+    const auto dir = std::filesystem::temp_directory_path();
+
+    bench::Random rng;
+    std::vector<uint64_t> lookups(numLookups);
+    for (uint64_t& key : lookups) {
+        // Stored keys are all even
+        key = rng.Uniform(keysPerRun * numRuns) * 2 + 1;
+    }
+
+    for (size_t bitsPerKey : {0, 6, 10, 16}) {
+        p1::SSTOptions options;
+        options.BloomBitsPerKey_ = bitsPerKey;
+
+        std::vector<std::unique_ptr<p1::SSTReader<uint64_t, uint64_t>>> runs;
+        for (uint64_t run = 0; run < numRuns; run++) {
+            const std::string path = (dir / ("bench_bloom_" + std::to_string(run) + ".sst")).string();
+            p1::SSTWriter<uint64_t, uint64_t> writer(path, options);
+            for (uint64_t i = 0; i < keysPerRun; i++) {
+                writer.Add((i * numRuns + run) * 2, i);
+            }
+            writer.Finish();
+            runs.push_back(std::make_unique<p1::SSTReader<uint64_t, uint64_t>>(path));
+            std::filesystem::remove(path);
+        }
+
+        bench::Timer timer;
+        uint64_t found = 0;
+        for (uint64_t key : lookups) {
+            for (const auto& run : runs) {
+                found += run->Get(key).has_value();
+            }
+        }
+        const double seconds = timer.ElapsedSeconds();
+
+        uint64_t pageReads = 0;
+        for (const auto& run : runs) {
+            pageReads += run->GetPageReads();
+        }
+        bench::Report(bitsPerKey == 0 ? "no filter" : std::to_string(bitsPerKey) + " bits/key", numLookups, seconds);
+        std::cout << "    " << static_cast<double>(pageReads) / numLookups << " page reads/lookup, " << found
+                  << " found" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+#include "p1/bplus_tree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// B+tree against the AVLTree as memtable index for 64-bit keys
+//
+//     bench_bplus_tree [keys] [lookups] [scans] [scan length]
+//
+// Each tree gets the same inserts, hitting lookups and range scans of about scan length entries, once with keys
+// inserted in random order and once in ascending order (the common case of time ordered keys).
+
+namespace {
+
+template <typename Tree>
+void Run(const std::string& Name, const std::vector<uint64_t>& Keys, const std::vector<uint64_t>& Lookups,
+         const std::vector<uint64_t>& Starts, uint64_t Width) {
+    Tree tree;
+    bench::Timer timer;
+    for (uint64_t key : Keys) {
+        tree.Put(key, key);
+    }
+    bench::Report(Name + " insert", Keys.size(), timer.ElapsedSeconds());
+
+    timer.Reset();
+    uint64_t sum = 0;
+    for (uint64_t key : Lookups) {
+        sum += *tree.Find(key);
+    }
+    bench::DoNotOptimize(sum);
+    bench::Report(Name + " lookup", Lookups.size(), timer.ElapsedSeconds());
+
+    timer.Reset();
+    uint64_t entries = 0;
+    for (uint64_t start : Starts) {
+        tree.Scan(start, start + Width, [&entries](const uint64_t&, const uint64_t&) {
+            entries++;
+            return true;
+        });
+    }
+    bench::DoNotOptimize(entries);
+    bench::Report(Name + " scan", Starts.size(), timer.ElapsedSeconds());
+    std::cout << "    " << static_cast<double>(entries) / Starts.size() << " entries/scan, height "
+              << tree.GetHeight() << ", " << tree.GetTotalDataSize() / Keys.size() << " bytes/key" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 10'000'000);
+    const uint64_t numScans = bench::GetArg(argc, argv, 3, 1'000'000);
+    const uint64_t scanLength = bench::GetArg(argc, argv, 4, 100);
+
+    bench::Random rng;
+    std::vector<uint64_t> keys(numKeys);
+    for (uint64_t& key : keys) {
+        key = rng.Next();
+    }
+    std::vector<uint64_t> lookups(numLookups);
+    for (uint64_t& key : lookups) {
+        key = keys[rng.Uniform(numKeys)];
+    }
+    std::vector<uint64_t> starts(numScans);
+    for (uint64_t& start : starts) {
+        start = keys[rng.Uniform(numKeys)];
+    }
+    const uint64_t width = (UINT64_MAX / numKeys) * scanLength;
+
+    std::cout << "random order" << std::endl;
+    Run<p1::AVLTree<uint64_t, uint64_t>>("  avl", keys, lookups, starts, width);
+    Run<p1::BPlusTree<uint64_t, uint64_t>>("  b+tree", keys, lookups, starts, width);
+
+    std::sort(keys.begin(), keys.end());
+    std::cout << "ascending order" << std::endl;
+    Run<p1::AVLTree<uint64_t, uint64_t>>("  avl", keys, lookups, starts, width);
+    Run<p1::BPlusTree<uint64_t, uint64_t>>("  b+tree", keys, lookups, starts, width);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "../bench.hpp"
+#include "p1/buffer_pool.hpp"
+#include "p1/hash.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Point lookups from an SST with a Zipfian key popularity, through buffer pools of different sizes
+//
+//     bench_buffer_pool [keys] [lookups]
+//
+// The "fits" pool holds every page of the file, the smaller ones only hold a fraction of it, so most of the hot set
+// still hits while the long tail keeps evicting. "no pool" reads every page with pread.
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 4'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_buffer_pool.sst").string();
+
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        for (uint64_t i = 0; i < numKeys; i++) {
+            writer.Add(i, i);
+        }
+        writer.Finish();
+    }
+
+    // Scramble the popular items over the key space so that hot keys don't share pages
+    bench::Zipfian zipf(numKeys);
+    std::vector<uint64_t> lookups(numLookups);
+    for (uint64_t& key : lookups) {
+        key = p1::Mix64(zipf.Next()) % numKeys;
+    }
+
+    const uint64_t pages = p1::SSTReader<uint64_t, uint64_t>(path).GetPageCount();
+    std::cout << numKeys << " keys in " << pages << " pages, zipfian lookups" << std::endl;
+
+    auto run = [&](const std::string& Name, p1::BufferPool* Pool) {
+        p1::SSTReader<uint64_t, uint64_t> reader(path, Pool);
+        // One warm up round so that the pool starts out full
+        for (uint64_t key : lookups) {
+            bench::DoNotOptimize(reader.Get(key));
+        }
+        if (Pool != nullptr) {
+            Pool->ResetCounters();
+        }
+
+        bench::Timer timer;
+        for (uint64_t key : lookups) {
+            bench::DoNotOptimize(reader.Get(key));
+        }
+        bench::Report(Name, numLookups, timer.ElapsedSeconds());
+        if (Pool != nullptr) {
+            const double requests = Pool->GetHits() + Pool->GetMisses();
+            std::cout << "    hit rate " << 100.0 * Pool->GetHits() / requests << "%, " << Pool->GetEvictions()
+                      << " evictions" << std::endl;
+        }
+    };
+
+    run("no pool", nullptr);
+    for (uint64_t divisor : {1, 4, 16, 64}) {
+        auto pool = std::make_unique<p1::BufferPool>(std::max<uint64_t>(pages / divisor, 16));
+        run(divisor == 1 ? "pool fits (" + std::to_string(pool->GetCapacity()) + " frames)"
+                         : "pool 1/" + std::to_string(divisor) + " (" + std::to_string(pool->GetCapacity()) + " frames)",
+            pool.get());
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Loading sorted keys into an empty tree
+//
+//     bench_bulk_load [keys]
+//
+// "Put" inserts them one at a time, every insert descends the whole right spine and most of them rotate on the way
+// back up. "BulkLoad" builds the balanced tree directly. The in-order walk afterwards shows the effect of the node
+// layout: the bulk loaded nodes sit in the arena in key order.
+
+namespace {
+
+template <typename Tree>
+void Walk(const char* Name, const Tree& tree) {
+    bench::Timer timer;
+    uint64_t sum = 0;
+    tree.InOrderTraversal([&sum](const uint64_t&, const uint64_t& Value) {
+        sum += Value;
+        return true;
+    });
+    bench::DoNotOptimize(sum);
+    bench::Report(Name, tree.GetSize(), timer.ElapsedSeconds());
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+
+    std::vector<std::pair<uint64_t, uint64_t>> entries(numKeys);
+    for (uint64_t i = 0; i < numKeys; i++) {
+        entries[i] = {i * 3, i};
+    }
+
+    {
+        p1::AVLTree<uint64_t, uint64_t> tree;
+        bench::Timer timer;
+        for (const auto& [key, value] : entries) {
+            tree.Put(key, value);
+        }
+        bench::Report("Put", numKeys, timer.ElapsedSeconds());
+        std::cout << "    height " << tree.GetHeight() << std::endl;
+        Walk("    in-order walk", tree);
+    }
+
+    {
+        bench::Timer timer;
+        p1::AVLTree<uint64_t, uint64_t> tree(entries.begin(), entries.end());
+        bench::Report("BulkLoad", numKeys, timer.ElapsedSeconds());
+        std::cout << "    height " << tree.GetHeight() << std::endl;
+        Walk("    in-order walk", tree);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "../bench.hpp"
+#include "p1/memtable.hpp"
+#include "p1/skiplist.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Insert scaling of the skiplist memtable against an AVL memtable behind one mutex
+//
+//     bench_concurrent_memtable [total keys] [max threads]
+//
+// The total amount of work stays the same for every thread count, so perfect scaling halves the time per doubling
+
+using SkipListMemtable = p1::Memtable<uint64_t, uint64_t, p1::ConcurrentSkipList<uint64_t, uint64_t>>;
+using AVLMemtable = p1::Memtable<uint64_t, uint64_t>;
+
+// What callers had to do before there was a thread safe memtable
+class LockedAVLMemtable {
+public:
+    explicit LockedAVLMemtable(size_t SizeLimit) : Memtable_(SizeLimit) {}
+
+    bool Put(uint64_t Key, uint64_t Value) {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return Memtable_.Put(Key, Value);
+    }
+
+private:
+    std::mutex Mutex_;
+    AVLMemtable Memtable_;
+};
+
+template <typename Table>
+double Run(const std::vector<uint64_t>& Keys, uint64_t NumThreads) {
+    // Room for every key, a node with 8 byte keys and values is charged well under 128 bytes
+    Table table(Keys.size() * 128);
+    std::vector<std::thread> threads;
+
+    bench::Timer timer;
+    const size_t perThread = Keys.size() / NumThreads;
+    for (uint64_t t = 0; t < NumThreads; t++) {
+        threads.emplace_back([&, t] {
+            const size_t end = t + 1 == NumThreads ? Keys.size() : (t + 1) * perThread;
+            for (size_t i = t * perThread; i < end; i++) {
+                table.Put(Keys[i], i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return timer.ElapsedSeconds();
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 4'000'000);
+    const uint64_t maxThreads = bench::GetArg(argc, argv, 2, 16);
+
+    std::vector<uint64_t> keys(numKeys);
+    bench::Random rng;
+    for (uint64_t& key : keys) {
+        key = rng.Next();
+    }
+
+    std::cout << numKeys << " keys, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    for (uint64_t threads = 1; threads <= maxThreads; threads *= 2) {
+        const std::string suffix = " (" + std::to_string(threads) + " threads)";
+        bench::Report("skiplist" + suffix, numKeys, Run<SkipListMemtable>(keys, threads));
+        bench::Report("mutex + avl" + suffix, numKeys, Run<LockedAVLMemtable>(keys, threads));
+    }
+    return 0;
+}
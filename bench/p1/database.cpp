@@ -0,0 +1,72 @@
+#include "../bench.hpp"
+#include "p1/database.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Bulk load of random keys into the LSM tree followed by point lookups
+//
+//     bench_database [keys] [lookups] [memtable size in MB]
+//
+// Write throughput is measured over the whole load including the final flush and compactions, so it is the rate the
+// tree can sustain rather than the rate of filling memtables. Read amplification is reported as SST probes and page
+// reads per lookup; with Bloom filters most probes into tables that don't hold the key stop at the filter.
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 100'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const uint64_t memtableMB = bench::GetArg(argc, argv, 3, 64);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_database").string();
+    std::filesystem::remove_all(path);
+
+    p1::DatabaseOptions options;
+    options.MemtableSize_ = memtableMB << 20;
+    options.TargetFileSize_ = 32 << 20;
+    options.BaseLevelSize_ = 256 << 20;
+    // Measure the tree, not the disk flushes, bench_wal covers those
+    options.WAL_.SyncPolicy_ = p1::WALSyncPolicy::kNone;
+
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, options);
+
+    bench::Random rng;
+    bench::Timer timer;
+    for (uint64_t i = 0; i < numKeys; i++) {
+        db.Put(rng.Next() % (numKeys * 4), i);
+    }
+    const double putSeconds = timer.ElapsedSeconds();
+    db.Flush();
+    db.WaitForCompactions();
+    const double loadSeconds = timer.ElapsedSeconds();
+    bench::Report("put (foreground)", numKeys, putSeconds);
+    bench::Report("put (sustained, until compactions finish)", numKeys, loadSeconds);
+
+    const auto loaded = db.GetStats();
+    const double userBytes = static_cast<double>(numKeys) * 2 * sizeof(uint64_t);
+    std::cout << "    " << loaded.Flushes_ << " flushes, " << loaded.Compactions_ << " compactions ("
+              << loaded.TrivialMoves_ << " trivial moves), write amplification "
+              << loaded.BytesWritten_ / userBytes << ", stalled " << loaded.StallMicros_ / 1e6 << " s" << std::endl;
+    for (size_t level = 0; level < loaded.FilesPerLevel_.size(); level++) {
+        if (loaded.FilesPerLevel_[level] > 0) {
+            std::cout << "    L" << level << ": " << loaded.FilesPerLevel_[level] << " files, "
+                      << loaded.BytesPerLevel_[level] / (1 << 20) << " MB" << std::endl;
+        }
+    }
+
+    // Lookups of keys drawn from the same range as the load, about three in four of them miss
+    timer.Reset();
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < numLookups; i++) {
+        found += db.Get(rng.Next() % (numKeys * 4)).has_value();
+    }
+    bench::Report("get", numLookups, timer.ElapsedSeconds());
+    const auto read = db.GetStats();
+    std::cout << "    " << found << " found, read amplification "
+              << static_cast<double>(read.TableProbes_ - loaded.TableProbes_) / numLookups << " tables/get, "
+              << static_cast<double>(read.PageReads_ - loaded.PageReads_) / numLookups << " pages/get" << std::endl;
+
+    db.Close();
+    std::filesystem::remove_all(path);
+    return 0;
+}
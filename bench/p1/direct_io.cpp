@@ -0,0 +1,128 @@
+#include "../bench.hpp"
+#include "p1/buffer_pool.hpp"
+#include "p1/io_engine.hpp"
+#include "p1/sst.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Buffered against O_DIRECT SST I/O with the same buffer pool in front
+//
+//     bench_direct_io [entries] [lookups] [pool pages] [scans] [queue depth]
+//
+// Writes the same table both ways, then runs random point lookups and a few full scans through a buffer pool of a fixed
+// size. The file starts out of the page cache in every run. Memory is reported as the growth of the resident set (the
+// pool and the scan buffers) plus the pages of the file the kernel kept in its page cache on top, which is what direct
+// I/O gets rid of. The last run does the direct reads through an I/O engine, scans then read their batches as queue
+// depth parallel requests.
+
+namespace {
+
+size_t ResidentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+// Bytes of Path that are in the page cache
+size_t CachedBytes(const std::string& Path) {
+    p1::File file(Path, O_RDONLY);
+    p1::MappedFile map(file);
+    const size_t pages = (map.Size() + p1::kPageSize - 1) / p1::kPageSize;
+    std::vector<unsigned char> resident(pages);
+    ::mincore(const_cast<char*>(map.Data()), map.Size(), resident.data());
+    size_t cached = 0;
+    for (unsigned char page : resident) {
+        cached += page & 1;
+    }
+    return cached * p1::kPageSize;
+}
+
+void DropCache(const std::string& Path) {
+    p1::File file(Path, O_RDONLY);
+    ::posix_fadvise(file.Fd(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+void Write(const std::string& Name, const std::string& Path, bool Direct, uint64_t Entries) {
+    p1::SSTOptions options;
+    options.DirectIO_ = Direct;
+    bench::Timer timer;
+    p1::SSTWriter<uint64_t, uint64_t> writer(Path, options);
+    for (uint64_t i = 0; i < Entries; i++) {
+        writer.Add(i * 2, i);
+    }
+    writer.Finish();
+    const double seconds = timer.ElapsedSeconds();
+    bench::Report(Name + " write", Entries, seconds);
+    std::cout << "    " << writer.GetFileSize() / seconds / (1 << 20) << " MB/s, " << CachedBytes(Path) / (1 << 20)
+              << " MB left in the page cache" << (Direct && !writer.IsDirect() ? " (fell back to buffered)" : "")
+              << std::endl;
+}
+
+void Read(const std::string& Name, const std::string& Path, p1::SSTReadMode Mode, p1::IOEngine* Engine,
+          uint64_t Entries, uint64_t Lookups, uint64_t PoolPages, uint64_t Scans) {
+    DropCache(Path);
+    const size_t rssBefore = ResidentBytes();
+    p1::BufferPool pool(PoolPages);
+    p1::SSTReader<uint64_t, uint64_t> reader(Path, &pool, {true, Mode, Engine});
+
+    bench::Random rng(42);
+    bench::Timer timer;
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < Lookups; i++) {
+        found += reader.Get(rng.Uniform(Entries) * 2).has_value();
+    }
+    bench::DoNotOptimize(found);
+    bench::Report(Name + " lookup", Lookups, timer.ElapsedSeconds());
+
+    timer.Reset();
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < Scans; i++) {
+        reader.Scan(0, UINT64_MAX, [&sum](const uint64_t&, const uint64_t& Value) {
+            sum += Value;
+            return true;
+        });
+    }
+    bench::DoNotOptimize(sum);
+    const double seconds = timer.ElapsedSeconds();
+    bench::Report(Name + " full scan", Scans * Entries, seconds);
+
+    const size_t rss = ResidentBytes() - rssBefore;
+    const size_t cached = CachedBytes(Path);
+    std::cout << "    " << Scans * reader.GetPageCount() * p1::kPageSize / seconds / (1 << 20) << " MB/s scanned, "
+              << static_cast<double>(pool.GetHits()) / (pool.GetHits() + pool.GetMisses()) << " pool hit rate, rss +"
+              << rss / (1 << 20) << " MB, page cache " << cached / (1 << 20) << " MB, total "
+              << (rss + cached) / (1 << 20) << " MB" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t entries = bench::GetArg(argc, argv, 1, 5'000'000);
+    const uint64_t lookups = bench::GetArg(argc, argv, 2, 500'000);
+    const uint64_t poolPages = bench::GetArg(argc, argv, 3, 4096);
+    const uint64_t scans = bench::GetArg(argc, argv, 4, 3);
+    const uint64_t queueDepth = bench::GetArg(argc, argv, 5, 32);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_direct_io.sst").string();
+    std::cout << "pool of " << poolPages * p1::kPageSize / (1 << 20) << " MB" << std::endl;
+
+    Write("buffered", path, false, entries);
+    Write("direct", path, true, entries);
+    Read("buffered", path, p1::SSTReadMode::kPread, nullptr, entries, lookups, poolPages, scans);
+    Read("direct", path, p1::SSTReadMode::kDirect, nullptr, entries, lookups, poolPages, scans);
+    auto engine = p1::NewIOEngine(queueDepth);
+    Read(std::string("direct ") + engine->GetName(), path, p1::SSTReadMode::kDirect, engine.get(), entries, lookups,
+         poolPages, scans);
+
+    std::filesystem::remove(path);
+    return 0;
+}
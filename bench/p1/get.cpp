@@ -0,0 +1,81 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+#include "p1/memtable.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Point lookups where half of the keys are missing, the throwing Get against the exception free variants
+//
+//     bench_get [keys] [lookups]
+//
+// The tree holds the even numbers below 2 * keys, every other lookup asks for an odd one. "get, catch" is how callers
+// had to test for a miss before, every miss throws and unwinds. The other rows report misses through the return value.
+
+namespace {
+
+template <typename Lookup>
+void Run(const std::string& Name, const std::vector<uint64_t>& Keys, Lookup&& lookup) {
+    bench::Timer timer;
+    uint64_t sum = 0;
+    uint64_t found = 0;
+    for (uint64_t key : Keys) {
+        if (const std::optional<uint64_t> value = lookup(key)) {
+            sum += *value;
+            found++;
+        }
+    }
+    bench::DoNotOptimize(sum);
+    bench::Report(Name, Keys.size(), timer.ElapsedSeconds());
+    std::cout << "    " << 100.0 * found / Keys.size() << "% hits" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 1'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 10'000'000);
+
+    p1::AVLTree<uint64_t, uint64_t> tree;
+    p1::Memtable<uint64_t, uint64_t> memtable(numKeys * p1::AVLTree<uint64_t, uint64_t>::EntrySize(0, 0));
+    // Insert in random order so that the tree isn't built from a sorted run
+    bench::Random rng;
+    std::vector<uint64_t> keys(numKeys);
+    for (uint64_t i = 0; i < numKeys; i++) {
+        keys[i] = i * 2;
+    }
+    for (uint64_t i = numKeys - 1; i > 0; i--) {
+        std::swap(keys[i], keys[rng.Uniform(i + 1)]);
+    }
+    for (uint64_t key : keys) {
+        tree.Put(key, key);
+        memtable.Put(key, key);
+    }
+
+    std::vector<uint64_t> lookups(numLookups);
+    for (uint64_t& key : lookups) {
+        key = rng.Uniform(numKeys * 2);
+    }
+
+    Run("avl get, catch", lookups, [&](uint64_t Key) -> std::optional<uint64_t> {
+        try {
+            return tree.Get(Key);
+        } catch (const std::runtime_error&) {
+            return std::nullopt;
+        }
+    });
+    Run("avl find", lookups, [&](uint64_t Key) -> std::optional<uint64_t> {
+        const uint64_t* value = tree.Find(Key);
+        return value != nullptr ? std::optional<uint64_t>(*value) : std::nullopt;
+    });
+    Run("avl try get", lookups, [&](uint64_t Key) { return tree.TryGet(Key); });
+    Run("avl lookup", lookups, [&](uint64_t Key) -> std::optional<uint64_t> {
+        uint64_t value;
+        return tree.Lookup(Key, &value) == p1::LookupStatus::kFound ? std::optional<uint64_t>(value) : std::nullopt;
+    });
+    Run("memtable get", lookups, [&](uint64_t Key) { return memtable.Get(Key); });
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../bench.hpp"
+#include "p1/aligned_buffer.hpp"
+#include "p1/file.hpp"
+#include "p1/io_engine.hpp"
+
+#include <fcntl.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Random page reads at queue depths 1 to 64, through io_uring and the thread pool fallback
+//
+//     bench_io_engine [file size in MB] [reads per depth]
+//
+// Reads are 4 KiB at random page offsets of a file opened with O_DIRECT, so that every one of them goes to the device.
+// The first line is the baseline: one blocking pread after the other.
+
+namespace {
+
+void Run(const std::string& Name, p1::IOEngine* Engine, size_t Depth, const p1::File& Source, uint64_t Pages,
+         uint64_t Reads) {
+    p1::AlignedBuffer buffers(Depth * p1::kPageSize);
+    std::vector<p1::ReadRequest> requests(Depth);
+    bench::Random rng(42);
+    bench::Timer timer;
+    for (uint64_t done = 0; done < Reads; done += Depth) {
+        for (size_t i = 0; i < Depth; i++) {
+            requests[i] = {&Source, buffers.Data() + i * p1::kPageSize, p1::kPageSize, rng.Uniform(Pages) * p1::kPageSize};
+        }
+        if (Engine != nullptr) {
+            Engine->Read(requests.data(), Depth);
+        } else {
+            Source.Read(requests[0].Buffer_, p1::kPageSize, requests[0].Offset_);
+        }
+    }
+    const double seconds = timer.ElapsedSeconds();
+    bench::Report(Name + " qd " + std::to_string(Depth), Reads, seconds);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t sizeMB = bench::GetArg(argc, argv, 1, 512);
+    const uint64_t reads = bench::GetArg(argc, argv, 2, 20'000);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_io_engine.dat").string();
+    const uint64_t pages = (sizeMB << 20) / p1::kPageSize;
+
+    {
+        p1::File file = p1::File::OpenDirect(path, O_WRONLY | O_CREAT | O_TRUNC);
+        p1::AlignedBuffer chunk(1 << 20);
+        std::memset(chunk.Data(), 'x', chunk.Size());
+        for (uint64_t offset = 0; offset < (sizeMB << 20); offset += chunk.Size()) {
+            file.Write(chunk.Data(), chunk.Size(), offset);
+        }
+        file.Sync();
+    }
+    p1::File source = p1::File::OpenDirect(path, O_RDONLY);
+    std::cout << (source.IsDirect() ? "O_DIRECT" : "buffered (no O_DIRECT support)") << " reads" << std::endl;
+
+    Run("pread", nullptr, 1, source, pages, reads);
+    for (size_t depth : {1, 2, 4, 8, 16, 32, 64}) {
+        std::vector<std::unique_ptr<p1::IOEngine>> engines;
+#if defined(P1_HAVE_IO_URING)
+        try {
+            engines.push_back(std::make_unique<p1::UringIOEngine>(depth));
+        } catch (const std::system_error& error) {
+            std::cout << "io_uring unavailable: " << error.what() << std::endl;
+        }
+#endif
+        engines.push_back(std::make_unique<p1::ThreadPoolIOEngine>(depth));
+        for (auto& engine : engines) {
+            Run(engine->GetName(), engine.get(), depth, source, pages, reads);
+        }
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
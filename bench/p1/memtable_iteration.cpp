@@ -0,0 +1,59 @@
+#include "../bench.hpp"
+#include "p1/memtable.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Walking a full memtable in key order, what a flush or a merge does with it
+//
+//     bench_memtable_iteration [keys] [passes]
+//
+// "Scan into vector" is how a caller got at the entries before the iterators: copy the whole range out first.
+// "iterators" and "ForEach" stream straight out of the tree.
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t passes = bench::GetArg(argc, argv, 2, 5);
+
+    p1::Memtable<uint64_t, uint64_t> memtable(std::numeric_limits<size_t>::max());
+    bench::Random rng;
+    for (uint64_t i = 0; i < numKeys; i++) {
+        memtable.Put(rng.Next(), i);
+    }
+    const uint64_t entries = memtable.GetEntryCount();
+    std::cout << entries << " entries, " << passes << " passes" << std::endl;
+
+    bench::Timer timer;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        uint64_t sum = 0;
+        for (const auto& [key, value] : memtable.Scan(0, std::numeric_limits<uint64_t>::max())) {
+            sum += value;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    bench::Report("Scan into vector", entries * passes, timer.ElapsedSeconds());
+
+    timer.Reset();
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        uint64_t sum = 0;
+        for (auto it = memtable.begin(); it != memtable.end(); ++it) {
+            sum += it.Value();
+        }
+        bench::DoNotOptimize(sum);
+    }
+    bench::Report("iterators", entries * passes, timer.ElapsedSeconds());
+
+    timer.Reset();
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        uint64_t sum = 0;
+        memtable.ForEach([&sum](const uint64_t&, const uint64_t* value) {
+            sum += *value;
+            return true;
+        });
+        bench::DoNotOptimize(sum);
+    }
+    bench::Report("ForEach", entries * passes, timer.ElapsedSeconds());
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "../bench.hpp"
+#include "p1/memtable.hpp"
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// How well the memtable size limit bounds the memory really used, for string values of different sizes
+//
+//     bench_memtable_rss [limit in MB]
+//
+// Each run fills a Memtable<std::string, std::string> until Put refuses and compares the growth of the resident set
+// with the configured limit. The last column projects what the old sizeof(K) + sizeof(V) accounting would have let in:
+// it admits limit / 64 entries no matter how long the strings are.
+
+namespace {
+
+size_t ResidentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+void Run(size_t Limit, size_t ValueSize) {
+    ::malloc_trim(0);
+    const size_t before = ResidentBytes();
+    size_t entries = 0;
+    double rssRatio;
+    {
+        p1::Memtable<std::string, std::string> memtable(Limit);
+        const std::string value(ValueSize, 'v');
+        char key[32];
+        bench::Timer timer;
+        while (true) {
+            std::snprintf(key, sizeof(key), "key%020zu", entries * 7919);
+            if (!memtable.Put(key, value)) {
+                break;
+            }
+            entries++;
+        }
+        const double seconds = timer.ElapsedSeconds();
+        const size_t grown = ResidentBytes() - before;
+        rssRatio = static_cast<double>(grown) / Limit;
+
+        bench::Report("fill, " + std::to_string(ValueSize) + " byte values", entries, seconds);
+        std::cout << "    " << entries << " entries, charged " << memtable.GetCurrentSize() / (1 << 20) << " MB, rss +"
+                  << grown / (1 << 20) << " MB = " << rssRatio << "x the limit" << std::endl;
+    }
+
+    const double fixedEntries = static_cast<double>(Limit) / (sizeof(std::string) * 2);
+    std::cout << "    fixed size accounting would admit " << static_cast<size_t>(fixedEntries) << " entries, about "
+              << rssRatio * fixedEntries / entries << "x the limit" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t limit = bench::GetArg(argc, argv, 1, 256) << 20;
+    for (size_t valueSize : {8, 100, 1000, 4000}) {
+        Run(limit, valueSize);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "../bench.hpp"
+#include "p1/buffer_pool.hpp"
+#include "p1/io_engine.hpp"
+#include "p1/memtable.hpp"
+#include "p1/sst.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Batched point lookups against a loop of single ones, for batch sizes from 8 to 1024 keys
+//
+//     bench_multi_get [memtable keys] [sst entries] [keys per run] [pool pages] [queue depth]
+//
+// The memtable holds the even numbers below 2 * keys in random insertion order, half of the lookups miss. The SST is
+// written and read with O_DIRECT through a buffer pool much smaller than the file, so most lookups go to the device; the
+// loop reads one page after the other, MultiLookup reads the distinct pages of a batch through the I/O engine at once.
+// Every batch is drawn at random and sorted inside the timed part, the way MultiGet does it. ops/s counts keys, the
+// second line is the latency of a whole batch.
+
+namespace {
+
+template <typename Lookup>
+void Run(const std::string& Name, const std::vector<uint64_t>& Keys, size_t BatchSize, Lookup&& lookup) {
+    std::vector<uint64_t> batch(BatchSize);
+    const size_t batches = Keys.size() / BatchSize;
+    bench::Timer timer;
+    uint64_t found = 0;
+    for (size_t i = 0; i < batches; i++) {
+        std::copy_n(Keys.begin() + i * BatchSize, BatchSize, batch.begin());
+        found += lookup(batch);
+    }
+    const double seconds = timer.ElapsedSeconds();
+    bench::DoNotOptimize(found);
+    bench::Report(Name + " batch " + std::to_string(BatchSize), batches * BatchSize, seconds);
+    std::cout << "    " << seconds * 1e6 / batches << " us per batch, "
+              << 100.0 * found / (batches * BatchSize) << "% hits" << std::endl;
+}
+
+std::vector<uint64_t> RandomKeys(uint64_t Count, uint64_t Range, uint64_t Seed) {
+    bench::Random rng(Seed);
+    std::vector<uint64_t> keys(Count);
+    for (uint64_t& key : keys) {
+        key = rng.Uniform(Range);
+    }
+    return keys;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t memtableKeys = bench::GetArg(argc, argv, 1, 1'000'000);
+    const uint64_t sstEntries = bench::GetArg(argc, argv, 2, 5'000'000);
+    const uint64_t keysPerRun = bench::GetArg(argc, argv, 3, 200'000);
+    const uint64_t poolPages = bench::GetArg(argc, argv, 4, 4096);
+    const uint64_t queueDepth = bench::GetArg(argc, argv, 5, 32);
+    const size_t batchSizes[] = {8, 32, 128, 512, 1024};
+
+    p1::Memtable<uint64_t, uint64_t> memtable(memtableKeys * p1::AVLTree<uint64_t, uint64_t>::EntrySize(0, 0));
+    std::vector<uint64_t> keys(memtableKeys);
+    for (uint64_t i = 0; i < memtableKeys; i++) {
+        keys[i] = i * 2;
+    }
+    bench::Random rng;
+    for (uint64_t i = memtableKeys - 1; i > 0; i--) {
+        std::swap(keys[i], keys[rng.Uniform(i + 1)]);
+    }
+    for (uint64_t key : keys) {
+        memtable.Put(key, key);
+    }
+    keys = RandomKeys(keysPerRun, memtableKeys * 2, 2);
+    for (size_t batchSize : batchSizes) {
+        Run("memtable get loop", keys, batchSize, [&](const std::vector<uint64_t>& Batch) {
+            uint64_t found = 0;
+            for (uint64_t key : Batch) {
+                found += memtable.Get(key).has_value();
+            }
+            return found;
+        });
+        Run("memtable multi get", keys, batchSize, [&](const std::vector<uint64_t>& Batch) {
+            uint64_t found = 0;
+            for (const auto& value : memtable.MultiGet(Batch)) {
+                found += value.has_value();
+            }
+            return found;
+        });
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_multi_get.sst").string();
+    {
+        p1::SSTOptions options;
+        options.DirectIO_ = true;
+        p1::SSTWriter<uint64_t, uint64_t> writer(path, options);
+        for (uint64_t i = 0; i < sstEntries; i++) {
+            writer.Add(i * 2, i);
+        }
+        writer.Finish();
+    }
+    auto engine = p1::NewIOEngine(queueDepth);
+    p1::BufferPool pool(poolPages);
+    p1::SSTReader<uint64_t, uint64_t> reader(path, &pool, {true, p1::SSTReadMode::kDirect, engine.get()});
+    std::cout << "sst of " << reader.GetPageCount() * p1::kPageSize / (1 << 20) << " MB, pool of "
+              << poolPages * p1::kPageSize / (1 << 20) << " MB, " << engine->GetName() << " at queue depth "
+              << queueDepth << std::endl;
+
+    // Fewer keys on disk, every miss of the pool is a device read
+    keys = RandomKeys(keysPerRun / 4, sstEntries * 2, 3);
+    for (size_t batchSize : batchSizes) {
+        Run("sst lookup loop", keys, batchSize, [&](std::vector<uint64_t>& Batch) {
+            std::sort(Batch.begin(), Batch.end());
+            uint64_t found = 0;
+            uint64_t value;
+            for (uint64_t key : Batch) {
+                found += reader.Lookup(key, &value) == p1::LookupStatus::kFound;
+            }
+            return found;
+        });
+        Run("sst multi lookup", keys, batchSize, [&](std::vector<uint64_t>& Batch) {
+            std::sort(Batch.begin(), Batch.end());
+            std::vector<p1::LookupStatus> statuses(Batch.size(), p1::LookupStatus::kNotFound);
+            std::vector<uint64_t> values(Batch.size());
+            reader.MultiLookup(Batch.data(), Batch.size(), statuses.data(), values.data());
+            return static_cast<uint64_t>(std::count(statuses.begin(), statuses.end(), p1::LookupStatus::kFound));
+        });
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
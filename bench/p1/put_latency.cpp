@@ -0,0 +1,63 @@
+#include "../bench.hpp"
+#include "p1/database.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Latency of single Puts while memtables keep filling up and being flushed
+//
+//     bench_put_latency [keys] [memtable size in KB]
+//
+// The load is run once per cap on the number of immutable memtables. With a cap of 1 every switch has to wait for
+// the flush of the previous memtable, with more a write burst keeps going into fresh memtables while older ones are
+// flushed, so the tail percentiles show how often writers stall.
+
+namespace {
+
+void Run(const std::string& Path, uint64_t NumKeys, uint64_t MemtableKB, size_t MaxImmutables) {
+    std::filesystem::remove_all(Path);
+    p1::DatabaseOptions options;
+    options.MemtableSize_ = MemtableKB << 10;
+    options.MaxImmutableMemtables_ = MaxImmutables;
+    options.WAL_.SyncPolicy_ = p1::WALSyncPolicy::kNone;
+
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(Path, options);
+
+    bench::Random rng;
+    std::vector<uint64_t> nanos(NumKeys);
+    bench::Timer total;
+    for (uint64_t i = 0; i < NumKeys; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        db.Put(rng.Next(), i);
+        nanos[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    const double seconds = total.ElapsedSeconds();
+    const auto stats = db.GetStats();
+    db.Close();
+    std::filesystem::remove_all(Path);
+
+    std::sort(nanos.begin(), nanos.end());
+    auto percentile = [&](double P) { return nanos[std::min<uint64_t>(NumKeys - 1, NumKeys * P)]; };
+    bench::Report("put, " + std::to_string(MaxImmutables) + " immutable memtables", NumKeys, seconds);
+    std::cout << "    p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.9 "
+              << percentile(0.999) << " ns, max " << nanos.back() / 1000 << " us, " << stats.Flushes_
+              << " flushes, stalled " << stats.StallMicros_ / 1000 << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t memtableKB = bench::GetArg(argc, argv, 2, 4096);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_put_latency").string();
+
+    for (size_t maxImmutables : {1, 2, 4}) {
+        Run(path, numKeys, memtableKB, maxImmutables);
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Narrow range scans over a large tree
+//
+//     bench_scan [keys] [scan length] [scans]
+//
+// "full traversal" is how Scan used to work: walk in order from the smallest key and filter, so it is only run for
+// a handful of scans. "seek + walk" is the cursor based Scan, "streaming" additionally skips building the vector.
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t scanLength = bench::GetArg(argc, argv, 2, 16);
+    const uint64_t numScans = bench::GetArg(argc, argv, 3, 1'000'000);
+
+    p1::AVLTree<uint64_t, uint64_t> tree;
+    bench::Random rng;
+    for (uint64_t i = 0; i < numKeys; i++) {
+        tree.Put(rng.Next() % (numKeys * 4), i);
+    }
+
+    std::vector<uint64_t> starts(numScans);
+    for (uint64_t& start : starts) {
+        start = rng.Uniform(numKeys * 4);
+    }
+    // Every key range of this width holds scanLength keys on average
+    const uint64_t width = scanLength * 4;
+    std::cout << numKeys << " keys, ~" << scanLength << " keys per scan" << std::endl;
+
+    const uint64_t fullScans = std::min<uint64_t>(numScans, 10);
+    bench::Timer timer;
+    for (uint64_t i = 0; i < fullScans; i++) {
+        const uint64_t key1 = starts[i];
+        const uint64_t key2 = key1 + width;
+        std::vector<std::pair<uint64_t, uint64_t>> result;
+        tree.InOrderTraversal([&](const uint64_t& key, const uint64_t& value) {
+            if (key >= key1 && key <= key2) {
+                result.emplace_back(key, value);
+            }
+            return key <= key2;
+        });
+        bench::DoNotOptimize(result.size());
+    }
+    bench::Report("full traversal", fullScans, timer.ElapsedSeconds());
+
+    timer.Reset();
+    for (uint64_t start : starts) {
+        bench::DoNotOptimize(tree.Scan(start, start + width).size());
+    }
+    bench::Report("seek + walk into vector", numScans, timer.ElapsedSeconds());
+
+    timer.Reset();
+    for (uint64_t start : starts) {
+        uint64_t sum = 0;
+        tree.Scan(start, start + width, [&sum](const uint64_t&, const uint64_t& value) {
+            sum += value;
+            return true;
+        });
+        bench::DoNotOptimize(sum);
+    }
+    bench::Report("seek + walk streaming", numScans, timer.ElapsedSeconds());
+    return 0;
+}
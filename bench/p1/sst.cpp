@@ -0,0 +1,55 @@
+#include "../bench.hpp"
+#include "p1/memtable.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Flush throughput of a full memtable and point lookups served from the resulting SST
+//
+//     bench_sst [memtable size in MB] [lookups]
+//
+// The file is written to the system temp directory, lookups mostly hit the page cache after the flush
+
+int main(int argc, char** argv) {
+    const uint64_t memtableMB = bench::GetArg(argc, argv, 1, 64);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_sst.sst").string();
+
+    p1::Memtable<uint64_t, uint64_t> memtable(memtableMB << 20);
+    bench::Random rng;
+    std::vector<uint64_t> keys;
+    while (true) {
+        const uint64_t key = rng.Next();
+        if (!memtable.Put(key, key)) {
+            break;
+        }
+        keys.push_back(key);
+    }
+
+    bench::Timer timer;
+    const uint64_t entries = p1::FlushMemtable(memtable, path);
+    const double flushSeconds = timer.ElapsedSeconds();
+    bench::Report("flush", entries, flushSeconds);
+    std::cout << "    " << std::filesystem::file_size(path) / flushSeconds / (1 << 20) << " MB/s" << std::endl;
+
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    timer.Reset();
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < numLookups; i++) {
+        found += reader.Get(keys[rng.Uniform(keys.size())]).has_value();
+    }
+    bench::Report("point lookup (hit)", numLookups, timer.ElapsedSeconds());
+    std::cout << "    " << static_cast<double>(reader.GetPageReads()) / numLookups << " page reads/lookup, " << found
+              << " found" << std::endl;
+
+    timer.Reset();
+    for (uint64_t i = 0; i < numLookups; i++) {
+        found += reader.Get(rng.Next()).has_value();
+    }
+    bench::Report("point lookup (random key)", numLookups, timer.ElapsedSeconds());
+
+    std::filesystem::remove(path);
+    return 0;
+}
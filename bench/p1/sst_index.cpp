@@ -0,0 +1,64 @@
+#include "../bench.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Page reads per point lookup with the B+tree index (with and without pinned index pages) against plain binary search
+// over the data pages
+//
+//     bench_sst_index [entries] [lookups]
+//
+// Both files hold the same 8 byte keys and values. Lookups mostly hit the page cache, so the time column shows CPU cost
+// per page while the page read column is what a cold cache would pay in I/Os.
+
+namespace {
+
+void Run(const std::string& Name, const p1::SSTReader<uint64_t, uint64_t>& Reader, uint64_t Entries,
+         uint64_t Lookups) {
+    bench::Random rng(42);
+    const uint64_t before = Reader.GetPageReads();
+    bench::Timer timer;
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < Lookups; i++) {
+        found += Reader.Get(rng.Uniform(Entries) * 2).has_value();
+    }
+    bench::Report(Name, Lookups, timer.ElapsedSeconds());
+    std::cout << "    " << static_cast<double>(Reader.GetPageReads() - before) / Lookups << " page reads/lookup, "
+              << found << " found" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t entries = bench::GetArg(argc, argv, 1, 20'000'000);
+    const uint64_t lookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const std::string indexedPath = (std::filesystem::temp_directory_path() / "bench_sst_index.sst").string();
+    const std::string flatPath = (std::filesystem::temp_directory_path() / "bench_sst_flat.sst").string();
+
+    {
+        // No bloom filters, every lookup hits and has to go all the way down
+        p1::SSTWriter<uint64_t, uint64_t> indexed(indexedPath, {0, true});
+        p1::SSTWriter<uint64_t, uint64_t> flat(flatPath, {0, false});
+        for (uint64_t i = 0; i < entries; i++) {
+            indexed.Add(i * 2, i);
+            flat.Add(i * 2, i);
+        }
+        indexed.Finish();
+        flat.Finish();
+        std::cout << indexed.GetPageCount() << " data pages, " << indexed.GetIndexLevels() << " index levels, "
+                  << (indexed.GetFileSize() - flat.GetFileSize()) / p1::kPageSize << " index pages" << std::endl;
+    }
+
+    p1::SSTReader<uint64_t, uint64_t> binarySearch(flatPath);
+    p1::SSTReader<uint64_t, uint64_t> indexed(indexedPath);
+    p1::SSTReader<uint64_t, uint64_t> pinned(indexedPath, nullptr, {true});
+    Run("binary search", binarySearch, entries, lookups);
+    Run("index", indexed, entries, lookups);
+    Run("index, pinned", pinned, entries, lookups);
+
+    std::filesystem::remove(indexedPath);
+    std::filesystem::remove(flatPath);
+    return 0;
+}
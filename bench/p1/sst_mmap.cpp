@@ -0,0 +1,87 @@
+#include "../bench.hpp"
+#include "p1/sst.hpp"
+
+#include <fcntl.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// pread against mmap reads of the same SST, for point lookups and a full scan, with the file warm and cold in the page
+// cache
+//
+//     bench_sst_mmap [entries] [lookups] [cold lookups]
+//
+// Cold runs drop the file from the page cache (POSIX_FADV_DONTNEED) right after the reader is opened, so every page is
+// read from the device once. Neither mode uses the buffer pool, pread goes through a private page buffer.
+
+namespace {
+
+void DropCache(const std::string& Path) {
+    p1::File file(Path, O_RDONLY);
+    ::posix_fadvise(file.Fd(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+void Run(const std::string& Name, const std::string& Path, p1::SSTReadMode Mode, bool Cold, uint64_t Entries,
+         uint64_t Lookups) {
+    {
+        p1::SSTReader<uint64_t, uint64_t> reader(Path, nullptr, {true, Mode});
+        if (Cold) {
+            DropCache(Path);
+        }
+        bench::Random rng(42);
+        bench::Timer timer;
+        uint64_t found = 0;
+        for (uint64_t i = 0; i < Lookups; i++) {
+            found += reader.Get(rng.Uniform(Entries) * 2).has_value();
+        }
+        bench::DoNotOptimize(found);
+        bench::Report(Name + " lookup", Lookups, timer.ElapsedSeconds());
+    }
+
+    p1::SSTReader<uint64_t, uint64_t> reader(Path, nullptr, {true, Mode});
+    if (Cold) {
+        DropCache(Path);
+    }
+    bench::Timer timer;
+    uint64_t sum = 0;
+    reader.Scan(0, UINT64_MAX, [&sum](const uint64_t&, const uint64_t& Value) {
+        sum += Value;
+        return true;
+    });
+    bench::DoNotOptimize(sum);
+    const double seconds = timer.ElapsedSeconds();
+    bench::Report(Name + " full scan", Entries, seconds);
+    std::cout << "    " << reader.GetPageCount() * p1::kPageSize / seconds / (1 << 20) << " MB/s" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t entries = bench::GetArg(argc, argv, 1, 20'000'000);
+    const uint64_t lookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const uint64_t coldLookups = bench::GetArg(argc, argv, 3, 20'000);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_sst_mmap.sst").string();
+
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        for (uint64_t i = 0; i < entries; i++) {
+            writer.Add(i * 2, i);
+        }
+        writer.Finish();
+        std::cout << writer.GetFileSize() / (1 << 20) << " MB, " << writer.GetIndexLevels() << " index levels"
+                  << std::endl;
+    }
+
+    // Warm up the page cache for the warm runs
+    Run("warm-up pread", path, p1::SSTReadMode::kPread, false, entries, 0);
+    std::cout << "warm" << std::endl;
+    Run("  pread", path, p1::SSTReadMode::kPread, false, entries, lookups);
+    Run("  mmap", path, p1::SSTReadMode::kMmap, false, entries, lookups);
+    std::cout << "cold" << std::endl;
+    Run("  pread", path, p1::SSTReadMode::kPread, true, entries, coldLookups);
+    Run("  mmap", path, p1::SSTReadMode::kMmap, true, entries, coldLookups);
+
+    std::filesystem::remove(path);
+    return 0;
+}
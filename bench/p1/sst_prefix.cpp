@@ -0,0 +1,100 @@
+#include "../bench.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Prefix compressed data pages against the flat layout, for tenant/table/row string keys
+//
+//     bench_sst_prefix [entries] [lookups] [scans]
+//
+// The keys are spread over 100 tenants with 20 tables each, rows are numbered within their table, and every value is
+// 24 bytes. The same entries are written flat and with restart points every 4, 16 and 64 keys. Lookups and scans read
+// through a mapping that is warm after the first scan, so their columns show the CPU cost of each layout. A cold read
+// pays one I/O per page in every layout, and compressed tables need fewer pages.
+
+namespace {
+
+std::string Key(uint64_t I, uint64_t Entries) {
+    const uint64_t rowsPerTable = std::max<uint64_t>(Entries / 2000, 1);
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "tenant%04llu/table%02llu/row%012llu",
+                  static_cast<unsigned long long>(I / rowsPerTable / 20),
+                  static_cast<unsigned long long>(I / rowsPerTable % 20),
+                  static_cast<unsigned long long>(I % rowsPerTable));
+    return buffer;
+}
+
+void Run(const std::string& Name, const std::string& Path, size_t RestartInterval, const std::vector<std::string>& Keys,
+         uint64_t Lookups, uint64_t Scans, uint64_t FlatSize) {
+    bench::Timer timer;
+    {
+        p1::SSTOptions options;
+        options.RestartInterval_ = RestartInterval;
+        p1::SSTWriter<std::string, std::string> writer(Path, options);
+        for (const std::string& key : Keys) {
+            writer.Add(key, std::string(24, 'v'));
+        }
+        writer.Finish();
+    }
+    bench::Report(Name + " write", Keys.size(), timer.ElapsedSeconds());
+
+    p1::SSTReader<std::string, std::string> reader(Path, nullptr, {true, p1::SSTReadMode::kMmap});
+    const uint64_t size = std::filesystem::file_size(Path);
+    std::cout << "    " << size / (1 << 20) << " MB, " << reader.GetPageCount() << " data pages, "
+              << static_cast<double>(size) / Keys.size() << " bytes/entry";
+    if (FlatSize > 0) {
+        std::cout << ", " << 100.0 - 100.0 * size / FlatSize << "% smaller than flat";
+    }
+    std::cout << std::endl;
+
+    uint64_t entries = 0;
+    timer.Reset();
+    for (uint64_t i = 0; i < Scans; i++) {
+        reader.Scan(Keys.front(), Keys.back(), [&entries](const std::string&, const std::string&) {
+            entries++;
+            return true;
+        });
+    }
+    bench::DoNotOptimize(entries);
+    bench::Report(Name + " full scan", entries, timer.ElapsedSeconds());
+
+    bench::Random rng(42);
+    uint64_t found = 0;
+    timer.Reset();
+    for (uint64_t i = 0; i < Lookups; i++) {
+        const std::string& key = Keys[rng.Uniform(Keys.size())];
+        // Every other lookup asks for a key that is not there
+        found += reader.Get(i % 2 == 0 ? key : key + "x").has_value();
+    }
+    bench::DoNotOptimize(found);
+    bench::Report(Name + " lookup", Lookups, timer.ElapsedSeconds());
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t entries = bench::GetArg(argc, argv, 1, 2'000'000);
+    const uint64_t lookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const uint64_t scans = bench::GetArg(argc, argv, 3, 3);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_sst_prefix.sst").string();
+
+    std::vector<std::string> keys;
+    keys.reserve(entries);
+    for (uint64_t i = 0; i < entries; i++) {
+        keys.push_back(Key(i, entries));
+    }
+    std::cout << "keys like " << keys[entries / 2] << std::endl;
+
+    Run("flat", path, 0, keys, lookups, scans, 0);
+    const uint64_t flatSize = std::filesystem::file_size(path);
+    for (size_t interval : {4, 16, 64}) {
+        Run("restart " + std::to_string(interval), path, interval, keys, lookups, scans, flatSize);
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
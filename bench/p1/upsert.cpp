@@ -0,0 +1,110 @@
+#include "../bench.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Update heavy counters workload: 90% of the writes overwrite a key that is already there
+//
+//     bench_upsert [writes] [lookups]
+//
+// "upsert" is the in-place overwrite. "duplicate nodes" is how the tree used to behave, every write adding a node in
+// front of the older versions of its key; it is modelled with (key, version) pairs so the tree does the same work.
+// The last two rows put freshly built 64 byte strings, copied into the tree or moved.
+
+namespace {
+
+using Key = std::pair<uint64_t, uint64_t>;
+
+// The workload: every tenth write is a new key, the others hit a uniformly chosen existing one
+std::vector<uint64_t> MakeWrites(uint64_t Writes) {
+    bench::Random rng;
+    std::vector<uint64_t> keys;
+    keys.reserve(Writes);
+    uint64_t distinct = 0;
+    for (uint64_t i = 0; i < Writes; i++) {
+        if (distinct == 0 || rng.Uniform(10) == 0) {
+            keys.push_back(bench::Random(++distinct).Next());
+        } else {
+            keys.push_back(keys[rng.Uniform(i)]);
+        }
+    }
+    return keys;
+}
+
+template <typename TreeType>
+void ReportMemory(const TreeType& Tree) {
+    std::cout << "    " << Tree.GetSize() << " nodes, " << Tree.GetAllocatedMemory() / (1 << 20) << " MB allocated"
+              << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numWrites = bench::GetArg(argc, argv, 1, 10'000'000);
+    const uint64_t numLookups = bench::GetArg(argc, argv, 2, 1'000'000);
+    const std::vector<uint64_t> writes = MakeWrites(numWrites);
+    bench::Random rng(7);
+
+    {
+        p1::AVLTree<uint64_t, uint64_t> tree;
+        bench::Timer timer;
+        uint64_t updates = 0;
+        for (uint64_t i = 0; i < numWrites; i++) {
+            updates += tree.Put(writes[i], i) == p1::PutResult::kUpdated;
+        }
+        bench::Report("upsert", numWrites, timer.ElapsedSeconds());
+        ReportMemory(tree);
+        std::cout << "    " << 100.0 * updates / numWrites << "% updates" << std::endl;
+
+        timer.Reset();
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < numLookups; i++) {
+            sum += tree.Get(writes[rng.Uniform(numWrites)]);
+        }
+        bench::DoNotOptimize(sum);
+        bench::Report("upsert, get", numLookups, timer.ElapsedSeconds());
+    }
+
+    {
+        p1::AVLTree<Key, uint64_t> tree;
+        bench::Timer timer;
+        for (uint64_t i = 0; i < numWrites; i++) {
+            // Newer versions sort first, like duplicates inserted to the left
+            tree.Put({writes[i], ~i}, i);
+        }
+        bench::Report("duplicate nodes", numWrites, timer.ElapsedSeconds());
+        ReportMemory(tree);
+
+        timer.Reset();
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < numLookups; i++) {
+            const uint64_t key = writes[rng.Uniform(numWrites)];
+            tree.Scan({key, 0}, {key, ~0ULL}, [&sum](const Key&, const uint64_t& Value) {
+                sum += Value;
+                return false;
+            });
+        }
+        bench::DoNotOptimize(sum);
+        bench::Report("duplicate nodes, get newest", numLookups, timer.ElapsedSeconds());
+    }
+
+    for (bool move : {false, true}) {
+        p1::AVLTree<uint64_t, std::string> tree;
+        bench::Timer timer;
+        for (uint64_t i = 0; i < numWrites; i++) {
+            std::string value(64, static_cast<char>('a' + i % 26));
+            if (move) {
+                tree.Put(writes[i], std::move(value));
+            } else {
+                tree.Put(writes[i], value);
+            }
+        }
+        bench::Report(move ? "upsert, 64 byte strings, moved" : "upsert, 64 byte strings, copied", numWrites,
+                      timer.ElapsedSeconds());
+        std::cout << "    " << tree.GetTotalDataSize() / (1 << 20) << " MB of entries" << std::endl;
+    }
+    return 0;
+}
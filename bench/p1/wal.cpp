@@ -0,0 +1,66 @@
+#include "../bench.hpp"
+#include "p1/wal.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Commits per second of the write-ahead log for 1 to 64 writer threads under every sync policy
+//
+//     bench_wal [commits per run] [record size]
+//
+// With kEveryWrite each commit waits for an fdatasync, group commit is what lets the throughput grow with the number
+// of writers. The group size column is the average number of records that shared one write.
+
+namespace {
+
+void Run(const std::string& Path, p1::WALSyncPolicy Policy, const char* Name, int Threads, uint64_t Commits,
+         size_t RecordSize) {
+    p1::WriteAheadLog log(Path, {Policy, 10});
+    const std::string record(RecordSize, 'r');
+    std::atomic<int64_t> remaining{static_cast<int64_t>(Commits)};
+
+    bench::Timer timer;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; t++) {
+        threads.emplace_back([&] {
+            while (remaining.fetch_sub(1, std::memory_order_relaxed) > 0) {
+                log.AddRecord(record);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = timer.ElapsedSeconds();
+    log.Close();
+
+    bench::Report(std::string(Name) + ", " + std::to_string(Threads) + " threads", log.GetRecords(), seconds);
+    std::cout << "    group size " << static_cast<double>(log.GetRecords()) / log.GetWrites() << ", "
+              << log.GetSyncs() << " syncs" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t commits = bench::GetArg(argc, argv, 1, 20'000);
+    const uint64_t recordSize = bench::GetArg(argc, argv, 2, 100);
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_wal.log").string();
+
+    const std::pair<p1::WALSyncPolicy, const char*> policies[] = {
+        {p1::WALSyncPolicy::kEveryWrite, "sync every write"},
+        {p1::WALSyncPolicy::kInterval, "sync every 10 ms"},
+        {p1::WALSyncPolicy::kNone, "no sync"},
+    };
+    for (const auto& [policy, name] : policies) {
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            Run(path, policy, name, threads, commits, recordSize);
+        }
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
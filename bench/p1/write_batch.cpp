@@ -0,0 +1,82 @@
+#include "../bench.hpp"
+#include "p1/database.hpp"
+#include "p1/memtable.hpp"
+#include "p1/write_batch.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Write batches of different sizes against single puts, into a bare memtable and into the database
+//
+//     bench_write_batch [keys]
+//
+// Memtable: a batch pays one size check and applies its keys sorted. Database: a batch is one log record and one trip
+// through the lock instead of one per key. Building the batch is part of the measured time.
+
+namespace {
+
+std::vector<uint64_t> RandomKeys(uint64_t NumKeys) {
+    bench::Random rng;
+    std::vector<uint64_t> keys(NumKeys);
+    for (uint64_t& key : keys) {
+        key = rng.Next();
+    }
+    return keys;
+}
+
+template <typename Target>
+void Load(Target& target, const std::vector<uint64_t>& Keys, uint64_t BatchSize) {
+    if (BatchSize == 0) {
+        for (uint64_t key : Keys) {
+            target.Put(key, key);
+        }
+        return;
+    }
+    p1::WriteBatch<uint64_t, uint64_t> batch;
+    for (size_t i = 0; i < Keys.size(); i += BatchSize) {
+        batch.Clear();
+        for (size_t j = i; j < std::min<size_t>(i + BatchSize, Keys.size()); j++) {
+            batch.Put(Keys[j], Keys[j]);
+        }
+        target.Write(batch);
+    }
+}
+
+std::string Name(const std::string& Target, uint64_t BatchSize) {
+    return Target + (BatchSize == 0 ? " single puts" : " batches of " + std::to_string(BatchSize));
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t numKeys = bench::GetArg(argc, argv, 1, 4'000'000);
+    const std::vector<uint64_t> keys = RandomKeys(numKeys);
+    const std::vector<uint64_t> batchSizes = {0, 1, 16, 256, 4096};
+
+    for (uint64_t batchSize : batchSizes) {
+        p1::Memtable<uint64_t, uint64_t> memtable(std::numeric_limits<size_t>::max());
+        bench::Timer timer;
+        Load(memtable, keys, batchSize);
+        bench::Report(Name("memtable", batchSize), numKeys, timer.ElapsedSeconds());
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "bench_write_batch").string();
+    for (uint64_t batchSize : batchSizes) {
+        std::filesystem::remove_all(path);
+        p1::DatabaseOptions options;
+        options.MemtableSize_ = 64 << 20;
+        // Measure the write path, not the disk flushes, bench_wal covers those
+        options.WAL_.SyncPolicy_ = p1::WALSyncPolicy::kNone;
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, options);
+        bench::Timer timer;
+        Load(db, keys, batchSize);
+        bench::Report(Name("database", batchSize), numKeys, timer.ElapsedSeconds());
+        db.Close();
+    }
+    std::filesystem::remove_all(path);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "file.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Page aligned heap memory, which is what reads and writes on a file opened with O_DIRECT have to go through
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(size_t Size)
+        : Data_(static_cast<char*>(::operator new(Size, std::align_val_t(kPageSize)))), Size_(Size) {}
+
+    ~AlignedBuffer() {
+        Free();
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    AlignedBuffer(AlignedBuffer&& Other) noexcept
+        : Data_(std::exchange(Other.Data_, nullptr)), Size_(std::exchange(Other.Size_, 0)) {}
+
+    AlignedBuffer& operator=(AlignedBuffer&& Other) noexcept {
+        if (this != &Other) {
+            Free();
+            Data_ = std::exchange(Other.Data_, nullptr);
+            Size_ = std::exchange(Other.Size_, 0);
+        }
+        return *this;
+    }
+
+    char* Data() const {
+        return Data_;
+    }
+
+    size_t Size() const {
+        return Size_;
+    }
+
+private:
+    char* Data_{};
+    size_t Size_{};
+
+    void Free() {
+        if (Data_ != nullptr) {
+            ::operator delete(Data_, std::align_val_t(kPageSize));
+            Data_ = nullptr;
+        }
+    }
+};
+
+// Hands out aligned buffers of one size and takes them back for reuse, so that every scan does not allocate and fault
+// in a fresh read-ahead buffer. At most MaxIdle buffers are kept around, the rest are freed when they come back.
+// Safe to use from several threads at once.
+class AlignedBufferPool {
+public:
+    // A buffer on loan from the pool, returned when the lease goes away
+    class Lease {
+    public:
+        Lease() = default;
+
+        Lease(AlignedBufferPool* Pool, AlignedBuffer Buffer) : Pool_(Pool), Buffer_(std::move(Buffer)) {}
+
+        ~Lease() {
+            Release();
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        Lease(Lease&& Other) noexcept : Pool_(std::exchange(Other.Pool_, nullptr)), Buffer_(std::move(Other.Buffer_)) {}
+
+        Lease& operator=(Lease&& Other) noexcept {
+            if (this != &Other) {
+                Release();
+                Pool_ = std::exchange(Other.Pool_, nullptr);
+                Buffer_ = std::move(Other.Buffer_);
+            }
+            return *this;
+        }
+
+        // nullptr for an empty lease
+        char* Data() const {
+            return Buffer_.Data();
+        }
+
+    private:
+        AlignedBufferPool* Pool_{};
+        AlignedBuffer Buffer_;
+
+        void Release() {
+            if (Pool_ != nullptr) {
+                Pool_->Return(std::move(Buffer_));
+                Pool_ = nullptr;
+            }
+        }
+    };
+
+    explicit AlignedBufferPool(size_t BufferSize, size_t MaxIdle = 4) : BufferSize_(BufferSize), MaxIdle_(MaxIdle) {}
+
+    AlignedBufferPool(const AlignedBufferPool&) = delete;
+    AlignedBufferPool& operator=(const AlignedBufferPool&) = delete;
+
+    Lease Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            if (!Idle_.empty()) {
+                AlignedBuffer buffer = std::move(Idle_.back());
+                Idle_.pop_back();
+                return Lease(this, std::move(buffer));
+            }
+        }
+        return Lease(this, AlignedBuffer(BufferSize_));
+    }
+
+    size_t GetBufferSize() const {
+        return BufferSize_;
+    }
+
+    size_t GetIdleCount() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return Idle_.size();
+    }
+
+private:
+    const size_t BufferSize_;
+    const size_t MaxIdle_;
+    mutable std::mutex Mutex_;
+    std::vector<AlignedBuffer> Idle_;
+
+    void Return(AlignedBuffer Buffer) {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        if (Idle_.size() < MaxIdle_) {
+            Idle_.push_back(std::move(Buffer));
+        }
+    }
+};
+
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "size_of.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Allocates every node individually from the global heap.
+// This is the classic new/delete path, kept around so that callers (and benchmarks) can opt out of the arena.
+class HeapAllocator {
+public:
+    // Nodes have to be handed back one by one, so a tree cannot just drop everything at once
+    static constexpr bool kSupportsBulkReset = false;
+
+    void* Allocate(size_t Bytes, size_t Alignment) {
+        return ::operator new(Bytes, std::align_val_t(Alignment));
+    }
+
+    void Deallocate(void* Ptr, size_t /*Bytes*/, size_t Alignment) {
+        ::operator delete(Ptr, std::align_val_t(Alignment));
+    }
+
+    // Memory an allocation really occupies, including the malloc chunk overhead
+    static constexpr size_t AllocationSize(size_t Bytes, size_t /*Alignment*/) {
+        return MallocSize(Bytes);
+    }
+
+    void Reset() {}
+
+    size_t GetMemoryUsage() const {
+        return 0;
+    }
+};
+
+// Bump allocator that carves allocations out of large contiguous blocks.
+// Individual allocations are never freed, instead the whole arena is rewound with Reset(). Blocks are kept around
+// after a reset so that a memtable which is refilled after a flush does not have to go back to the allocator.
+class Arena {
+public:
+    static constexpr bool kSupportsBulkReset = true;
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+    explicit Arena(size_t BlockSize = kDefaultBlockSize) : BlockSize_(BlockSize) {}
+
+    ~Arena() {
+        Release();
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Arena(Arena&& Other) noexcept
+        : BlockSize_(Other.BlockSize_), Blocks_(std::move(Other.Blocks_)), LargeBlocks_(std::move(Other.LargeBlocks_)),
+          CurrentBlock_(Other.CurrentBlock_), Ptr_(Other.Ptr_), End_(Other.End_), MemoryUsage_(Other.MemoryUsage_) {
+        Other.Blocks_.clear();
+        Other.LargeBlocks_.clear();
+        Other.CurrentBlock_ = 0;
+        Other.Ptr_ = Other.End_ = nullptr;
+        Other.MemoryUsage_ = 0;
+    }
+
+    void* Allocate(size_t Bytes, size_t Alignment) {
+        assert((Alignment & (Alignment - 1)) == 0);
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(Ptr_) + Alignment - 1) & ~(uintptr_t(Alignment) - 1);
+        if (Ptr_ != nullptr && aligned + Bytes <= reinterpret_cast<uintptr_t>(End_)) {
+            Ptr_ = reinterpret_cast<char*>(aligned + Bytes);
+            return reinterpret_cast<void*>(aligned);
+        }
+        return AllocateSlow(Bytes, Alignment);
+    }
+
+    // Memory is only reclaimed by Reset()/Release()
+    void Deallocate(void* /*Ptr*/, size_t /*Bytes*/, size_t /*Alignment*/) {}
+
+    // Memory an allocation really occupies, allocations are packed back to back so only the alignment is lost
+    static constexpr size_t AllocationSize(size_t Bytes, size_t Alignment) {
+        return (Bytes + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    // Rewind to the first block. This is O(#blocks) at worst and does not touch any of the allocated objects, so
+    // it is up to the caller to run destructors first if they matter.
+    void Reset() {
+        for (char* block : LargeBlocks_) {
+            ::operator delete(block);
+        }
+        LargeBlocks_.clear();
+        CurrentBlock_ = 0;
+        if (Blocks_.empty()) {
+            Ptr_ = End_ = nullptr;
+        } else {
+            Ptr_ = Blocks_[0];
+            End_ = Blocks_[0] + BlockSize_;
+        }
+        MemoryUsage_ = Blocks_.size() * BlockSize_;
+    }
+
+    // Hand every block back to the heap
+    void Release() {
+        for (char* block : Blocks_) {
+            ::operator delete(block);
+        }
+        for (char* block : LargeBlocks_) {
+            ::operator delete(block);
+        }
+        Blocks_.clear();
+        LargeBlocks_.clear();
+        CurrentBlock_ = 0;
+        Ptr_ = End_ = nullptr;
+        MemoryUsage_ = 0;
+    }
+
+    // Bytes currently reserved from the heap
+    size_t GetMemoryUsage() const {
+        return MemoryUsage_;
+    }
+
+private:
+    size_t BlockSize_;
+    std::vector<char*> Blocks_;
+    // Allocations that do not fit in a regular block get their own, these are freed on Reset()
+    std::vector<char*> LargeBlocks_;
+    size_t CurrentBlock_{};
+    char* Ptr_{};
+    char* End_{};
+    size_t MemoryUsage_{};
+
+    void* AllocateSlow(size_t Bytes, size_t Alignment) {
+        // Anything bigger than a quarter block would waste too much of the remaining space
+        if (Bytes + Alignment > BlockSize_ / 4) {
+            char* block = static_cast<char*>(::operator new(Bytes + Alignment));
+            LargeBlocks_.push_back(block);
+            MemoryUsage_ += Bytes + Alignment;
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + Alignment - 1) & ~(uintptr_t(Alignment) - 1);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        // Move on to the next block, reusing ones that survived a Reset()
+        if (Ptr_ != nullptr) {
+            CurrentBlock_++;
+        }
+        if (CurrentBlock_ >= Blocks_.size()) {
+            Blocks_.push_back(static_cast<char*>(::operator new(BlockSize_)));
+            MemoryUsage_ += BlockSize_;
+        }
+        Ptr_ = Blocks_[CurrentBlock_];
+        End_ = Ptr_ + BlockSize_;
+        return Allocate(Bytes, Alignment);
+    }
+};
+
+// Arena that can be allocated from by many threads at once.
+// The fast path is a single fetch_add on the current block, a mutex is only taken to install a new block.
+class ConcurrentArena {
+public:
+    static constexpr bool kSupportsBulkReset = true;
+    static constexpr size_t kDefaultBlockSize = 256 * 1024;
+
+    explicit ConcurrentArena(size_t BlockSize = kDefaultBlockSize) : BlockSize_(BlockSize) {}
+
+    ~ConcurrentArena() {
+        Release();
+    }
+
+    ConcurrentArena(const ConcurrentArena&) = delete;
+    ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+    // Every allocation is aligned to kAlignment, which covers anything a tree node needs
+    void* Allocate(size_t Bytes) {
+        Bytes = (Bytes + kAlignment - 1) & ~(kAlignment - 1);
+        while (true) {
+            Block* block = Current_.load(std::memory_order_acquire);
+            if (block != nullptr) {
+                const size_t offset = block->Used_.fetch_add(Bytes, std::memory_order_relaxed);
+                if (offset + Bytes <= block->Size_) {
+                    return block->Data() + offset;
+                }
+            }
+            NewBlock(block, Bytes);
+        }
+    }
+
+    // Not thread safe, all writers and readers have to be gone
+    void Reset() {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        FreeBlocks();
+        Current_.store(nullptr, std::memory_order_relaxed);
+    }
+
+    void Release() {
+        Reset();
+    }
+
+    size_t GetMemoryUsage() const {
+        return MemoryUsage_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t kAlignment = alignof(std::max_align_t);
+
+    struct alignas(kAlignment) Block {
+        Block* Prev_;
+        size_t Size_;
+        std::atomic<size_t> Used_;
+
+        char* Data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+    };
+
+    const size_t BlockSize_;
+    std::atomic<Block*> Current_{};
+    std::atomic<size_t> MemoryUsage_{};
+    std::mutex Mutex_;
+
+    void NewBlock(Block* Full, size_t Bytes) {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        // Somebody else may have beaten us to it
+        if (Current_.load(std::memory_order_relaxed) != Full) {
+            return;
+        }
+        const size_t size = std::max(BlockSize_, Bytes);
+        void* memory = ::operator new(sizeof(Block) + size);
+        Block* block = new (memory) Block{Full, size, {0}};
+        MemoryUsage_.fetch_add(sizeof(Block) + size, std::memory_order_relaxed);
+        Current_.store(block, std::memory_order_release);
+    }
+
+    void FreeBlocks() {
+        Block* block = Current_.load(std::memory_order_relaxed);
+        while (block != nullptr) {
+            Block* prev = block->Prev_;
+            block->~Block();
+            ::operator delete(block);
+            block = prev;
+        }
+        MemoryUsage_.store(0, std::memory_order_relaxed);
+    }
+};
+
+}
@@ -0,0 +1,675 @@
+#pragma once
+
+#include "arena.hpp"
+#include "size_of.hpp"
+#include "status.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace p1 {
+
+// Adaptive radix tree for fixed-width integer keys, which can be used as the index of a Memtable instead of the
+// AVLTree (Leis et al., "The Adaptive Radix Tree: ARTful Indexing for Main-Memory Databases").
+//
+// Keys are taken apart into bytes, most significant first, so the tree is ordered like the keys; signed keys get their
+// sign bit flipped to keep negative ones in front. Every inner node branches on one byte and starts out with room for
+// 4 children, growing to 16, 48 and 256 as it fills up. Chains of single child nodes are collapsed into the prefix of
+// the node below (path compression). A key is at most 8 bytes, so the whole prefix always fits into the node.
+// A lookup visits at most sizeof(K) inner nodes and does a single full key compare, at the leaf.
+//
+// Values live in leaves next to their key. Like the AVLTree it needs external synchronization, and Delete turns the
+// leaf into a tombstone instead of removing it.
+template <typename K, typename V, typename Allocator = Arena>
+class AdaptiveRadixTree {
+    static_assert(std::is_integral_v<K> && !std::is_same_v<K, bool>, "AdaptiveRadixTree keys must be integers");
+
+public:
+    // Needs external synchronization when shared between threads
+    static constexpr bool kThreadSafe = false;
+
+    AdaptiveRadixTree() = default;
+
+    ~AdaptiveRadixTree() {
+        if constexpr (!(Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<Leaf>)) {
+            Destroy(Root_);
+        }
+    }
+
+    AdaptiveRadixTree(const AdaptiveRadixTree&) = delete;
+    AdaptiveRadixTree& operator=(const AdaptiveRadixTree&) = delete;
+
+    // Insert key, or overwrite its value in place if it is already in the tree
+    PutResult Put(const K& key, const V& value) {
+        bool created = false;
+        Leaf* leaf = InsertLeaf(key, created, [&] { return NewLeaf(key, value, false); });
+        if (created) {
+            Size_++;
+            TotalDataSize_ += HeapSize<V>::Of(leaf->Value_);
+            return PutResult::kInserted;
+        }
+
+        TotalDataSize_ -= HeapSize<V>::Of(leaf->Value_);
+        leaf->Value_ = value;
+        TotalDataSize_ += HeapSize<V>::Of(leaf->Value_);
+        if (leaf->Deleted_) {
+            // Writing over a tombstone brings the key back
+            leaf->Deleted_ = false;
+            TombstoneCount_--;
+            return PutResult::kInserted;
+        }
+        return PutResult::kUpdated;
+    }
+
+    // Turn the leaf of key into a tombstone, or insert one if the key is not in the tree.
+    // Returns false if there was no live entry for key.
+    bool Delete(const K& key) {
+        bool created = false;
+        Leaf* leaf = InsertLeaf(key, created, [&] { return NewLeaf(key, V{}, true); });
+        if (created) {
+            Size_++;
+            TombstoneCount_++;
+            return false;
+        }
+        if (leaf->Deleted_) {
+            return false;
+        }
+        TotalDataSize_ -= HeapSize<V>::Of(leaf->Value_);
+        leaf->Value_ = V{};
+        leaf->Deleted_ = true;
+        TombstoneCount_++;
+        return true;
+    }
+
+    // Throws if key is not in the tree or was deleted
+    V& Get(const K& key) {
+        return const_cast<V&>(static_cast<const AdaptiveRadixTree*>(this)->Get(key));
+    }
+
+    const V& Get(const K& key) const {
+        const V* value = Find(key);
+        if (value == nullptr) {
+            throw std::runtime_error("Could not find provided key in adaptive radix tree");
+        }
+        return *value;
+    }
+
+    // Pointer to the value of key, nullptr when it is not in the tree or was deleted
+    const V* Find(const K& key) const {
+        const Leaf* leaf = FindLeaf(key);
+        return leaf != nullptr ? VisibleValue(leaf) : nullptr;
+    }
+
+    std::optional<V> TryGet(const K& key) const {
+        if (const V* value = Find(key)) {
+            return *value;
+        }
+        return std::nullopt;
+    }
+
+    // Point lookup that tells a deleted key apart from one that was never written
+    LookupStatus Lookup(const K& key, V* value) const {
+        const Leaf* leaf = FindLeaf(key);
+        if (leaf == nullptr) {
+            return LookupStatus::kNotFound;
+        }
+        if (leaf->Deleted_) {
+            return LookupStatus::kDeleted;
+        }
+        *value = leaf->Value_;
+        return LookupStatus::kFound;
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& key1, const K& key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(key1, key2, [&](const K& key, const V& value) {
+            result.emplace_back(key, value);
+            return true;
+        });
+        return result;
+    }
+
+    // Stream every live entry in [key1, key2] to callback in order, stopping early when it returns false
+    template <typename Callback>
+    void Scan(const K& key1, const K& key2, Callback&& callback) const {
+        ScanWithTombstones(key1, key2, [&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
+    }
+
+    // Like Scan, but deleted keys are passed to callback(key, value) too, with a null value. Subtrees entirely below
+    // key1 are skipped on the way down, so this costs one descent plus the entries in range.
+    template <typename Callback>
+    void ScanWithTombstones(const K& key1, const K& key2, Callback&& callback) const {
+        if (key2 < key1 || Root_ == nullptr) {
+            return;
+        }
+        const UKey lower = Ordered(key1);
+        auto bounded = [&](const K& key, const V* value) { return !(key2 < key) && callback(key, value); };
+        Walk(Root_, 0, &lower, bounded);
+    }
+
+    // Visit every entry in key order, tombstones included as null values, until callback(key, value) returns false
+    template <typename Callback>
+    void ForEach(Callback&& callback) const {
+        if (Root_ != nullptr) {
+            Walk(Root_, 0, nullptr, callback);
+        }
+    }
+
+    // Visit every live entry in key order until callback(key, value) returns false
+    template <typename Callback>
+    void InOrderTraversal(Callback&& callback) const {
+        ForEach([&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
+    }
+
+    // Number of keys in the tree, tombstones included
+    size_t GetSize() const {
+        return Size_;
+    }
+
+    size_t GetTombstoneCount() const {
+        return TombstoneCount_;
+    }
+
+    // Memory held by the leaves and inner nodes plus whatever the values own on the heap
+    size_t GetTotalDataSize() const {
+        return TotalDataSize_;
+    }
+
+    // What inserting a new entry adds to GetTotalDataSize() at most, unless it makes an inner node grow: its leaf and
+    // the Node4 it may split off. Growing a node is rare (three times in its life at most), a memtable that charges
+    // with this can end up past its limit by the size of the larger node (with an arena the smaller one stays charged).
+    static size_t EntrySize(const K& /*key*/, const V& value) {
+        return kLeafSize + kNodeSizes[0] + HeapSize<V>::Of(value);
+    }
+
+    static size_t TombstoneSize(const K& /*key*/) {
+        return kLeafSize + kNodeSizes[0];
+    }
+
+    bool IsEmpty() const {
+        return Root_ == nullptr;
+    }
+
+    void Clear() {
+        if constexpr (!(Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<Leaf>)) {
+            Destroy(Root_);
+        }
+        Allocator_.Reset();
+        Root_ = nullptr;
+        Size_ = 0;
+        TotalDataSize_ = 0;
+        TombstoneCount_ = 0;
+    }
+
+    // Bytes the allocator is holding on to (0 when nodes come straight from the heap)
+    size_t GetAllocatedMemory() const {
+        return Allocator_.GetMemoryUsage();
+    }
+
+private:
+    using UKey = std::make_unsigned_t<K>;
+    static constexpr int kKeyBytes = sizeof(K);
+
+    enum NodeType : uint8_t {
+        kNode4,
+        kNode16,
+        kNode48,
+        kNode256,
+    };
+
+    // Children are Node pointers, leaves are told apart by a set lowest bit
+    struct Node {
+        NodeType Type_;
+        uint8_t PrefixLength_;
+        uint16_t Count_;
+        // The key bytes every key below shares from this node's depth on, before the byte it branches on
+        uint8_t Prefix_[kKeyBytes];
+    };
+
+    // Keys_ are kept sorted so that the children can be walked in order
+    struct Node4 : Node {
+        uint8_t Keys_[4];
+        Node* Children_[4];
+    };
+
+    struct Node16 : Node {
+        uint8_t Keys_[16];
+        Node* Children_[16];
+    };
+
+    // Index_[byte] is one past the slot of the child for byte, 0 when there is none
+    struct Node48 : Node {
+        uint8_t Index_[256];
+        Node* Children_[48];
+    };
+
+    struct Node256 : Node {
+        Node* Children_[256];
+    };
+
+    struct Leaf {
+        K Key_;
+        V Value_;
+        // Tombstone: the key was deleted, Value_ is default constructed and must not be read
+        bool Deleted_;
+    };
+
+    // At least 2, the lowest bit of a leaf pointer is the tag
+    static constexpr size_t kLeafAlignment = alignof(Leaf) < 2 ? 2 : alignof(Leaf);
+    static constexpr size_t kLeafSize = Allocator::AllocationSize(sizeof(Leaf), kLeafAlignment);
+    static constexpr size_t kNodeSizes[] = {
+        Allocator::AllocationSize(sizeof(Node4), alignof(Node4)),
+        Allocator::AllocationSize(sizeof(Node16), alignof(Node16)),
+        Allocator::AllocationSize(sizeof(Node48), alignof(Node48)),
+        Allocator::AllocationSize(sizeof(Node256), alignof(Node256)),
+    };
+    static constexpr size_t kNodeBytes[] = {sizeof(Node4), sizeof(Node16), sizeof(Node48), sizeof(Node256)};
+    // What NewInner allocated each type with, Deallocate has to be given the same
+    static constexpr size_t kNodeAlignments[] = {alignof(Node4), alignof(Node16), alignof(Node48), alignof(Node256)};
+
+    Node* Root_{};
+    size_t Size_{};
+    size_t TotalDataSize_{};
+    size_t TombstoneCount_{};
+    Allocator Allocator_;
+
+    static bool IsLeaf(const Node* Child) {
+        return (reinterpret_cast<uintptr_t>(Child) & 1) != 0;
+    }
+
+    static Leaf* AsLeaf(const Node* Child) {
+        return reinterpret_cast<Leaf*>(reinterpret_cast<uintptr_t>(Child) & ~uintptr_t(1));
+    }
+
+    static Node* TagLeaf(Leaf* Leaf) {
+        return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(Leaf) | 1);
+    }
+
+    // The key as an unsigned number that sorts like the key
+    static UKey Ordered(K Key) {
+        UKey ordered = static_cast<UKey>(Key);
+        if constexpr (std::is_signed_v<K>) {
+            ordered ^= UKey(1) << (kKeyBytes * 8 - 1);
+        }
+        return ordered;
+    }
+
+    static uint8_t ByteAt(UKey Key, int Depth) {
+        return static_cast<uint8_t>(Key >> ((kKeyBytes - 1 - Depth) * 8));
+    }
+
+    static const V* VisibleValue(const Leaf* Leaf) {
+        return Leaf->Deleted_ ? nullptr : &Leaf->Value_;
+    }
+
+    // The prefixes are never checked on the way down: all keys have the same length and the leaf holds the full key,
+    // so a key that left the path somewhere ends up at a leaf that doesn't match, or at a missing child
+    Leaf* FindLeaf(K Key) const {
+        const UKey ordered = Ordered(Key);
+        Node* node = Root_;
+        int depth = 0;
+        while (node != nullptr && !IsLeaf(node)) {
+            depth += node->PrefixLength_;
+            Node* const* child = FindChild(node, ByteAt(ordered, depth));
+            node = child != nullptr ? *child : nullptr;
+            depth++;
+        }
+        if (node == nullptr || AsLeaf(node)->Key_ != Key) {
+            return nullptr;
+        }
+        return AsLeaf(node);
+    }
+
+    static Node* const* FindChild(const Node* Inner, uint8_t Byte) {
+        return FindChild(const_cast<Node*>(Inner), Byte);
+    }
+
+    static Node** FindChild(Node* Inner, uint8_t Byte) {
+        switch (Inner->Type_) {
+            case kNode4: {
+                auto* node = static_cast<Node4*>(Inner);
+                for (int i = 0; i < node->Count_; i++) {
+                    if (node->Keys_[i] == Byte) {
+                        return &node->Children_[i];
+                    }
+                }
+                return nullptr;
+            }
+            case kNode16: {
+                auto* node = static_cast<Node16*>(Inner);
+#if defined(__SSE2__)
+                // Compare all 16 keys at once, the mask drops the slots past Count_
+                const __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(node->Keys_));
+                const __m128i matches = _mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(Byte)));
+                const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches)) & ((1u << node->Count_) - 1);
+                return mask != 0 ? &node->Children_[__builtin_ctz(mask)] : nullptr;
+#else
+                for (int i = 0; i < node->Count_; i++) {
+                    if (node->Keys_[i] == Byte) {
+                        return &node->Children_[i];
+                    }
+                }
+                return nullptr;
+#endif
+            }
+            case kNode48: {
+                auto* node = static_cast<Node48*>(Inner);
+                const uint8_t slot = node->Index_[Byte];
+                return slot != 0 ? &node->Children_[slot - 1] : nullptr;
+            }
+            case kNode256: {
+                auto* node = static_cast<Node256*>(Inner);
+                return node->Children_[Byte] != nullptr ? &node->Children_[Byte] : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Number of Keys smaller than Byte, where Byte goes in a sorted Node4 or Node16
+    static int LowerBound(const uint8_t* Keys, int Count, uint8_t Byte) {
+        int i = 0;
+        while (i < Count && Keys[i] < Byte) {
+            i++;
+        }
+        return i;
+    }
+
+    // Add Child for Byte to a Node4 or Node16 with room left, keeping Keys_ sorted
+    template <typename Small>
+    static void InsertSorted(Small* Target, uint8_t Byte, Node* Child) {
+        const int position = LowerBound(Target->Keys_, Target->Count_, Byte);
+        std::memmove(Target->Keys_ + position + 1, Target->Keys_ + position, Target->Count_ - position);
+        std::memmove(Target->Children_ + position + 1, Target->Children_ + position,
+                     (Target->Count_ - position) * sizeof(Child));
+        Target->Keys_[position] = Byte;
+        Target->Children_[position] = Child;
+        Target->Count_++;
+    }
+
+    // Add Child for Byte to the node *Ref points to, which must not have a child for Byte yet. A full node is replaced
+    // by one of the next size, *Ref is updated then.
+    void AddChild(Node** Ref, uint8_t Byte, Node* Child) {
+        Node* inner = *Ref;
+        switch (inner->Type_) {
+            case kNode4: {
+                auto* node = static_cast<Node4*>(inner);
+                if (node->Count_ < 4) {
+                    InsertSorted(node, Byte, Child);
+                    return;
+                }
+                auto* bigger = NewInner<Node16>(kNode16, node);
+                std::memcpy(bigger->Keys_, node->Keys_, 4);
+                std::memcpy(bigger->Children_, node->Children_, 4 * sizeof(Child));
+                bigger->Count_ = 4;
+                InsertSorted(bigger, Byte, Child);
+                FreeInner(node);
+                *Ref = bigger;
+                return;
+            }
+            case kNode16: {
+                auto* node = static_cast<Node16*>(inner);
+                if (node->Count_ < 16) {
+                    InsertSorted(node, Byte, Child);
+                    return;
+                }
+                auto* bigger = NewInner<Node48>(kNode48, node);
+                std::memset(bigger->Index_, 0, sizeof(bigger->Index_));
+                for (int i = 0; i < 16; i++) {
+                    bigger->Index_[node->Keys_[i]] = static_cast<uint8_t>(i + 1);
+                    bigger->Children_[i] = node->Children_[i];
+                }
+                bigger->Count_ = 16;
+                FreeInner(node);
+                *Ref = bigger;
+                AddChild(Ref, Byte, Child);
+                return;
+            }
+            case kNode48: {
+                auto* node = static_cast<Node48*>(inner);
+                if (node->Count_ < 48) {
+                    // Children are never removed, so the slots fill up from the front
+                    node->Children_[node->Count_] = Child;
+                    node->Index_[Byte] = static_cast<uint8_t>(node->Count_ + 1);
+                    node->Count_++;
+                    return;
+                }
+                auto* bigger = NewInner<Node256>(kNode256, node);
+                std::memset(bigger->Children_, 0, sizeof(bigger->Children_));
+                for (int byte = 0; byte < 256; byte++) {
+                    if (node->Index_[byte] != 0) {
+                        bigger->Children_[byte] = node->Children_[node->Index_[byte] - 1];
+                    }
+                }
+                bigger->Count_ = 48;
+                FreeInner(node);
+                *Ref = bigger;
+                AddChild(Ref, Byte, Child);
+                return;
+            }
+            case kNode256: {
+                auto* node = static_cast<Node256*>(inner);
+                node->Children_[Byte] = Child;
+                node->Count_++;
+                return;
+            }
+        }
+    }
+
+    // Find the leaf of Key, or link in the one Make() builds. Created tells which of the two happened.
+    template <typename MakeLeaf>
+    Leaf* InsertLeaf(K Key, bool& Created, MakeLeaf&& Make) {
+        const UKey ordered = Ordered(Key);
+        Node** ref = &Root_;
+        int depth = 0;
+        while (true) {
+            Node* node = *ref;
+            if (node == nullptr) {
+                Leaf* leaf = Make();
+                *ref = TagLeaf(leaf);
+                Created = true;
+                return leaf;
+            }
+
+            if (IsLeaf(node)) {
+                Leaf* existing = AsLeaf(node);
+                if (existing->Key_ == Key) {
+                    return existing;
+                }
+                // Two keys sharing a leaf slot: a Node4 branching on their first different byte takes its place
+                const UKey other = Ordered(existing->Key_);
+                int common = depth;
+                while (ByteAt(other, common) == ByteAt(ordered, common)) {
+                    common++;
+                }
+                auto* inner = NewInner<Node4>(kNode4, nullptr);
+                inner->PrefixLength_ = static_cast<uint8_t>(common - depth);
+                for (int i = 0; i < inner->PrefixLength_; i++) {
+                    inner->Prefix_[i] = ByteAt(ordered, depth + i);
+                }
+                Leaf* leaf = Make();
+                InsertSorted(inner, ByteAt(other, common), node);
+                InsertSorted(inner, ByteAt(ordered, common), TagLeaf(leaf));
+                *ref = inner;
+                Created = true;
+                return leaf;
+            }
+
+            int matched = 0;
+            while (matched < node->PrefixLength_ && node->Prefix_[matched] == ByteAt(ordered, depth + matched)) {
+                matched++;
+            }
+            if (matched < node->PrefixLength_) {
+                // Key leaves the compressed path: a Node4 with the shared part goes above, node keeps what follows
+                // the byte it differs in
+                auto* inner = NewInner<Node4>(kNode4, nullptr);
+                inner->PrefixLength_ = static_cast<uint8_t>(matched);
+                std::memcpy(inner->Prefix_, node->Prefix_, matched);
+                const uint8_t nodeByte = node->Prefix_[matched];
+                node->PrefixLength_ = static_cast<uint8_t>(node->PrefixLength_ - matched - 1);
+                std::memmove(node->Prefix_, node->Prefix_ + matched + 1, node->PrefixLength_);
+                Leaf* leaf = Make();
+                InsertSorted(inner, nodeByte, node);
+                InsertSorted(inner, ByteAt(ordered, depth + matched), TagLeaf(leaf));
+                *ref = inner;
+                Created = true;
+                return leaf;
+            }
+
+            depth += node->PrefixLength_;
+            const uint8_t byte = ByteAt(ordered, depth);
+            Node** child = FindChild(node, byte);
+            if (child == nullptr) {
+                Leaf* leaf = Make();
+                AddChild(ref, byte, TagLeaf(leaf));
+                Created = true;
+                return leaf;
+            }
+            ref = child;
+            depth++;
+        }
+    }
+
+    // Call Visit(byte, child) for the children of Inner with a byte >= From in order, until it returns false
+    template <typename Visit>
+    static bool ForEachChild(const Node* Inner, uint8_t From, Visit&& visit) {
+        switch (Inner->Type_) {
+            case kNode4: {
+                auto* node = static_cast<const Node4*>(Inner);
+                for (int i = LowerBound(node->Keys_, node->Count_, From); i < node->Count_; i++) {
+                    if (!visit(node->Keys_[i], node->Children_[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case kNode16: {
+                auto* node = static_cast<const Node16*>(Inner);
+                for (int i = LowerBound(node->Keys_, node->Count_, From); i < node->Count_; i++) {
+                    if (!visit(node->Keys_[i], node->Children_[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case kNode48: {
+                auto* node = static_cast<const Node48*>(Inner);
+                for (int byte = From; byte < 256; byte++) {
+                    if (node->Index_[byte] != 0 &&
+                        !visit(static_cast<uint8_t>(byte), node->Children_[node->Index_[byte] - 1])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case kNode256: {
+                auto* node = static_cast<const Node256*>(Inner);
+                for (int byte = From; byte < 256; byte++) {
+                    if (node->Children_[byte] != nullptr && !visit(static_cast<uint8_t>(byte), node->Children_[byte])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+        return true;
+    }
+
+    // In-order walk of the subtree at Child, which sits at byte Depth of the key. With a Lower bound only keys >= *Lower
+    // are visited: the walk follows Lower's bytes down and drops the bound as soon as it branches off above it.
+    // Returns false once callback asked to stop. The recursion is at most sizeof(K) deep.
+    template <typename Callback>
+    static bool Walk(const Node* Child, int Depth, const UKey* Lower, Callback& callback) {
+        if (IsLeaf(Child)) {
+            const Leaf* leaf = AsLeaf(Child);
+            if (Lower != nullptr && Ordered(leaf->Key_) < *Lower) {
+                return true;
+            }
+            return callback(static_cast<const K&>(leaf->Key_), VisibleValue(leaf));
+        }
+
+        if (Lower != nullptr) {
+            for (int i = 0; i < Child->PrefixLength_; i++) {
+                const uint8_t bound = ByteAt(*Lower, Depth + i);
+                if (Child->Prefix_[i] < bound) {
+                    return true;
+                }
+                if (Child->Prefix_[i] > bound) {
+                    Lower = nullptr;
+                    break;
+                }
+            }
+        }
+        Depth += Child->PrefixLength_;
+
+        const uint8_t from = Lower != nullptr ? ByteAt(*Lower, Depth) : 0;
+        return ForEachChild(Child, from, [&](uint8_t Byte, const Node* Next) {
+            return Walk(Next, Depth + 1, Byte == from ? Lower : nullptr, callback);
+        });
+    }
+
+    Leaf* NewLeaf(const K& Key, const V& Value, bool Deleted) {
+        void* memory = Allocator_.Allocate(sizeof(Leaf), kLeafAlignment);
+        TotalDataSize_ += kLeafSize;
+        return new (memory) Leaf{Key, Value, Deleted};
+    }
+
+    // A new inner node of type Type, with the prefix of From when given
+    template <typename Inner>
+    Inner* NewInner(NodeType Type, const Node* From) {
+        assert(sizeof(Inner) == kNodeBytes[Type] && alignof(Inner) == kNodeAlignments[Type]);
+        // Taken from the same tables FreeInner hands the node back with
+        void* memory = Allocator_.Allocate(kNodeBytes[Type], kNodeAlignments[Type]);
+        TotalDataSize_ += kNodeSizes[Type];
+        auto* node = new (memory) Inner;
+        node->Type_ = Type;
+        node->Count_ = 0;
+        node->PrefixLength_ = From != nullptr ? From->PrefixLength_ : 0;
+        if (From != nullptr) {
+            std::memcpy(node->Prefix_, From->Prefix_, From->PrefixLength_);
+        }
+        return node;
+    }
+
+    void FreeInner(Node* Inner) {
+        // An arena only gets its memory back on Clear, a node it replaced by a larger one still counts until then
+        if constexpr (!Allocator::kSupportsBulkReset) {
+            TotalDataSize_ -= kNodeSizes[Inner->Type_];
+        }
+        Allocator_.Deallocate(Inner, kNodeBytes[Inner->Type_], kNodeAlignments[Inner->Type_]);
+    }
+
+    // Release every node and leaf below Child, the recursion is at most sizeof(K) deep
+    void Destroy(Node* Child) {
+        if (Child == nullptr) {
+            return;
+        }
+        if (IsLeaf(Child)) {
+            Leaf* leaf = AsLeaf(Child);
+            leaf->~Leaf();
+            Allocator_.Deallocate(leaf, sizeof(Leaf), kLeafAlignment);
+            return;
+        }
+        ForEachChild(Child, 0, [this](uint8_t, Node* Next) {
+            Destroy(Next);
+            return true;
+        });
+        FreeInner(Child);
+    }
+};
+
+}
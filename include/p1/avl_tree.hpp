@@ -1,88 +1,491 @@
 #pragma once
 
+#include "arena.hpp"
+#include "size_of.hpp"
+#include "status.hpp"
+
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace p1 {
 
-template <typename K, typename V>
+// Allocator decides where nodes live. The default Arena packs them into contiguous blocks and lets Clear() drop the
+// whole tree at once, HeapAllocator gives the old new/delete per node behaviour.
+template <typename K, typename V, typename Allocator = Arena>
 class AVLTree {
 public:
+    // Needs external synchronization when shared between threads
+    static constexpr bool kThreadSafe = false;
+
+    // Deep enough for any AVL tree that fits in memory, the height is bounded by 1.44 * log2(n)
+    static constexpr int kMaxStackDepth = 96;
+
     struct AVLNode {
         AVLNode() = default;
-        AVLNode(const K& Key, const V& Value) : Key_(Key), Value_(Value), Height_(1) {}
+        template <typename KeyT, typename ValueT>
+        AVLNode(KeyT&& Key, ValueT&& Value)
+            : Key_(std::forward<KeyT>(Key)), Value_(std::forward<ValueT>(Value)), Height_(1) {}
         K Key_;
         V Value_;
         AVLNode* Left_{};
         AVLNode* Right_{};
         int Height_{};
+        // Tombstone: the key was deleted, Value_ is default constructed and must not be read
+        bool Deleted_{};
     };
 
-    AVLTree() : Root_(nullptr), Size_(0), TotalDataSize_(0) {}
-    
+    // Bidirectional iterator over every entry in key order, tombstones included: IsDeleted() tells them apart and their
+    // Value() must not be read. Instead of parent pointers in the nodes it carries the path from the root down to the
+    // current node, copies only copy the part of it in use.
+    // Inserting a key that was not in the tree or clearing it invalidates all iterators, overwrites and deletes of keys
+    // already in the tree don't. Entries can't be modified through it, iterator and const_iterator are the same type.
+    class const_iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = AVLNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const AVLNode*;
+        using reference = const AVLNode&;
+
+        const_iterator() = default;
+
+        const_iterator(const const_iterator& Other) : Root_(Other.Root_), Depth_(Other.Depth_) {
+            std::copy(Other.Path_, Other.Path_ + Depth_, Path_);
+        }
+
+        const_iterator& operator=(const const_iterator& Other) {
+            Root_ = Other.Root_;
+            Depth_ = Other.Depth_;
+            std::copy(Other.Path_, Other.Path_ + Depth_, Path_);
+            return *this;
+        }
+
+        reference operator*() const {
+            assert(Depth_ > 0);
+            return *Path_[Depth_ - 1];
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        const K& Key() const {
+            return (*this)->Key_;
+        }
+
+        const V& Value() const {
+            return (*this)->Value_;
+        }
+
+        bool IsDeleted() const {
+            return (*this)->Deleted_;
+        }
+
+        const_iterator& operator++() {
+            const AVLNode* node = Path_[Depth_ - 1];
+            if (node->Right_ != nullptr) {
+                PushLeftmost(node->Right_);
+                return *this;
+            }
+            // Climb until coming up out of a left subtree, that parent is next. Off the top is end()
+            const AVLNode* child;
+            do {
+                child = Path_[--Depth_];
+            } while (Depth_ > 0 && Path_[Depth_ - 1]->Right_ == child);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        // Decrementing end() gives the largest key
+        const_iterator& operator--() {
+            if (Depth_ == 0) {
+                PushRightmost(Root_);
+                return *this;
+            }
+            const AVLNode* node = Path_[Depth_ - 1];
+            if (node->Left_ != nullptr) {
+                PushRightmost(node->Left_);
+                return *this;
+            }
+            const AVLNode* child;
+            do {
+                child = Path_[--Depth_];
+            } while (Depth_ > 0 && Path_[Depth_ - 1]->Left_ == child);
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& Other) const {
+            return Current() == Other.Current();
+        }
+
+        bool operator!=(const const_iterator& Other) const {
+            return !(*this == Other);
+        }
+
+    private:
+        friend class AVLTree;
+
+        const AVLNode* Root_{};
+        const AVLNode* Path_[kMaxStackDepth];
+        int Depth_{};
+
+        explicit const_iterator(const AVLNode* Root) : Root_(Root) {}
+
+        const AVLNode* Current() const {
+            return Depth_ > 0 ? Path_[Depth_ - 1] : nullptr;
+        }
+
+        void Push(const AVLNode* Node) {
+            assert(Depth_ < kMaxStackDepth);
+            Path_[Depth_++] = Node;
+        }
+
+        void PushLeftmost(const AVLNode* Node) {
+            for (; Node != nullptr; Node = Node->Left_) {
+                Push(Node);
+            }
+        }
+
+        void PushRightmost(const AVLNode* Node) {
+            for (; Node != nullptr; Node = Node->Right_) {
+                Push(Node);
+            }
+        }
+    };
+
+    using iterator = const_iterator;
+
+    AVLTree() : Root_(nullptr), Size_(0), TotalDataSize_(0), TombstoneCount_(0) {}
+
+    // Build the tree from [first, last) in O(n), see BulkLoad
+    template <typename ForwardIt>
+    AVLTree(ForwardIt first, ForwardIt last) : AVLTree() {
+        BulkLoad(first, last);
+    }
+
     ~AVLTree() {
-        FreeAVLTree(Root_);
+        if constexpr (!(Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<AVLNode>)) {
+            FreeAVLTree(Root_);
+        }
     }
 
-    void Put(const K& key, const V& value) {
-        size_t oldSize = GetDataSize(key, value);
-        Root_ = InsertKey(Root_, key, value);
-        Size_++;
-        TotalDataSize_ += oldSize;
+    AVLTree(const AVLTree&) = delete;
+    AVLTree& operator=(const AVLTree&) = delete;
+
+    // Insert key, or overwrite its value in place if it is already in the tree. The rvalue overloads move the key
+    // into a new node and the value into the node, a moved key is left alone on update.
+    PutResult Put(const K& key, const V& value) {
+        return Upsert(key, value);
     }
 
+    PutResult Put(const K& key, V&& value) {
+        return Upsert(key, std::move(value));
+    }
+
+    PutResult Put(K&& key, V&& value) {
+        return Upsert(std::move(key), std::move(value));
+    }
+
+    // Fill an empty tree from [first, last), (key, value) pairs in strictly increasing key order. Instead of inserting
+    // them one by one, every subtree is built from the middle of its part of the range outwards, which gives a tree of
+    // minimal height without a single rotation. Nodes are allocated in key order, so with the Arena an in-order walk
+    // goes through memory front to back.
+    template <typename ForwardIt>
+    void BulkLoad(ForwardIt first, ForwardIt last) {
+        if (!IsEmpty()) {
+            throw std::logic_error("BulkLoad needs an empty AVL Tree");
+        }
+        const auto unordered = std::adjacent_find(first, last, [](const auto& A, const auto& B) {
+            return !(A.first < B.first);
+        });
+        if (unordered != last) {
+            throw std::invalid_argument("BulkLoad needs keys in strictly increasing order");
+        }
+        const size_t count = static_cast<size_t>(std::distance(first, last));
+        Root_ = BuildBalanced(first, count);
+        Size_ = count;
+    }
+
+    // Replace the value of key with a tombstone, or insert a tombstone if the key is not in the tree. The tombstone
+    // hides the key from Get and Scan and shadows older versions of it once the tree is flushed.
+    // Returns false if there was no live entry for key.
+    bool Delete(const K& key) {
+        return Tombstone(key);
+    }
+
+    bool Delete(K&& key) {
+        return Tombstone(std::move(key));
+    }
+
+    // Throws if key is not in the tree or was deleted. Where misses are common use Find, TryGet or Lookup, which
+    // report them without an exception.
     V& Get(const K& key) {
-        return GetValue(Root_, key);
+        return GetValue(key);
     }
 
-    std::vector<std::pair<K, V>> Scan(const K& key1, const K& key2) {
-        std::vector<std::pair<K, V>> result;
-        InOrderTraversal(Root_, [&](const K& key, const V& value) {
-            if (key >= key1 && key <= key2) {
-                result.emplace_back(key, value);
+    const V& Get(const K& key) const {
+        return GetValue(key);
+    }
+
+    // Pointer to the value of key, nullptr when it is not in the tree or was deleted. Stays valid until the key is
+    // deleted or the tree is cleared.
+    V* Find(const K& key) {
+        return const_cast<V*>(static_cast<const AVLTree*>(this)->Find(key));
+    }
+
+    const V* Find(const K& key) const {
+        const AVLNode* node = FindNode(key);
+        return node != nullptr ? VisibleValue(node) : nullptr;
+    }
+
+    // Copy of the value of key, nullopt when it is not in the tree or was deleted
+    std::optional<V> TryGet(const K& key) const {
+        if (const V* value = Find(key)) {
+            return *value;
+        }
+        return std::nullopt;
+    }
+
+    // Point lookup that tells a deleted key apart from one that was never written. The value is copied to *value
+    // only when it is found.
+    LookupStatus Lookup(const K& key, V* value) const {
+        const AVLNode* node = FindNode(key);
+        if (node == nullptr) {
+            return LookupStatus::kNotFound;
+        }
+        if (node->Deleted_) {
+            return LookupStatus::kDeleted;
+        }
+        *value = node->Value_;
+        return LookupStatus::kFound;
+    }
+
+    // Lookup for every key of keys[0..count) whose status in statuses is still kNotFound, keys sorted ascending. The
+    // batch goes down the tree as a whole: each node splits the keys that reach it into the ones for its left subtree,
+    // its own and the ones for its right subtree, so the path the keys have in common is walked only once. It goes one
+    // level at a time and prefetches the nodes of the next level while splitting the current one, so further down,
+    // where every key has a path of its own, the cache misses of a whole level overlap.
+    void MultiLookup(const K* keys, size_t count, LookupStatus* statuses, V* values) const {
+        std::vector<LookupGroup> level;
+        std::vector<LookupGroup> next;
+        if (Root_ != nullptr && count > 0) {
+            level.push_back({Root_, 0, count});
+        }
+        while (!level.empty()) {
+            next.clear();
+            for (const LookupGroup& group : level) {
+                const AVLNode* node = group.Node_;
+                const size_t mid = std::lower_bound(keys + group.First_, keys + group.Last_, node->Key_) - keys;
+                size_t last = mid;
+                for (; last < group.Last_ && !(node->Key_ < keys[last]); last++) {
+                    if (statuses[last] == LookupStatus::kNotFound) {
+                        if (node->Deleted_) {
+                            statuses[last] = LookupStatus::kDeleted;
+                        } else {
+                            statuses[last] = LookupStatus::kFound;
+                            values[last] = node->Value_;
+                        }
+                    }
+                }
+                if (node->Left_ != nullptr && group.First_ < mid) {
+                    __builtin_prefetch(node->Left_);
+                    next.push_back({node->Left_, group.First_, mid});
+                }
+                if (node->Right_ != nullptr && last < group.Last_) {
+                    __builtin_prefetch(node->Right_);
+                    next.push_back({node->Right_, last, group.Last_});
+                }
             }
-            return key <= key2;
+            level.swap(next);
+        }
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& key1, const K& key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(key1, key2, [&](const K& key, const V& value) {
+            result.emplace_back(key, value);
+            return true;
         });
         return result;
     }
 
-    void InOrderTraversal(std::function<bool(const K&, const V&)> callback) {
-        InOrderTraversal(Root_, callback);
+    // Stream every entry in [key1, key2] to callback in order, stopping early when it returns false.
+    // Seeks to key1 in O(log n) and then only visits the k entries in range.
+    template <typename Callback>
+    void Scan(const K& key1, const K& key2, Callback&& callback) const {
+        ScanWithTombstones(key1, key2, [&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
     }
 
+    // Like Scan, but deleted keys are passed to callback(key, value) too, with a null value
+    template <typename Callback>
+    void ScanWithTombstones(const K& key1, const K& key2, Callback&& callback) const {
+        for (const_iterator it = lower_bound(key1); it != end() && !(key2 < it.Key()); ++it) {
+            if (!callback(it.Key(), VisibleValue(&*it))) {
+                return;
+            }
+        }
+    }
+
+    // Visit every entry in key order, tombstones included as null values, until callback(key, value) returns false
+    template <typename Callback>
+    void ForEach(Callback&& callback) const {
+        for (const_iterator it = begin(); it != end(); ++it) {
+            if (!callback(it.Key(), VisibleValue(&*it))) {
+                return;
+            }
+        }
+    }
+
+    // Visit every live entry in key order until callback(key, value) returns false, deleted keys are skipped
+    template <typename Callback>
+    void InOrderTraversal(Callback&& callback) const {
+        ForEach([&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
+    }
+
+    // Iterator on the smallest key, tombstones included
+    const_iterator begin() const {
+        const_iterator it(Root_);
+        it.PushLeftmost(Root_);
+        return it;
+    }
+
+    const_iterator end() const {
+        return const_iterator(Root_);
+    }
+
+    // Iterator on the first entry with a key >= key, end() if there is none. O(log n)
+    const_iterator lower_bound(const K& key) const {
+        const_iterator it(Root_);
+        int found = 0;
+        for (const AVLNode* node = Root_; node != nullptr;) {
+            it.Push(node);
+            if (node->Key_ < key) {
+                node = node->Right_;
+            } else {
+                found = it.Depth_;
+                node = node->Left_;
+            }
+        }
+        // The path down to the last node that was not smaller is the path to the lower bound
+        it.Depth_ = found;
+        return it;
+    }
+
+    // Number of keys in the tree, tombstones included
     size_t GetSize() const {
         return Size_;
     }
 
+    size_t GetTombstoneCount() const {
+        return TombstoneCount_;
+    }
+
+    // Memory held by the entries: the nodes plus whatever the keys and values own on the heap
     size_t GetTotalDataSize() const {
         return TotalDataSize_;
     }
 
+    // What inserting a new entry adds to GetTotalDataSize()
+    static size_t EntrySize(const K& key, const V& value) {
+        return kNodeSize + HeapSize<K>::Of(key) + HeapSize<V>::Of(value);
+    }
+
+    // What inserting a new tombstone adds to GetTotalDataSize(), it carries no value payload
+    static size_t TombstoneSize(const K& key) {
+        return kNodeSize + HeapSize<K>::Of(key);
+    }
+
+    // Longest path from the root down to a leaf in nodes, 0 for an empty tree
+    int GetHeight() const {
+        return GetHeight(Root_);
+    }
+
     bool IsEmpty() const {
         return Root_ == nullptr;
     }
 
     void Clear() {
-        FreeAVLTree(Root_);
+        if constexpr (Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<AVLNode>) {
+            // Nothing to destruct, so the nodes can be dropped without ever visiting them
+            Allocator_.Reset();
+        } else {
+            FreeAVLTree(Root_);
+            Allocator_.Reset();
+        }
         Root_ = nullptr;
         Size_ = 0;
         TotalDataSize_ = 0;
+        TombstoneCount_ = 0;
     }
 
     void PrintTree() const {
         PrintAVLTree(Root_);
     }
 
+    // Bytes the allocator is holding on to (0 when nodes come straight from the heap)
+    size_t GetAllocatedMemory() const {
+        return Allocator_.GetMemoryUsage();
+    }
+
 private:
+    static constexpr size_t kNodeSize = Allocator::AllocationSize(sizeof(AVLNode), alignof(AVLNode));
+
     AVLNode* Root_;
     size_t Size_;
     size_t TotalDataSize_;
+    size_t TombstoneCount_;
+    Allocator Allocator_;
 
-    size_t GetDataSize(const K& key, const V& value) const {
-        return sizeof(K) + sizeof(V);
+    static const V* VisibleValue(const AVLNode* Node) {
+        return Node->Deleted_ ? nullptr : &Node->Value_;
     }
 
+    // Plain loop down the tree, a miss costs the compares on the way and nothing else
+    AVLNode* FindNode(const K& key) const {
+        AVLNode* node = Root_;
+        while (node != nullptr) {
+            if (key < node->Key_) {
+                node = node->Left_;
+            } else if (node->Key_ < key) {
+                node = node->Right_;
+            } else {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    // Keys [First_, Last_) of a MultiLookup that are on their way down through Node_
+    struct LookupGroup {
+        const AVLNode* Node_;
+        size_t First_;
+        size_t Last_;
+    };
+
     static void PrintAVlTree(AVLNode* Root, const std::string& Prefix = "", bool isLeft = false) {
         // Nice way of printing a tree
         // https://stackoverflow.com/questions/36802354/print-binary-tree-in-a-pretty-way-using-c
@@ -96,47 +499,155 @@ private:
     }
 
 
-    static V& GetValue(AVLNode* Root, const K& key) {
-        if (Root == nullptr) {
+    V& GetValue(const K& key) const {
+        AVLNode* node = FindNode(key);
+        if (node == nullptr) {
             throw std::runtime_error("Could not find provided key in AVL Tree");
         }
+        if (node->Deleted_) {
+            throw std::runtime_error("Provided key was deleted from AVL Tree");
+        }
+        return node->Value_;
+    }
+
+    template <typename KeyT, typename ValueT>
+    AVLNode* NewNode(KeyT&& Key, ValueT&& Value) {
+        void* memory = Allocator_.Allocate(sizeof(AVLNode), alignof(AVLNode));
+        return new (memory) AVLNode(std::forward<KeyT>(Key), std::forward<ValueT>(Value));
+    }
 
-        if (Root->Key_ > key) {
-            return GetValue(Root->Left_, key);
+    void DeleteNode(AVLNode* Node) {
+        Node->~AVLNode();
+        Allocator_.Deallocate(Node, sizeof(AVLNode), alignof(AVLNode));
+    }
+
+    template <typename KeyT, typename ValueT>
+    PutResult Upsert(KeyT&& Key, ValueT&& Value) {
+        bool created = false;
+        AVLNode* node = InsertKey(std::forward<KeyT>(Key), created, [&](auto&& NewKey) {
+            return NewNode(std::forward<decltype(NewKey)>(NewKey), std::forward<ValueT>(Value));
+        });
+        if (created) {
+            Size_++;
+            TotalDataSize_ += EntrySize(node->Key_, node->Value_);
+            return PutResult::kInserted;
         }
-        if (Root->Key_ < key) {
-            return GetValue(Root->Right_, key);
+
+        // Overwrite in place, only the change in the value's heap footprint is charged
+        TotalDataSize_ -= HeapSize<V>::Of(node->Value_);
+        node->Value_ = std::forward<ValueT>(Value);
+        TotalDataSize_ += HeapSize<V>::Of(node->Value_);
+        if (node->Deleted_) {
+            // Writing over a tombstone brings the key back
+            node->Deleted_ = false;
+            TombstoneCount_--;
+            return PutResult::kInserted;
         }
-        return Root->Value_;
+        return PutResult::kUpdated;
     }
 
-    static AVLNode* InsertKey(AVLNode* Root, const K& Key, const V& Value) {
-        if (Root == nullptr) {
-            Root = new AVLNode(Key, Value);
-            return Root;
+    template <typename KeyT>
+    bool Tombstone(KeyT&& Key) {
+        bool created = false;
+        AVLNode* node = InsertKey(std::forward<KeyT>(Key), created, [&](auto&& NewKey) {
+            AVLNode* tombstone = NewNode(std::forward<decltype(NewKey)>(NewKey), V{});
+            tombstone->Deleted_ = true;
+            return tombstone;
+        });
+        if (created) {
+            Size_++;
+            TombstoneCount_++;
+            TotalDataSize_ += TombstoneSize(node->Key_);
+            return false;
         }
-
-        // We shouldn't have duplicate keys, but we just add them to the left if it happens (according to handout)
-        if (Key <= Root->Key_) {
-            Root->Left_ = InsertKey(Root->Left_, Key, Value);
-        } else {
-            Root->Right_ = InsertKey(Root->Right_, Key, Value);
+        if (node->Deleted_) {
+            return false;
         }
 
-        // Recalculate the height of the Root
-        Root->Height_ = 1 + std::max(GetHeight(Root->Left_), GetHeight(Root->Right_));
+        // Drop the value, the node and key stay charged
+        TotalDataSize_ -= HeapSize<V>::Of(node->Value_);
+        node->Value_ = V{};
+        node->Deleted_ = true;
+        TombstoneCount_++;
+        return true;
+    }
 
-        return Rebalance(Root);
+    // Find the node holding Key, or link in the one built by MakeNode(Key) and rebalance. Returns the node either way,
+    // Created tells which of the two happened. Key is only forwarded once, into MakeNode.
+    //
+    // Iterative: the descent remembers the links it followed, and the walk back up fixes heights through them. It stops
+    // as soon as a subtree keeps its height, which is at the latest right after the first rotation.
+    template <typename KeyT, typename MakeNode>
+    AVLNode* InsertKey(KeyT&& Key, bool& Created, MakeNode&& Make) {
+        // path[i] is the link (Root_ or a child pointer) through which the i'th node on the way down was reached
+        AVLNode** path[kMaxStackDepth];
+        int depth = 0;
+        AVLNode** link = &Root_;
+        while (*link != nullptr) {
+            AVLNode* node = *link;
+            if (!(Key < node->Key_) && !(node->Key_ < Key)) {
+                return node;
+            }
+            assert(depth < kMaxStackDepth);
+            path[depth++] = link;
+            link = Key < node->Key_ ? &node->Left_ : &node->Right_;
+        }
+
+        AVLNode* node = Make(std::forward<KeyT>(Key));
+        *link = node;
+        Created = true;
+
+        while (depth > 0) {
+            AVLNode** parentLink = path[--depth];
+            AVLNode* parent = *parentLink;
+            const int height = 1 + std::max(GetHeight(parent->Left_), GetHeight(parent->Right_));
+            if (height == parent->Height_) {
+                // The new node went below the shorter side, nothing above here changes
+                break;
+            }
+            parent->Height_ = height;
+            AVLNode* balanced = Rebalance(parent);
+            *parentLink = balanced;
+            if (balanced != parent) {
+                // A rotation after an insert brings the subtree back to its old height
+                break;
+            }
+        }
+        return node;
     }
 
-    static void FreeAVLTree(AVLNode* Root) {
-        if (Root == nullptr) {
-            return;
+    // Build a tree from the next Count entries at It and advance It past them. The left subtree gets the first half and
+    // the right one the rest minus the root, so their sizes differ by at most one and so do their heights. The recursion
+    // is only log2(Count) deep.
+    template <typename ForwardIt>
+    AVLNode* BuildBalanced(ForwardIt& It, size_t Count) {
+        if (Count == 0) {
+            return nullptr;
         }
+        AVLNode* left = BuildBalanced(It, Count / 2);
+        AVLNode* node = NewNode(It->first, It->second);
+        TotalDataSize_ += EntrySize(node->Key_, node->Value_);
+        ++It;
+        node->Left_ = left;
+        node->Right_ = BuildBalanced(It, Count - Count / 2 - 1);
+        node->Height_ = 1 + std::max(GetHeight(node->Left_), GetHeight(node->Right_));
+        return node;
+    }
 
-        FreeAVLTree(Root->Left_);
-        FreeAVLTree(Root->Right_);
-        delete Root;
+    // Destroy every node without recursion or a stack: rotating the left child up until there is none turns the tree into
+    // a list along the right pointers, which can be freed as it is walked
+    void FreeAVLTree(AVLNode* Root) {
+        while (Root != nullptr) {
+            if (AVLNode* left = Root->Left_) {
+                Root->Left_ = left->Right_;
+                left->Right_ = Root;
+                Root = left;
+            } else {
+                AVLNode* next = Root->Right_;
+                DeleteNode(Root);
+                Root = next;
+            }
+        }
     }
 
     // Get the height of the AvlTree rooted at Root
@@ -147,21 +658,6 @@ private:
         return 0;
     }
 
-    // In-order traversal of the AVL tree
-    static void InOrderTraversal(AVLNode* Root, std::function<bool(const K&, const V&)> callback) {
-        if (Root == nullptr) {
-            return;
-        }
-        
-        InOrderTraversal(Root->Left_, callback);
-        
-        if (!callback(Root->Key_, Root->Value_)) {
-            return;
-        }
-        
-        InOrderTraversal(Root->Right_, callback);
-    }
-
     static AVLNode* Rebalance(AVLNode* Root) {
         assert(Root);
         int balance = GetHeight(Root->Left_) - GetHeight(Root->Right_);
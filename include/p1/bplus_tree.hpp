@@ -0,0 +1,489 @@
+#pragma once
+
+#include "arena.hpp"
+#include "size_of.hpp"
+#include "status.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define P1_BPLUS_TREE_AVX2 1
+#endif
+
+namespace p1 {
+
+// In-memory B+tree that can be used as the index of a Memtable instead of the AVLTree.
+//
+// Nodes are cache line aligned and keep their keys in one contiguous array, apart from the values (leaves) or child
+// pointers (inner nodes), so a node is searched by streaming through a few cache lines instead of chasing one pointer
+// per key. With 8 byte keys a node holds 32 of them and 10M keys are 5 levels deep instead of 24. For 64-bit integer
+// keys the search inside a node compares 4 keys per AVX2 instruction when the CPU has it (checked at runtime), other
+// keys use a binary search.
+//
+// All entries are in the leaves, which are linked to their right sibling, so a scan does one descent and then walks
+// the leaves. Like the AVLTree it needs external synchronization, and Delete leaves a tombstone behind instead of
+// removing the key.
+template <typename K, typename V, typename Allocator = Arena>
+class BPlusTree {
+public:
+    // Needs external synchronization when shared between threads
+    static constexpr bool kThreadSafe = false;
+    // Keys per node, enough to fill about four cache lines with keys
+    static constexpr int kCapacity = sizeof(K) >= 64 ? 4 : static_cast<int>(256 / sizeof(K));
+
+    BPlusTree() = default;
+
+    ~BPlusTree() {
+        if constexpr (!(Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<Leaf>)) {
+            Destroy(Root_, Height_);
+        }
+    }
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    // Insert key, or overwrite its value in place if it is already in the tree
+    PutResult Put(const K& key, const V& value) {
+        bool created = false;
+        auto [leaf, slot] = InsertSlot(key, created);
+        if (created) {
+            leaf->Values_[slot] = value;
+            Size_++;
+            TotalDataSize_ += HeapSize<K>::Of(key) + HeapSize<V>::Of(value);
+            return PutResult::kInserted;
+        }
+
+        TotalDataSize_ -= HeapSize<V>::Of(leaf->Values_[slot]);
+        leaf->Values_[slot] = value;
+        TotalDataSize_ += HeapSize<V>::Of(leaf->Values_[slot]);
+        if (leaf->Deleted_[slot]) {
+            // Writing over a tombstone brings the key back
+            leaf->Deleted_[slot] = false;
+            TombstoneCount_--;
+            return PutResult::kInserted;
+        }
+        return PutResult::kUpdated;
+    }
+
+    // Turn the entry of key into a tombstone, or insert one if the key is not in the tree.
+    // Returns false if there was no live entry for key.
+    bool Delete(const K& key) {
+        bool created = false;
+        auto [leaf, slot] = InsertSlot(key, created);
+        if (created) {
+            leaf->Deleted_[slot] = true;
+            Size_++;
+            TombstoneCount_++;
+            TotalDataSize_ += HeapSize<K>::Of(key);
+            return false;
+        }
+        if (leaf->Deleted_[slot]) {
+            return false;
+        }
+        TotalDataSize_ -= HeapSize<V>::Of(leaf->Values_[slot]);
+        leaf->Values_[slot] = V{};
+        leaf->Deleted_[slot] = true;
+        TombstoneCount_++;
+        return true;
+    }
+
+    // Throws if key is not in the tree or was deleted
+    V& Get(const K& key) {
+        return const_cast<V&>(static_cast<const BPlusTree*>(this)->Get(key));
+    }
+
+    const V& Get(const K& key) const {
+        const V* value = Find(key);
+        if (value == nullptr) {
+            throw std::runtime_error("Could not find provided key in B+tree");
+        }
+        return *value;
+    }
+
+    // Pointer to the value of key, nullptr when it is not in the tree or was deleted. Valid until the next insert of
+    // a new key, which may move entries around inside their leaf.
+    const V* Find(const K& key) const {
+        auto [leaf, slot] = FindSlot(key);
+        return leaf != nullptr && !leaf->Deleted_[slot] ? &leaf->Values_[slot] : nullptr;
+    }
+
+    std::optional<V> TryGet(const K& key) const {
+        if (const V* value = Find(key)) {
+            return *value;
+        }
+        return std::nullopt;
+    }
+
+    // Point lookup that tells a deleted key apart from one that was never written
+    LookupStatus Lookup(const K& key, V* value) const {
+        auto [leaf, slot] = FindSlot(key);
+        if (leaf == nullptr) {
+            return LookupStatus::kNotFound;
+        }
+        if (leaf->Deleted_[slot]) {
+            return LookupStatus::kDeleted;
+        }
+        *value = leaf->Values_[slot];
+        return LookupStatus::kFound;
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& key1, const K& key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(key1, key2, [&](const K& key, const V& value) {
+            result.emplace_back(key, value);
+            return true;
+        });
+        return result;
+    }
+
+    // Stream every live entry in [key1, key2] to callback in order, stopping early when it returns false
+    template <typename Callback>
+    void Scan(const K& key1, const K& key2, Callback&& callback) const {
+        ScanWithTombstones(key1, key2, [&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
+    }
+
+    // Like Scan, but deleted keys are passed to callback(key, value) too, with a null value. One descent to key1, then
+    // along the leaf links.
+    template <typename Callback>
+    void ScanWithTombstones(const K& key1, const K& key2, Callback&& callback) const {
+        if (Root_ == nullptr) {
+            return;
+        }
+        const Leaf* leaf = FindLeaf(key1);
+        int slot = LowerBound(leaf->Keys_, leaf->Count_, key1);
+        for (; leaf != nullptr; leaf = leaf->Next_, slot = 0) {
+            for (; slot < leaf->Count_; slot++) {
+                if (key2 < leaf->Keys_[slot]) {
+                    return;
+                }
+                if (!callback(leaf->Keys_[slot], leaf->Deleted_[slot] ? nullptr : &leaf->Values_[slot])) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Visit every entry in key order, tombstones included as null values, until callback(key, value) returns false
+    template <typename Callback>
+    void ForEach(Callback&& callback) const {
+        for (const Leaf* leaf = First_; leaf != nullptr; leaf = leaf->Next_) {
+            for (int slot = 0; slot < leaf->Count_; slot++) {
+                if (!callback(leaf->Keys_[slot], leaf->Deleted_[slot] ? nullptr : &leaf->Values_[slot])) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Visit every live entry in key order until callback(key, value) returns false
+    template <typename Callback>
+    void InOrderTraversal(Callback&& callback) const {
+        ForEach([&callback](const K& key, const V* value) {
+            return value == nullptr || callback(key, *value);
+        });
+    }
+
+    // Number of keys in the tree, tombstones included
+    size_t GetSize() const {
+        return Size_;
+    }
+
+    size_t GetTombstoneCount() const {
+        return TombstoneCount_;
+    }
+
+    // Memory held by the nodes plus whatever the keys and values own on the heap
+    size_t GetTotalDataSize() const {
+        return TotalDataSize_;
+    }
+
+    // What a new entry takes up in a leaf. Nodes are charged in one go when they are allocated, so a memtable that
+    // charges with this can end up past its limit by the nodes of one split: a leaf and an inner node per level.
+    static size_t EntrySize(const K& key, const V& value) {
+        return sizeof(K) + sizeof(V) + sizeof(bool) + HeapSize<K>::Of(key) + HeapSize<V>::Of(value);
+    }
+
+    static size_t TombstoneSize(const K& key) {
+        return sizeof(K) + sizeof(V) + sizeof(bool) + HeapSize<K>::Of(key);
+    }
+
+    // Levels including the leaves, 0 for an empty tree
+    int GetHeight() const {
+        return Height_;
+    }
+
+    bool IsEmpty() const {
+        return Root_ == nullptr;
+    }
+
+    void Clear() {
+        if constexpr (!(Allocator::kSupportsBulkReset && std::is_trivially_destructible_v<Leaf>)) {
+            Destroy(Root_, Height_);
+        }
+        Allocator_.Reset();
+        Root_ = nullptr;
+        First_ = nullptr;
+        Height_ = 0;
+        Size_ = 0;
+        TotalDataSize_ = 0;
+        TombstoneCount_ = 0;
+    }
+
+    // Bytes the allocator is holding on to (0 when nodes come straight from the heap)
+    size_t GetAllocatedMemory() const {
+        return Allocator_.GetMemoryUsage();
+    }
+
+private:
+    // Keys first, so that the key array starts on a cache line
+    struct alignas(64) Leaf {
+        K Keys_[kCapacity];
+        V Values_[kCapacity];
+        // Tombstone: the key was deleted, its value is default constructed and must not be read
+        bool Deleted_[kCapacity]{};
+        int Count_{};
+        Leaf* Next_{};
+    };
+
+    // Children_[i] holds the keys below Keys_[i], Children_[Count_] the ones from Keys_[Count_ - 1] on
+    struct alignas(64) Inner {
+        K Keys_[kCapacity];
+        void* Children_[kCapacity + 1];
+        int Count_{};
+    };
+
+    static constexpr size_t kLeafSize = Allocator::AllocationSize(sizeof(Leaf), alignof(Leaf));
+    static constexpr size_t kInnerSize = Allocator::AllocationSize(sizeof(Inner), alignof(Inner));
+    // Deep enough for 32^16 keys of 8 bytes and 4^16 of the largest ones
+    static constexpr int kMaxHeight = 16;
+
+    // Inner nodes down to the leaf level, which is Height_ - 1 levels below the root
+    void* Root_{};
+    Leaf* First_{};
+    int Height_{};
+    size_t Size_{};
+    size_t TotalDataSize_{};
+    size_t TombstoneCount_{};
+    Allocator Allocator_;
+
+    // Number of the first Count keys that are smaller than Key, which is where Key is or would go
+    static int LowerBound(const K* Keys, int Count, const K& Key) {
+#if defined(P1_BPLUS_TREE_AVX2)
+        if constexpr (std::is_integral_v<K> && sizeof(K) == 8) {
+            if (HasAvx2()) {
+                return LowerBoundAvx2(Keys, Count, Key);
+            }
+        }
+#endif
+        return static_cast<int>(std::lower_bound(Keys, Keys + Count, Key) - Keys);
+    }
+
+#if defined(P1_BPLUS_TREE_AVX2)
+    static bool HasAvx2() {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+    }
+
+    // Count the keys below Key four at a time. AVX2 only compares signed 64-bit lanes, unsigned keys get their top bit
+    // flipped on both sides first. The keys are sorted, so the first group that is not entirely below Key ends it, and
+    // a Key past the last one (every insert when keys come in ascending order) needs no search at all.
+    __attribute__((target("avx2,popcnt"))) static int LowerBoundAvx2(const K* Keys, int Count, const K& Key) {
+        const __m256i flip = _mm256_set1_epi64x(std::is_signed_v<K> ? 0 : INT64_MIN);
+        const __m256i key = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(Key)), flip);
+        if (Count == 0 || Keys[Count - 1] < Key) {
+            return Count;
+        }
+        int i = 0;
+        for (; i + 4 <= Count; i += 4) {
+            const __m256i keys =
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Keys + i)), flip);
+            const int below = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, keys)));
+            if (below != 0xF) {
+                return i + __builtin_popcount(below);
+            }
+        }
+        while (i < Count && Keys[i] < Key) {
+            i++;
+        }
+        return i;
+    }
+#endif
+
+    // Child of Node that holds Key: keys equal to a separator are in the child to its right
+    static int ChildIndex(const Inner* Node, const K& Key) {
+        int index = LowerBound(Node->Keys_, Node->Count_, Key);
+        if (index < Node->Count_ && !(Key < Node->Keys_[index])) {
+            index++;
+        }
+        return index;
+    }
+
+    const Leaf* FindLeaf(const K& Key) const {
+        const void* node = Root_;
+        for (int level = Height_ - 1; level > 0; level--) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->Children_[ChildIndex(inner, Key)];
+        }
+        return static_cast<const Leaf*>(node);
+    }
+
+    // The leaf and slot of Key, a null leaf if it is not in the tree
+    std::pair<const Leaf*, int> FindSlot(const K& Key) const {
+        if (Root_ == nullptr) {
+            return {nullptr, 0};
+        }
+        const Leaf* leaf = FindLeaf(Key);
+        const int slot = LowerBound(leaf->Keys_, leaf->Count_, Key);
+        if (slot == leaf->Count_ || Key < leaf->Keys_[slot]) {
+            return {nullptr, 0};
+        }
+        return {leaf, slot};
+    }
+
+    // The leaf and slot of Key, which gets a new slot with a default constructed value when it is not in the tree yet.
+    // Created tells which of the two happened. Full nodes on the way are split after the descent, bottom up.
+    std::pair<Leaf*, int> InsertSlot(const K& Key, bool& Created) {
+        if (Root_ == nullptr) {
+            Leaf* leaf = NewLeaf();
+            Root_ = leaf;
+            First_ = leaf;
+            Height_ = 1;
+        }
+
+        Inner* path[kMaxHeight];
+        void* node = Root_;
+        for (int level = 0; level < Height_ - 1; level++) {
+            Inner* inner = static_cast<Inner*>(node);
+            path[level] = inner;
+            node = inner->Children_[ChildIndex(inner, Key)];
+        }
+
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int slot = LowerBound(leaf->Keys_, leaf->Count_, Key);
+        if (slot < leaf->Count_ && !(Key < leaf->Keys_[slot])) {
+            return {leaf, slot};
+        }
+        Created = true;
+
+        if (leaf->Count_ == kCapacity) {
+            // Move the upper half into a new right sibling and hand its first key up as the separator. Appending past
+            // the last key of the tree starts an empty sibling instead, so ascending inserts leave full leaves behind.
+            Leaf* right = NewLeaf();
+            const bool append = slot == kCapacity && leaf->Next_ == nullptr;
+            const int half = append ? kCapacity : kCapacity / 2;
+            std::move(leaf->Keys_ + half, leaf->Keys_ + kCapacity, right->Keys_);
+            std::move(leaf->Values_ + half, leaf->Values_ + kCapacity, right->Values_);
+            std::copy(leaf->Deleted_ + half, leaf->Deleted_ + kCapacity, right->Deleted_);
+            right->Count_ = kCapacity - half;
+            leaf->Count_ = half;
+            right->Next_ = leaf->Next_;
+            leaf->Next_ = right;
+            InsertSeparator(path, Height_ - 2, append ? Key : right->Keys_[0], right);
+            if (slot > half || append) {
+                leaf = right;
+                slot -= half;
+            }
+        }
+
+        std::move_backward(leaf->Keys_ + slot, leaf->Keys_ + leaf->Count_, leaf->Keys_ + leaf->Count_ + 1);
+        std::move_backward(leaf->Values_ + slot, leaf->Values_ + leaf->Count_, leaf->Values_ + leaf->Count_ + 1);
+        std::copy_backward(leaf->Deleted_ + slot, leaf->Deleted_ + leaf->Count_, leaf->Deleted_ + leaf->Count_ + 1);
+        leaf->Keys_[slot] = Key;
+        leaf->Values_[slot] = V{};
+        leaf->Deleted_[slot] = false;
+        leaf->Count_++;
+        return {leaf, slot};
+    }
+
+    // Link Right in as the sibling following the child of Path[Level] that was just split, with Separator as the first
+    // key of Right. Splits full inner nodes up the path and grows a new root when the old one splits.
+    void InsertSeparator(Inner** Path, int Level, K Separator, void* Right) {
+        while (Level >= 0) {
+            Inner* node = Path[Level];
+            int index = ChildIndex(node, Separator);
+            if (node->Count_ < kCapacity) {
+                InsertIntoInner(node, index, std::move(Separator), Right);
+                return;
+            }
+
+            // Split around the middle key, which moves up instead of staying in either half
+            Inner* right = NewInner();
+            const int middle = kCapacity / 2;
+            K up = std::move(node->Keys_[middle]);
+            std::move(node->Keys_ + middle + 1, node->Keys_ + kCapacity, right->Keys_);
+            std::copy(node->Children_ + middle + 1, node->Children_ + kCapacity + 1, right->Children_);
+            right->Count_ = kCapacity - middle - 1;
+            node->Count_ = middle;
+            if (index <= middle) {
+                InsertIntoInner(node, index, std::move(Separator), Right);
+            } else {
+                InsertIntoInner(right, index - middle - 1, std::move(Separator), Right);
+            }
+            Separator = std::move(up);
+            Right = right;
+            Level--;
+        }
+
+        Inner* root = NewInner();
+        root->Keys_[0] = std::move(Separator);
+        root->Children_[0] = Root_;
+        root->Children_[1] = Right;
+        root->Count_ = 1;
+        Root_ = root;
+        Height_++;
+        assert(Height_ <= kMaxHeight);
+    }
+
+    // Put Separator at Index and Right right after the child at Index
+    static void InsertIntoInner(Inner* Node, int Index, K Separator, void* Right) {
+        std::move_backward(Node->Keys_ + Index, Node->Keys_ + Node->Count_, Node->Keys_ + Node->Count_ + 1);
+        std::copy_backward(Node->Children_ + Index + 1, Node->Children_ + Node->Count_ + 1,
+                           Node->Children_ + Node->Count_ + 2);
+        Node->Keys_[Index] = std::move(Separator);
+        Node->Children_[Index + 1] = Right;
+        Node->Count_++;
+    }
+
+    Leaf* NewLeaf() {
+        void* memory = Allocator_.Allocate(sizeof(Leaf), alignof(Leaf));
+        TotalDataSize_ += kLeafSize;
+        return new (memory) Leaf;
+    }
+
+    Inner* NewInner() {
+        void* memory = Allocator_.Allocate(sizeof(Inner), alignof(Inner));
+        TotalDataSize_ += kInnerSize;
+        return new (memory) Inner;
+    }
+
+    // Release Node and everything below it, Height counts the levels down to and including the leaves
+    void Destroy(void* Node, int Height) {
+        if (Node == nullptr) {
+            return;
+        }
+        if (Height == 1) {
+            Leaf* leaf = static_cast<Leaf*>(Node);
+            leaf->~Leaf();
+            Allocator_.Deallocate(leaf, sizeof(Leaf), alignof(Leaf));
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(Node);
+        for (int i = 0; i <= inner->Count_; i++) {
+            Destroy(inner->Children_[i], Height - 1);
+        }
+        inner->~Inner();
+        Allocator_.Deallocate(inner, sizeof(Inner), alignof(Inner));
+    }
+};
+
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "aligned_buffer.hpp"
+#include "extendible_hash.hpp"
+#include "file.hpp"
+#include "hash.hpp"
+#include "io_engine.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Identifies a page on disk, Offset_ is the byte offset of the page inside the file
+struct PageId {
+    uint64_t FileId_;
+    uint64_t Offset_;
+
+    bool operator==(const PageId& Other) const {
+        return FileId_ == Other.FileId_ && Offset_ == Other.Offset_;
+    }
+};
+
+struct PageIdHash {
+    size_t operator()(const PageId& Id) const {
+        return Mix64(Id.FileId_ * 0x9E3779B97F4A7C15ULL ^ Id.Offset_);
+    }
+};
+
+class BufferPool;
+
+// Pins a page for as long as it is alive. A guard can also wrap a page that lives outside of any pool, readers use
+// that when they were opened without one.
+class PageGuard {
+public:
+    PageGuard() = default;
+
+    explicit PageGuard(const char* Data) : Data_(Data) {}
+
+    PageGuard(BufferPool* Pool, size_t Frame, const char* Data) : Pool_(Pool), Frame_(Frame), Data_(Data) {}
+
+    ~PageGuard() {
+        Release();
+    }
+
+    PageGuard(const PageGuard&) = delete;
+    PageGuard& operator=(const PageGuard&) = delete;
+
+    PageGuard(PageGuard&& Other) noexcept
+        : Pool_(std::exchange(Other.Pool_, nullptr)), Frame_(Other.Frame_), Data_(std::exchange(Other.Data_, nullptr)) {}
+
+    PageGuard& operator=(PageGuard&& Other) noexcept {
+        if (this != &Other) {
+            Release();
+            Pool_ = std::exchange(Other.Pool_, nullptr);
+            Frame_ = Other.Frame_;
+            Data_ = std::exchange(Other.Data_, nullptr);
+        }
+        return *this;
+    }
+
+    const char* Data() const {
+        return Data_;
+    }
+
+    // Unpin early
+    inline void Release();
+
+private:
+    BufferPool* Pool_{};
+    size_t Frame_{};
+    const char* Data_{};
+};
+
+// Fixed number of page sized frames shared by all on-disk readers.
+//
+// Resident pages are found through an extendible hash directory keyed by PageId. When a page is missing the clock
+// hand sweeps over the frames, giving every recently used frame a second chance, and reuses the first unpinned frame
+// that was not referenced since the last sweep. The read itself happens outside of the pool lock, concurrent fetches of
+// the same page wait for the first one instead of issuing their own read.
+class BufferPool {
+public:
+    explicit BufferPool(size_t Capacity)
+        : Capacity_(CheckCapacity(Capacity)), Frames_(Capacity), Memory_(Capacity * kPageSize) {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Every file that goes through a pool needs an id that is never reused, even across pools
+    static uint64_t NewFileId() {
+        static std::atomic<uint64_t> nextId{1};
+        return nextId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pin the page at Offset of SourceFile, reading it in if it is not resident
+    PageGuard FetchPage(const File& SourceFile, uint64_t FileId, uint64_t Offset) {
+        const PageId id{FileId, Offset};
+        std::unique_lock<std::mutex> lock(Mutex_);
+        while (true) {
+            size_t frame;
+            if (!Table_.Find(id, &frame)) {
+                break;
+            }
+            Frame& f = Frames_[frame];
+            Pin(f);
+            f.Referenced_ = true;
+            if (f.Loading_) {
+                // Someone else is reading the page in, wait for them
+                LoadDone_.wait(lock, [&f] { return !f.Loading_; });
+                if (!f.Valid_ || !(f.Id_ == id)) {
+                    // Their read failed, try again
+                    Unpin(f);
+                    continue;
+                }
+            }
+            Hits_.fetch_add(1, std::memory_order_relaxed);
+            return PageGuard(this, frame, FrameData(frame));
+        }
+
+        Misses_.fetch_add(1, std::memory_order_relaxed);
+        const size_t frame = FindVictim();
+        Frame& f = Frames_[frame];
+        if (f.Valid_) {
+            Table_.Remove(f.Id_);
+            Evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        f.Id_ = id;
+        f.Valid_ = true;
+        f.Loading_ = true;
+        Pin(f);
+        f.Referenced_ = true;
+        Table_.Insert(id, frame);
+
+        lock.unlock();
+        try {
+            SourceFile.Read(FrameData(frame), kPageSize, Offset);
+        } catch (...) {
+            lock.lock();
+            Table_.Remove(id);
+            f.Valid_ = false;
+            f.Loading_ = false;
+            Unpin(f);
+            LoadDone_.notify_all();
+            throw;
+        }
+        lock.lock();
+        f.Loading_ = false;
+        LoadDone_.notify_all();
+        return PageGuard(this, frame, FrameData(frame));
+    }
+
+    // Pin the pages at Offsets[0..Count) of SourceFile into the empty guards Guards[0..Count), like one FetchPage per
+    // page but with all the misses read at once, through Engine when there is one. Count must stay well below the
+    // capacity, every page of the batch is pinned at the same time.
+    void FetchPages(const File& SourceFile, uint64_t FileId, const uint64_t* Offsets, size_t Count, PageGuard* Guards,
+                    IOEngine* Engine) {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        FetchPages(lock, SourceFile, FileId, Offsets, Count, Guards, Engine);
+    }
+
+    // FetchPages, unless pinning the batch would leave less than half of the frames unpinned. Then it returns false
+    // without pinning anything, and the caller reads the pages itself. Batches from concurrent readers so never take
+    // the frames that single page fetches need.
+    bool TryFetchPages(const File& SourceFile, uint64_t FileId, const uint64_t* Offsets, size_t Count,
+                       PageGuard* Guards, IOEngine* Engine) {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        if (PinnedFrames_ + Count > Capacity_ / 2) {
+            return false;
+        }
+        FetchPages(lock, SourceFile, FileId, Offsets, Count, Guards, Engine);
+        return true;
+    }
+
+    void Unpin(size_t FrameIndex) {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        Unpin(Frames_[FrameIndex]);
+    }
+
+    size_t GetCapacity() const {
+        return Capacity_;
+    }
+
+    uint64_t GetHits() const {
+        return Hits_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetMisses() const {
+        return Misses_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetEvictions() const {
+        return Evictions_.load(std::memory_order_relaxed);
+    }
+
+    void ResetCounters() {
+        Hits_.store(0, std::memory_order_relaxed);
+        Misses_.store(0, std::memory_order_relaxed);
+        Evictions_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Frame {
+        PageId Id_{};
+        int PinCount_{};
+        bool Valid_{};
+        bool Loading_{};
+        bool Referenced_{};
+    };
+
+    const size_t Capacity_;
+    std::vector<Frame> Frames_;
+    AlignedBuffer Memory_;
+    ExtendibleHashTable<PageId, size_t, PageIdHash> Table_;
+    size_t ClockHand_{};
+    // Frames with a PinCount_ above 0
+    size_t PinnedFrames_{};
+    std::mutex Mutex_;
+    std::condition_variable LoadDone_;
+
+    std::atomic<uint64_t> Hits_{};
+    std::atomic<uint64_t> Misses_{};
+    std::atomic<uint64_t> Evictions_{};
+
+    char* FrameData(size_t FrameIndex) const {
+        return Memory_.Data() + FrameIndex * kPageSize;
+    }
+
+    // Validates Capacity before any frame is allocated
+    static size_t CheckCapacity(size_t Capacity) {
+        if (Capacity == 0) {
+            throw std::invalid_argument("Buffer pool needs at least one frame");
+        }
+        return Capacity;
+    }
+
+    void FetchPages(std::unique_lock<std::mutex>& Lock, const File& SourceFile, uint64_t FileId,
+                    const uint64_t* Offsets, size_t Count, PageGuard* Guards, IOEngine* Engine) {
+        std::vector<size_t> frames(Count);
+        // Pages this call reads in, and pages some other fetch is reading in
+        std::vector<size_t> loads;
+        std::vector<size_t> waits;
+        for (size_t i = 0; i < Count; i++) {
+            const PageId id{FileId, Offsets[i]};
+            if (Table_.Find(id, &frames[i])) {
+                Frame& f = Frames_[frames[i]];
+                Pin(f);
+                f.Referenced_ = true;
+                if (f.Loading_) {
+                    waits.push_back(i);
+                } else {
+                    Hits_.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+            try {
+                frames[i] = FindVictim();
+            } catch (...) {
+                AbandonLoads(frames.data(), i, loads);
+                throw;
+            }
+            Misses_.fetch_add(1, std::memory_order_relaxed);
+            Frame& f = Frames_[frames[i]];
+            if (f.Valid_) {
+                Table_.Remove(f.Id_);
+                Evictions_.fetch_add(1, std::memory_order_relaxed);
+            }
+            f.Id_ = id;
+            f.Valid_ = true;
+            f.Loading_ = true;
+            Pin(f);
+            f.Referenced_ = true;
+            Table_.Insert(id, frames[i]);
+            loads.push_back(i);
+        }
+
+        Lock.unlock();
+        try {
+            std::vector<ReadRequest> requests(loads.size());
+            for (size_t j = 0; j < loads.size(); j++) {
+                requests[j] = {&SourceFile, FrameData(frames[loads[j]]), kPageSize, Offsets[loads[j]]};
+            }
+            if (Engine != nullptr && requests.size() > 1) {
+                Engine->Read(requests.data(), requests.size());
+            } else {
+                for (const ReadRequest& request : requests) {
+                    SourceFile.Read(request.Buffer_, request.Size_, request.Offset_);
+                }
+            }
+        } catch (...) {
+            Lock.lock();
+            AbandonLoads(frames.data(), Count, loads);
+            throw;
+        }
+        Lock.lock();
+        for (size_t i : loads) {
+            Frames_[frames[i]].Loading_ = false;
+        }
+        LoadDone_.notify_all();
+
+        // Only wait for the others once our own reads are done, so that two batches waiting for each other's pages
+        // can't block each other
+        std::vector<size_t> retries;
+        for (size_t i : waits) {
+            Frame& f = Frames_[frames[i]];
+            LoadDone_.wait(Lock, [&f] { return !f.Loading_; });
+            if (!f.Valid_ || !(f.Id_ == PageId{FileId, Offsets[i]})) {
+                Unpin(f);
+                retries.push_back(i);
+            } else {
+                Hits_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        Lock.unlock();
+
+        for (size_t i = 0; i < Count; i++) {
+            Guards[i] = PageGuard(this, frames[i], FrameData(frames[i]));
+        }
+        for (size_t i : retries) {
+            Guards[i] = FetchPage(SourceFile, FileId, Offsets[i]);
+        }
+    }
+
+    void Pin(Frame& F) {
+        if (F.PinCount_++ == 0) {
+            PinnedFrames_++;
+        }
+    }
+
+    void Unpin(Frame& F) {
+        if (--F.PinCount_ == 0) {
+            PinnedFrames_--;
+        }
+    }
+
+    // Undo the first Count pins of a failed FetchPages, the frames it was loading in are dropped again
+    void AbandonLoads(const size_t* Frames, size_t Count, const std::vector<size_t>& Loads) {
+        for (size_t i : Loads) {
+            Frame& f = Frames_[Frames[i]];
+            Table_.Remove(f.Id_);
+            f.Valid_ = false;
+            f.Loading_ = false;
+        }
+        for (size_t i = 0; i < Count; i++) {
+            Unpin(Frames_[Frames[i]]);
+        }
+        LoadDone_.notify_all();
+    }
+
+    // Clock sweep, two full rounds are enough to clear every reference bit
+    size_t FindVictim() {
+        for (size_t step = 0; step < 2 * Capacity_; step++) {
+            const size_t frame = ClockHand_;
+            ClockHand_ = (ClockHand_ + 1) % Capacity_;
+            Frame& f = Frames_[frame];
+            // A frame whose read failed can still be pinned by threads that waited for it
+            if (f.PinCount_ > 0) {
+                continue;
+            }
+            if (!f.Valid_) {
+                return frame;
+            }
+            if (f.Referenced_) {
+                f.Referenced_ = false;
+                continue;
+            }
+            return frame;
+        }
+        throw std::runtime_error("Every buffer pool frame is pinned");
+    }
+};
+
+inline void PageGuard::Release() {
+    if (Pool_ != nullptr) {
+        Pool_->Unpin(Frame_);
+        Pool_ = nullptr;
+    }
+    Data_ = nullptr;
+}
+
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace p1 {
+
+// Helpers for the on-disk formats, all fixed width integers are stored little endian (i.e. in host order, we only
+// target x86/ARM little endian machines)
+inline char* EncodeFixed16(char* Dst, uint16_t Value) {
+    std::memcpy(Dst, &Value, sizeof(Value));
+    return Dst + sizeof(Value);
+}
+
+inline char* EncodeFixed32(char* Dst, uint32_t Value) {
+    std::memcpy(Dst, &Value, sizeof(Value));
+    return Dst + sizeof(Value);
+}
+
+inline char* EncodeFixed64(char* Dst, uint64_t Value) {
+    std::memcpy(Dst, &Value, sizeof(Value));
+    return Dst + sizeof(Value);
+}
+
+inline uint16_t DecodeFixed16(const char* Src) {
+    uint16_t value;
+    std::memcpy(&value, Src, sizeof(value));
+    return value;
+}
+
+inline uint32_t DecodeFixed32(const char* Src) {
+    uint32_t value;
+    std::memcpy(&value, Src, sizeof(value));
+    return value;
+}
+
+inline uint64_t DecodeFixed64(const char* Src) {
+    uint64_t value;
+    std::memcpy(&value, Src, sizeof(value));
+    return value;
+}
+
+inline size_t VarintLength(uint64_t Value) {
+    size_t length = 1;
+    while (Value >= 128) {
+        Value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+inline char* EncodeVarint(char* Dst, uint64_t Value) {
+    auto* ptr = reinterpret_cast<unsigned char*>(Dst);
+    while (Value >= 128) {
+        *ptr++ = static_cast<unsigned char>(Value | 128);
+        Value >>= 7;
+    }
+    *ptr++ = static_cast<unsigned char>(Value);
+    return reinterpret_cast<char*>(ptr);
+}
+
+inline const char* DecodeVarint(const char* Src, uint64_t* Value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift <= 63; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*Src++);
+        result |= uint64_t(byte & 127) << shift;
+        if ((byte & 128) == 0) {
+            break;
+        }
+    }
+    *Value = result;
+    return Src;
+}
+
+// Same, but for bytes that may be corrupt: returns nullptr instead of reading at or past Limit
+inline const char* DecodeVarint(const char* Src, const char* Limit, uint64_t* Value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift <= 63; shift += 7) {
+        if (Src >= Limit) {
+            return nullptr;
+        }
+        const auto byte = static_cast<unsigned char>(*Src++);
+        result |= uint64_t(byte & 127) << shift;
+        if ((byte & 128) == 0) {
+            break;
+        }
+    }
+    *Value = result;
+    return Src;
+}
+
+// Codec<T> describes how keys and values are laid out on disk.
+// Size() is the encoded size, Encode() writes the value and returns the end of what it wrote, Decode() reads it back
+// and returns a pointer right behind it. Decode() with a Limit is for bytes that may be corrupt, it returns nullptr
+// instead of reading past Limit.
+template <typename T, typename = void>
+struct Codec;
+
+// Trivially copyable types (integers, PODs) are stored as their raw bytes
+template <typename T>
+struct Codec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static size_t Size(const T& /*Value*/) {
+        return sizeof(T);
+    }
+
+    static char* Encode(char* Dst, const T& Value) {
+        std::memcpy(Dst, &Value, sizeof(T));
+        return Dst + sizeof(T);
+    }
+
+    static const char* Decode(const char* Src, T* Value) {
+        std::memcpy(Value, Src, sizeof(T));
+        return Src + sizeof(T);
+    }
+
+    static const char* Decode(const char* Src, const char* Limit, T* Value) {
+        if (static_cast<size_t>(Limit - Src) < sizeof(T)) {
+            return nullptr;
+        }
+        return Decode(Src, Value);
+    }
+};
+
+// Strings are stored as a varint length followed by the bytes
+template <>
+struct Codec<std::string> {
+    static size_t Size(const std::string& Value) {
+        return VarintLength(Value.size()) + Value.size();
+    }
+
+    static char* Encode(char* Dst, const std::string& Value) {
+        Dst = EncodeVarint(Dst, Value.size());
+        std::memcpy(Dst, Value.data(), Value.size());
+        return Dst + Value.size();
+    }
+
+    static const char* Decode(const char* Src, std::string* Value) {
+        uint64_t length;
+        Src = DecodeVarint(Src, &length);
+        Value->assign(Src, length);
+        return Src + length;
+    }
+
+    static const char* Decode(const char* Src, const char* Limit, std::string* Value) {
+        uint64_t length;
+        Src = DecodeVarint(Src, Limit, &length);
+        if (Src == nullptr || length > static_cast<uint64_t>(Limit - Src)) {
+            return nullptr;
+        }
+        Value->assign(Src, length);
+        return Src + length;
+    }
+};
+
+}
@@ -0,0 +1,1241 @@
+#pragma once
+
+#include "buffer_pool.hpp"
+#include "io_engine.hpp"
+#include "kv_iterator.hpp"
+#include "memtable.hpp"
+#include "sst.hpp"
+#include "wal.hpp"
+#include "write_batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace p1 {
+
+struct DatabaseOptions {
+    // Size limit of the active memtable, it is handed to the flush thread once it is full
+    size_t MemtableSize_ = 4 << 20;
+    // Full memtables that may queue up for the flush thread, writers stall once this many are waiting. With more than
+    // one, a burst of writes keeps going into fresh memtables while the flush of an older one is still running.
+    size_t MaxImmutableMemtables_ = 2;
+    // Number of L0 files that triggers an L0 -> L1 compaction
+    size_t L0CompactionTrigger_ = 4;
+    // Number of L0 files at which writers stall until compaction catches up
+    size_t L0StopWritesTrigger_ = 12;
+    // Target size of L1, every further level is LevelSizeRatio_ times bigger than the one above it
+    uint64_t BaseLevelSize_ = 64 << 20;
+    size_t LevelSizeRatio_ = 10;
+    size_t NumLevels_ = 7;
+    // Compaction output is split into files of about this size
+    uint64_t TargetFileSize_ = 8 << 20;
+    // Bloom filter bits per key for every SST, 0 disables filters
+    size_t BloomBitsPerKey_ = 10;
+    // Pages in the buffer pool shared by all SSTs, 0 reads straight from the files
+    size_t BufferPoolPages_ = 4096;
+    // Keep the index pages of every SST in memory, about one page per 200 data pages
+    bool PinIndex_ = true;
+    // Prefix compress the keys of new SSTs with a restart point every this many keys, 0 writes the flat layout. Tables
+    // in either layout can be read, so this can change between opens.
+    size_t RestartInterval_ = 0;
+    // kMmap reads the SSTs through memory mappings instead of the buffer pool, for read-mostly data that fits the page
+    // cache. kDirect writes and reads them with O_DIRECT, which leaves the buffer pool as the only cache of SST pages.
+    SSTReadMode ReadMode_ = SSTReadMode::kPread;
+    // Reads in flight at once for SST scans, compactions and MultiGet, through io_uring (or a thread pool where that is
+    // missing). 0 reads one batch of pages at a time with a blocking pread.
+    size_t IOQueueDepth_ = 0;
+    // Every Put and Delete goes to the write-ahead log of its memtable first, the sync policy decides when it hits the disk
+    WALOptions WAL_;
+};
+
+struct DatabaseStats {
+    std::vector<size_t> FilesPerLevel_;
+    std::vector<uint64_t> BytesPerLevel_;
+    uint64_t Flushes_{};
+    uint64_t Compactions_{};
+    // Compactions that only moved a file down a level without rewriting it
+    uint64_t TrivialMoves_{};
+    // Bytes written by flushes and compactions, divided by the bytes put this is the write amplification
+    uint64_t BytesWritten_{};
+    uint64_t StallMicros_{};
+    // Full memtables waiting for or in the middle of their flush
+    size_t ImmutableMemtables_{};
+    uint64_t Gets_{};
+    // SST lookups issued by Get (after min/max pruning), TableProbes_ / Gets_ is the read amplification in tables
+    uint64_t TableProbes_{};
+    // Pages requested by the SSTs that are currently live
+    uint64_t PageReads_{};
+};
+
+// Log-structured merge tree on top of Memtable.
+//
+// Writes go into the active memtable. A full memtable becomes immutable and joins the queue of memtables that the flush
+// thread writes to new level 0 SSTs, oldest first, while a fresh memtable takes the writes. Reads consult the active
+// memtable, then the immutable ones newest first, then the SSTs. Level 0 files may overlap each other, every deeper level is a
+// single sorted run split into non-overlapping files. The compaction thread merges L0 into L1 once there are
+// L0CompactionTrigger_ files, and a file of level i into the overlapping files of level i+1 once level i grows past
+// its target size. Writers only stall when MaxImmutableMemtables_ memtables are already waiting for the flush or when L0
+// has piled up to L0StopWritesTrigger_ files.
+//
+// The set of live tables per level is an immutable Version that is swapped under the lock, readers grab the current
+// one and do all their I/O without holding the lock. The MANIFEST file records the tables of every level.
+//
+// Each memtable has its own write-ahead log. Writers queue up and the one at the front commits its write together with
+// those queued behind it, outside of the lock, and applies them to the memtable in log order only once the log has them.
+// Readers never see a write that a crash can still lose. A log is deleted once its memtable is in an SST, Open replays
+// the logs that are left into level 0.
+//
+// All methods are thread safe.
+template <typename K, typename V>
+class Database {
+public:
+    Database() = default;
+
+    ~Database() {
+        try {
+            Close();
+        } catch (...) {
+        }
+    }
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    // Open (or create) the database in directory Path
+    void Open(const std::string& Path, const DatabaseOptions& Options = {}) {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        if (Open_) {
+            throw std::logic_error("Database is already open");
+        }
+        if (Options.NumLevels_ < 2) {
+            throw std::invalid_argument("Database needs at least two levels");
+        }
+        if (Options.MaxImmutableMemtables_ < 1) {
+            throw std::invalid_argument("Database needs room for at least one immutable memtable");
+        }
+        if (Options.WAL_.SyncPolicy_ == WALSyncPolicy::kInterval && Options.WAL_.SyncIntervalMs_ == 0) {
+            throw std::invalid_argument("WAL sync interval must be at least 1 ms");
+        }
+        Path_ = Path;
+        Options_ = Options;
+        std::filesystem::create_directories(Path_);
+        Pool_ = Options_.BufferPoolPages_ > 0 ? std::make_unique<BufferPool>(Options_.BufferPoolPages_) : nullptr;
+        Engine_ = Options_.IOQueueDepth_ > 0 ? NewIOEngine(Options_.IOQueueDepth_) : nullptr;
+        Mem_ = std::make_shared<MemtableType>(Options_.MemtableSize_);
+        Imms_ = std::make_shared<const ImmutableList>();
+        CompactPointers_.assign(Options_.NumLevels_, std::nullopt);
+        BgError_ = nullptr;
+        ShuttingDown_ = false;
+        Stats_ = {};
+        Gets_ = 0;
+        TableProbes_ = 0;
+
+        LoadManifest();
+        RecoverLogs();
+
+        Open_ = true;
+        FlushThread_ = std::thread([this] { FlushLoop(); });
+        CompactionThread_ = std::thread([this] { CompactionLoop(); });
+    }
+
+    void Put(const K& Key, const V& Value) {
+        std::string record;
+        EncodeLogPut(&record, Key, Value);
+        Writer writer(record, &Key, &Value, nullptr);
+        Write(writer);
+    }
+
+    // Delete Key by writing a tombstone, which shadows the older versions of the key until compaction reaches the
+    // bottom of the tree and drops it
+    void Delete(const K& Key) {
+        std::string record;
+        EncodeLogDelete(&record, Key);
+        Writer writer(record, &Key, nullptr, nullptr);
+        Write(writer);
+    }
+
+    // Apply all operations of Batch or none: they go into the log as a single record and into the memtable together,
+    // so readers and recovery never see part of it. Throws if the batch doesn't fit into an empty memtable.
+    void Write(const WriteBatch<K, V>& Batch) {
+        if (Batch.IsEmpty()) {
+            return;
+        }
+        std::string record;
+        for (const auto& entry : Batch.GetEntries()) {
+            if (entry.Deleted_) {
+                EncodeLogDelete(&record, entry.Key_);
+            } else {
+                EncodeLogPut(&record, entry.Key_, entry.Value_);
+            }
+        }
+        Writer writer(record, nullptr, nullptr, &Batch);
+        Write(writer);
+    }
+
+    std::optional<V> Get(const K& Key) const {
+        Gets_.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<const ImmutableList> imms;
+        std::shared_ptr<const Version> version;
+        V value{};
+        LookupStatus status;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            CheckOpen();
+            status = Mem_->Lookup(Key, &value);
+            imms = Imms_;
+            version = Current_;
+        }
+
+        // A tombstone anywhere ends the search just like a value does
+        for (auto it = imms->begin(); status == LookupStatus::kNotFound && it != imms->end(); ++it) {
+            status = it->Memtable_->Lookup(Key, &value);
+        }
+        if (status == LookupStatus::kNotFound) {
+            status = LookupTables(*version, Key, &value);
+        }
+        if (status != LookupStatus::kFound) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Get for a batch of keys, result[i] belongs to Keys[i]. The keys are sorted and go through every memtable and
+    // table together: the memtables answer them in one walk down the tree, and each SST reads the data pages the
+    // remaining keys land on once per page and all at once (see SSTReader::MultiLookup), instead of one page after the
+    // other per Get.
+    std::vector<std::optional<V>> MultiGet(const std::vector<K>& Keys) const {
+        const std::vector<size_t> order = SortedOrder(Keys);
+        std::vector<K> sorted;
+        sorted.reserve(Keys.size());
+        for (size_t i : order) {
+            sorted.push_back(Keys[i]);
+        }
+        std::vector<LookupStatus> statuses(Keys.size(), LookupStatus::kNotFound);
+        std::vector<V> values(Keys.size());
+        Gets_.fetch_add(Keys.size(), std::memory_order_relaxed);
+        std::shared_ptr<const ImmutableList> imms;
+        std::shared_ptr<const Version> version;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            CheckOpen();
+            Mem_->MultiLookup(sorted.data(), sorted.size(), statuses.data(), values.data());
+            imms = Imms_;
+            version = Current_;
+        }
+
+        // Every source only looks at the keys still kNotFound, so a tombstone ends the search for its key here too
+        for (const Immutable& imm : *imms) {
+            imm.Memtable_->MultiLookup(sorted.data(), sorted.size(), statuses.data(), values.data());
+        }
+        MultiLookupTables(*version, sorted, statuses.data(), values.data());
+
+        std::vector<std::optional<V>> result(Keys.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            if (statuses[i] == LookupStatus::kFound) {
+                result[order[i]] = std::move(values[i]);
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& Key1, const K& Key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(Key1, Key2, [&](const K& Key, const V& Value) {
+            result.emplace_back(Key, Value);
+            return true;
+        });
+        return result;
+    }
+
+    // Stream the newest version of every key in [Key1, Key2] to callback in order until it returns false
+    template <typename Callback>
+    void Scan(const K& Key1, const K& Key2, Callback&& callback) const {
+        std::vector<std::unique_ptr<KVIterator<K, V>>> children;
+        std::shared_ptr<const ImmutableList> imms;
+        std::shared_ptr<const Version> version;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            CheckOpen();
+            children.push_back(std::make_unique<ActiveMemtableIterator>(Mem_, Mutex_, Key1, Key2));
+            imms = Imms_;
+            version = Current_;
+        }
+        for (const Immutable& imm : *imms) {
+            children.push_back(std::make_unique<ImmutableMemtableIterator>(imm.Memtable_, Key1));
+        }
+        for (const auto& level : version->Levels_) {
+            for (const auto& table : level) {
+                if (table->Overlaps(Key1, Key2)) {
+                    auto it = table->Reader_->NewIterator();
+                    it->Seek(Key1);
+                    children.push_back(std::move(it));
+                }
+            }
+        }
+
+        for (MergingIterator<K, V> it(std::move(children)); it.Valid() && !(Key2 < it.Key()); it.Next()) {
+            if (!it.IsDeleted() && !callback(it.Key(), it.Value())) {
+                return;
+            }
+        }
+    }
+
+    // Write the active memtable to level 0 and wait until it is on disk
+    void Flush() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        CheckWritable();
+        // Switch memtables in turn with the writers, so that no group of writes is being committed to the log of the
+        // memtable that becomes immutable
+        Writer turn;
+        WaitForTurn(turn, lock);
+        try {
+            if (Mem_->GetEntryCount() > 0) {
+                MakeRoomForWrite(lock);
+            }
+        } catch (...) {
+            EndTurn();
+            throw;
+        }
+        EndTurn();
+        BgCv_.wait(lock, [this] { return Imms_->empty() || BgError_; });
+        CheckWritable();
+    }
+
+    // Block until no level needs compacting anymore
+    void WaitForCompactions() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        CheckOpen();
+        BgCv_.wait(lock, [this] { return BgError_ || (Imms_->empty() && !CompactionRunning_ && !PickCompaction()); });
+        CheckWritable();
+    }
+
+    DatabaseStats GetStats() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        DatabaseStats stats = Stats_;
+        stats.Gets_ = Gets_.load(std::memory_order_relaxed);
+        stats.TableProbes_ = TableProbes_.load(std::memory_order_relaxed);
+        stats.ImmutableMemtables_ = Imms_ != nullptr ? Imms_->size() : 0;
+        if (Current_ != nullptr) {
+            for (const auto& level : Current_->Levels_) {
+                uint64_t bytes = 0;
+                for (const auto& table : level) {
+                    bytes += table->FileSize_;
+                    stats.PageReads_ += table->Reader_->GetPageReads();
+                }
+                stats.FilesPerLevel_.push_back(level.size());
+                stats.BytesPerLevel_.push_back(bytes);
+            }
+        }
+        return stats;
+    }
+
+    // Flush the memtable, let running background work finish and release everything
+    void Close() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        if (!Open_) {
+            return;
+        }
+        // Keep the turn until the end, writers queued behind it find the database closed
+        Writer turn;
+        WaitForTurn(turn, lock);
+        if (!Open_) {
+            EndTurn();
+            return;
+        }
+        if (!BgError_ && Mem_->GetEntryCount() > 0) {
+            while (Imms_->size() >= Options_.MaxImmutableMemtables_ && !BgError_) {
+                BgCv_.wait(lock);
+            }
+            if (!BgError_) {
+                SwitchMemtable();
+            }
+        }
+        BgCv_.wait(lock, [this] { return Imms_->empty() || BgError_; });
+        ShuttingDown_ = true;
+        WorkCv_.notify_all();
+        lock.unlock();
+
+        FlushThread_.join();
+        CompactionThread_.join();
+        // Whatever is left in the log is also in an SST now, unless the flush failed
+        Log_->Close();
+
+        lock.lock();
+        Open_ = false;
+        Current_.reset();
+        Mem_.reset();
+        Imms_.reset();
+        Log_.reset();
+        Pool_.reset();
+        Engine_.reset();
+        EndTurn();
+        if (BgError_) {
+            std::rethrow_exception(std::exchange(BgError_, nullptr));
+        }
+    }
+
+private:
+    using MemtableType = Memtable<K, V>;
+
+    // A Put or Delete of Key_ (Value_ is null for a Delete), or all of Batch_, queued in Writers_ with its log record.
+    // Without a record it only holds a turn for Flush or Close, which switch memtables.
+    struct Writer {
+        const std::string* Record_{};
+        const K* Key_{};
+        const V* Value_{};
+        const WriteBatch<K, V>* Batch_{};
+        // Set by the writer that committed and applied this one as part of its group
+        bool Done_{};
+        std::exception_ptr Error_;
+
+        Writer() = default;
+        Writer(const std::string& Record, const K* Key, const V* Value, const WriteBatch<K, V>* Batch)
+            : Record_(&Record), Key_(Key), Value_(Value), Batch_(Batch) {}
+    };
+
+    // A full memtable waiting for its flush, with the log that holds its writes until it is in an SST
+    struct Immutable {
+        std::shared_ptr<const MemtableType> Memtable_;
+        std::shared_ptr<WriteAheadLog> Log_;
+        uint64_t LogNumber_;
+    };
+
+    // Newest first. Like a Version it is never modified, a switch or flush installs a new list and readers keep
+    // whichever one they grabbed.
+    using ImmutableList = std::vector<Immutable>;
+
+    // A live SST, the file is deleted once a compaction made it obsolete and the last reader let go of it
+    struct Table {
+        uint64_t Number_;
+        std::string Path_;
+        uint64_t FileSize_;
+        std::unique_ptr<SSTReader<K, V>> Reader_;
+        std::atomic<bool> Obsolete_{false};
+
+        Table(uint64_t Number, std::string Path, BufferPool* Pool, const SSTReadOptions& Options)
+            : Number_(Number), Path_(std::move(Path)), FileSize_(std::filesystem::file_size(Path_)),
+              Reader_(std::make_unique<SSTReader<K, V>>(Path_, Pool, Options)) {}
+
+        ~Table() {
+            if (Obsolete_) {
+                Reader_.reset();
+                std::error_code error;
+                std::filesystem::remove(Path_, error);
+            }
+        }
+
+        bool Contains(const K& Key) const {
+            return !(Key < Reader_->GetMinKey()) && !(Reader_->GetMaxKey() < Key);
+        }
+
+        bool Overlaps(const K& Lo, const K& Hi) const {
+            return !(Hi < Reader_->GetMinKey()) && !(Reader_->GetMaxKey() < Lo);
+        }
+    };
+
+    struct Version {
+        // Levels_[0] is ordered newest first, the other levels by key
+        std::vector<std::vector<std::shared_ptr<Table>>> Levels_;
+    };
+
+    struct Compaction {
+        size_t Level_;
+        // Inputs from Level_ (newest first for L0) and from Level_ + 1
+        std::vector<std::shared_ptr<Table>> Inputs_;
+        std::vector<std::shared_ptr<Table>> NextInputs_;
+        // No level below the output holds the key range, so tombstones have nothing left to shadow
+        bool DropTombstones_{};
+    };
+
+    std::string Path_;
+    DatabaseOptions Options_;
+    std::unique_ptr<BufferPool> Pool_;
+    std::unique_ptr<IOEngine> Engine_;
+
+    mutable std::mutex Mutex_;
+    // Signals the background threads that there is work
+    std::condition_variable WorkCv_;
+    // Signals writers and waiters that background work finished
+    std::condition_variable BgCv_;
+    // Signals queued writers that the front of Writers_ moved on
+    std::condition_variable WriterCv_;
+    // Writers waiting for their write to be committed, the one at the front commits the next group
+    std::deque<Writer*> Writers_;
+
+    std::shared_ptr<MemtableType> Mem_;
+    std::shared_ptr<const ImmutableList> Imms_;
+    std::shared_ptr<WriteAheadLog> Log_;
+    uint64_t LogNumber_{};
+    // Oldest log that is still needed, every older one belongs to a memtable that made it into an SST
+    uint64_t MinLogNumber_{};
+    std::shared_ptr<const Version> Current_;
+    uint64_t NextFileNumber_{1};
+    // Largest key compacted out of each level so far, the next compaction of that level starts after it
+    std::vector<std::optional<K>> CompactPointers_;
+    bool CompactionRunning_{};
+    bool ShuttingDown_{};
+    bool Open_{};
+    std::exception_ptr BgError_;
+    DatabaseStats Stats_;
+    // Bumped by every reader, outside of the lock
+    mutable std::atomic<uint64_t> Gets_{};
+    mutable std::atomic<uint64_t> TableProbes_{};
+
+    std::thread FlushThread_;
+    std::thread CompactionThread_;
+
+    void CheckOpen() const {
+        if (!Open_) {
+            throw std::logic_error("Database is not open");
+        }
+    }
+
+    void CheckWritable() const {
+        CheckOpen();
+        if (BgError_) {
+            std::rethrow_exception(BgError_);
+        }
+    }
+
+    LookupStatus LookupTables(const Version& Version, const K& Key, V* Value) const {
+        uint64_t probes = 0;
+        LookupStatus status = LookupStatus::kNotFound;
+        // Level 0 files overlap, newest first
+        for (const auto& table : Version.Levels_[0]) {
+            if (table->Contains(Key)) {
+                probes++;
+                if ((status = table->Reader_->Lookup(Key, Value)) != LookupStatus::kNotFound) {
+                    break;
+                }
+            }
+        }
+        // Deeper levels have at most one file whose range covers the key
+        for (size_t level = 1; status == LookupStatus::kNotFound && level < Version.Levels_.size(); level++) {
+            const auto& files = Version.Levels_[level];
+            auto it = std::lower_bound(files.begin(), files.end(), Key, [](const auto& Table, const K& Key) {
+                return Table->Reader_->GetMaxKey() < Key;
+            });
+            if (it != files.end() && (*it)->Contains(Key)) {
+                probes++;
+                status = (*it)->Reader_->Lookup(Key, Value);
+            }
+        }
+
+        TableProbes_.fetch_add(probes, std::memory_order_relaxed);
+        return status;
+    }
+
+    // LookupTables for the sorted Keys whose status is still kNotFound
+    void MultiLookupTables(const Version& Version, const std::vector<K>& Keys, LookupStatus* Statuses,
+                           V* Values) const {
+        uint64_t probes = 0;
+        // Each table is handed the run of keys inside its range, on level 0 that is all of them
+        const auto probe = [&](const Table& Target, size_t First, size_t Last) {
+            for (size_t i = First; i < Last; i++) {
+                probes += Statuses[i] == LookupStatus::kNotFound && Target.Contains(Keys[i]);
+            }
+            Target.Reader_->MultiLookup(Keys.data() + First, Last - First, Statuses + First, Values + First);
+        };
+        for (const auto& table : Version.Levels_[0]) {
+            probe(*table, 0, Keys.size());
+        }
+        for (size_t level = 1; level < Version.Levels_.size(); level++) {
+            auto key = Keys.begin();
+            for (const auto& table : Version.Levels_[level]) {
+                key = std::lower_bound(key, Keys.end(), table->Reader_->GetMinKey());
+                const auto end = std::upper_bound(key, Keys.end(), table->Reader_->GetMaxKey());
+                if (key != end) {
+                    probe(*table, key - Keys.begin(), end - Keys.begin());
+                }
+                key = end;
+            }
+        }
+
+        TableProbes_.fetch_add(probes, std::memory_order_relaxed);
+    }
+
+    // Entries of the active memtable a scan copies out per trip under the lock
+    static constexpr size_t kScanChunk = 256;
+
+    // Streams the active memtable's part of [Key1, Key2] with its tombstones. The memtable keeps changing, so the
+    // entries are copied out kScanChunk at a time under the lock: writers wait for one chunk at most and a scan that
+    // stops early doesn't copy the rest of the range. Constructed under the lock.
+    class ActiveMemtableIterator : public KVIterator<K, V> {
+    public:
+        ActiveMemtableIterator(std::shared_ptr<const MemtableType> Memtable, std::mutex& Mutex, const K& Key1,
+                               const K& Key2)
+            : Memtable_(std::move(Memtable)), Mutex_(Mutex), Key2_(Key2) {
+            Fill(Key1, false);
+        }
+
+        bool Valid() const override {
+            return Pos_ < Entries_.size();
+        }
+
+        const K& Key() const override {
+            return Entries_[Pos_].first;
+        }
+
+        const V& Value() const override {
+            return Entries_[Pos_].second;
+        }
+
+        bool IsDeleted() const override {
+            return Deleted_[Pos_];
+        }
+
+        void Next() override {
+            if (++Pos_ == Entries_.size() && !Done_) {
+                const K last = Entries_.back().first;
+                std::lock_guard<std::mutex> lock(Mutex_);
+                Fill(last, true);
+            }
+        }
+
+    private:
+        std::shared_ptr<const MemtableType> Memtable_;
+        std::mutex& Mutex_;
+        K Key2_;
+        std::vector<std::pair<K, V>> Entries_;
+        std::vector<bool> Deleted_;
+        size_t Pos_{};
+        // The chunk reaches Key2_ or the end of the memtable
+        bool Done_{};
+
+        // Copy the next chunk starting at From (after it if After), needs the lock
+        void Fill(const K& From, bool After) {
+            Entries_.clear();
+            Deleted_.clear();
+            Pos_ = 0;
+            Done_ = true;
+            for (auto it = Memtable_->lower_bound(From); it != Memtable_->end() && !(Key2_ < it.Key()); ++it) {
+                if (After && !(From < it.Key())) {
+                    continue;
+                }
+                if (Entries_.size() == kScanChunk) {
+                    Done_ = false;
+                    break;
+                }
+                Entries_.emplace_back(it.Key(), it.IsDeleted() ? V{} : it.Value());
+                Deleted_.push_back(it.IsDeleted());
+            }
+        }
+    };
+
+    // Streams the immutable memtable from Key1 on without copying it, holding on to it so the flush can't free it
+    class ImmutableMemtableIterator : public KVIterator<K, V> {
+    public:
+        ImmutableMemtableIterator(std::shared_ptr<const MemtableType> Memtable, const K& Key1)
+            : Memtable_(std::move(Memtable)), It_(Memtable_->lower_bound(Key1)), End_(Memtable_->end()) {}
+
+        bool Valid() const override {
+            return It_ != End_;
+        }
+
+        const K& Key() const override {
+            return It_.Key();
+        }
+
+        const V& Value() const override {
+            return It_.Value();
+        }
+
+        bool IsDeleted() const override {
+            return It_.IsDeleted();
+        }
+
+        void Next() override {
+            ++It_;
+        }
+
+    private:
+        std::shared_ptr<const MemtableType> Memtable_;
+        typename AVLTree<K, V>::const_iterator It_;
+        typename AVLTree<K, V>::const_iterator End_;
+    };
+
+    size_t Charge(const Writer& W) const {
+        if (W.Batch_ != nullptr) {
+            return Mem_->Charge(*W.Batch_);
+        }
+        return W.Value_ != nullptr ? Mem_->Charge(*W.Key_, *W.Value_) : Mem_->DeleteCharge(*W.Key_);
+    }
+
+    void Apply(const Writer& W) {
+        bool applied;
+        if (W.Batch_ != nullptr) {
+            applied = Mem_->Write(*W.Batch_);
+        } else if (W.Value_ != nullptr) {
+            applied = Mem_->Put(*W.Key_, *W.Value_);
+        } else {
+            applied = Mem_->Delete(*W.Key_);
+        }
+        // The group was sized to fit, a write turned away here would be in the log but nowhere else
+        assert(applied);
+        (void)applied;
+    }
+
+    // Queue W and wait until it is at the front of Writers_, or until a group committed it
+    void WaitForTurn(Writer& W, std::unique_lock<std::mutex>& Lock) {
+        Writers_.push_back(&W);
+        WriterCv_.wait(Lock, [&] { return W.Done_ || Writers_.front() == &W; });
+    }
+
+    // Hand the front of Writers_ to the next writer
+    void EndTurn() {
+        Writers_.pop_front();
+        WriterCv_.notify_all();
+    }
+
+    // Log W and apply it to the active memtable. The writer at the front of Writers_ switches memtables until its write
+    // fits, takes the writers behind it that fit into the same memtable along, commits all of their records without the
+    // lock and applies them once the commit succeeded. A failed commit applies none of them and fails all of them.
+    void Write(Writer& W) {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        WaitForTurn(W, lock);
+        if (W.Done_) {
+            if (W.Error_) {
+                std::rethrow_exception(W.Error_);
+            }
+            return;
+        }
+
+        try {
+            CheckWritable();
+            while (!Mem_->HasRoomFor(Charge(W))) {
+                if (Mem_->GetEntryCount() == 0) {
+                    throw std::invalid_argument("Entry is larger than the memtable");
+                }
+                MakeRoomForWrite(lock);
+            }
+        } catch (...) {
+            EndTurn();
+            throw;
+        }
+        size_t group = 0;
+        size_t charge = 0;
+        for (const Writer* writer : Writers_) {
+            // A turn of Flush or Close ends the group, it switches memtables
+            if (group > 0 && writer->Record_ == nullptr) {
+                break;
+            }
+            const size_t next = Charge(*writer);
+            if (group > 0 && !Mem_->HasRoomFor(charge + next)) {
+                break;
+            }
+            charge += next;
+            group++;
+        }
+        const std::vector<Writer*> writers(Writers_.begin(), Writers_.begin() + group);
+        const std::shared_ptr<WriteAheadLog> log = Log_;
+        // The group stays at the front of Writers_ until it is applied, so nobody switches Mem_ in the meantime
+        lock.unlock();
+
+        // Only the front writer appends, so the log has the records in queue order
+        std::exception_ptr error;
+        try {
+            uint64_t sequence = 0;
+            for (const Writer* writer : writers) {
+                sequence = log->Append(*writer->Record_);
+            }
+            Commit(*log, sequence);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        for (Writer* writer : writers) {
+            // Nobody else touched Mem_ since the room check, every write of the group still fits
+            if (!error) {
+                Apply(*writer);
+            }
+            writer->Error_ = error;
+            writer->Done_ = true;
+            Writers_.pop_front();
+        }
+        WriterCv_.notify_all();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::string FilePath(uint64_t Number, const char* Extension) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%06llu.%s", static_cast<unsigned long long>(Number), Extension);
+        return (std::filesystem::path(Path_) / name).string();
+    }
+
+    std::string TablePath(uint64_t Number) const {
+        return FilePath(Number, "sst");
+    }
+
+    std::string LogPath(uint64_t Number) const {
+        return FilePath(Number, "log");
+    }
+
+    // How flushes and compactions write their SSTs
+    SSTOptions TableOptions() const {
+        SSTOptions options;
+        options.BloomBitsPerKey_ = Options_.BloomBitsPerKey_;
+        options.RestartInterval_ = Options_.RestartInterval_;
+        options.DirectIO_ = Options_.ReadMode_ == SSTReadMode::kDirect;
+        return options;
+    }
+
+    std::shared_ptr<Table> OpenTable(uint64_t Number) const {
+        SSTReadOptions options;
+        options.PinIndex_ = Options_.PinIndex_;
+        options.Mode_ = Options_.ReadMode_;
+        options.Engine_ = Engine_.get();
+        return std::make_shared<Table>(Number, TablePath(Number), Pool_.get(), options);
+    }
+
+    // Wait for a logged write to be committed, a failing log takes the whole database down
+    void Commit(WriteAheadLog& Log, uint64_t Sequence) {
+        try {
+            Log.Commit(Sequence);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            if (!BgError_) {
+                BgError_ = std::current_exception();
+            }
+            BgCv_.notify_all();
+            WorkCv_.notify_all();
+            throw;
+        }
+    }
+
+    // Hand the active memtable and its log to the flush thread and start new ones, needs the lock and room in Imms_
+    void SwitchMemtable() {
+        auto imms = std::make_shared<ImmutableList>();
+        imms->reserve(Imms_->size() + 1);
+        imms->push_back({std::move(Mem_), std::move(Log_), LogNumber_});
+        imms->insert(imms->end(), Imms_->begin(), Imms_->end());
+        Imms_ = std::move(imms);
+        Mem_ = std::make_shared<MemtableType>(Options_.MemtableSize_);
+        LogNumber_ = NextFileNumber_++;
+        Log_ = std::make_shared<WriteAheadLog>(LogPath(LogNumber_), Options_.WAL_);
+        WorkCv_.notify_all();
+    }
+
+    // Turn the full memtable into an immutable one, stalling while MaxImmutableMemtables_ are already waiting for the
+    // flush or L0 has too many files
+    void MakeRoomForWrite(std::unique_lock<std::mutex>& Lock) {
+        const auto start = std::chrono::steady_clock::now();
+        BgCv_.wait(Lock, [this] {
+            return BgError_ || (Imms_->size() < Options_.MaxImmutableMemtables_ &&
+                                Current_->Levels_[0].size() < Options_.L0StopWritesTrigger_);
+        });
+        Stats_.StallMicros_ +=
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        CheckWritable();
+        SwitchMemtable();
+    }
+
+    void FlushLoop() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        while (true) {
+            WorkCv_.wait(lock, [this] { return ShuttingDown_ || (!Imms_->empty() && !BgError_); });
+            if (Imms_->empty() || BgError_) {
+                return;
+            }
+
+            // Oldest first, so that newer L0 files always hold newer data
+            const Immutable imm = Imms_->back();
+            const uint64_t number = NextFileNumber_++;
+            lock.unlock();
+            try {
+                FlushMemtable(*imm.Memtable_, TablePath(number), TableOptions());
+                auto table = OpenTable(number);
+                lock.lock();
+
+                auto version = std::make_shared<Version>(*Current_);
+                version->Levels_[0].insert(version->Levels_[0].begin(), table);
+                // Only the logs of the memtables that are still in memory are needed anymore
+                auto imms = std::make_shared<ImmutableList>(Imms_->begin(), Imms_->end() - 1);
+                MinLogNumber_ = imms->empty() ? LogNumber_ : imms->back().LogNumber_;
+                InstallVersion(std::move(version));
+                Stats_.Flushes_++;
+                Stats_.BytesWritten_ += table->FileSize_;
+                Imms_ = std::move(imms);
+                const std::shared_ptr<WriteAheadLog> log = imm.Log_;
+
+                // Writers may still be waiting for their commit on the old log, Close lets them finish
+                lock.unlock();
+                log->Close();
+                std::filesystem::remove(log->GetPath());
+                lock.lock();
+            } catch (...) {
+                if (!lock.owns_lock()) {
+                    lock.lock();
+                }
+                BgError_ = std::current_exception();
+            }
+            BgCv_.notify_all();
+            WorkCv_.notify_all();
+        }
+    }
+
+    void CompactionLoop() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        while (true) {
+            std::optional<Compaction> compaction;
+            WorkCv_.wait(lock, [&] {
+                if (ShuttingDown_ || BgError_) {
+                    return true;
+                }
+                compaction = PickCompaction();
+                return compaction.has_value();
+            });
+            if (!compaction) {
+                return;
+            }
+
+            CompactionRunning_ = true;
+            try {
+                RunCompaction(*compaction, lock);
+            } catch (...) {
+                if (!lock.owns_lock()) {
+                    lock.lock();
+                }
+                BgError_ = std::current_exception();
+            }
+            CompactionRunning_ = false;
+            BgCv_.notify_all();
+        }
+    }
+
+    uint64_t LevelTargetSize(size_t Level) const {
+        uint64_t target = Options_.BaseLevelSize_;
+        for (size_t i = 1; i < Level; i++) {
+            target *= Options_.LevelSizeRatio_;
+        }
+        return target;
+    }
+
+    // Pick the level that is the furthest over its limit, L0 is limited by file count and the others by size
+    std::optional<Compaction> PickCompaction() const {
+        const auto& levels = Current_->Levels_;
+        double bestScore = 1;
+        size_t bestLevel = levels.size();
+        if (levels[0].size() >= Options_.L0CompactionTrigger_) {
+            bestScore = static_cast<double>(levels[0].size()) / Options_.L0CompactionTrigger_;
+            bestLevel = 0;
+        }
+        for (size_t level = 1; level + 1 < levels.size(); level++) {
+            uint64_t bytes = 0;
+            for (const auto& table : levels[level]) {
+                bytes += table->FileSize_;
+            }
+            const double score = static_cast<double>(bytes) / LevelTargetSize(level);
+            if (score >= bestScore && !levels[level].empty()) {
+                bestScore = score;
+                bestLevel = level;
+            }
+        }
+        if (bestLevel == levels.size()) {
+            return std::nullopt;
+        }
+
+        Compaction compaction;
+        compaction.Level_ = bestLevel;
+        if (bestLevel == 0) {
+            compaction.Inputs_ = levels[0];
+        } else {
+            // Round robin through the level so that every part of the key space gets compacted eventually
+            const auto& files = levels[bestLevel];
+            auto it = files.begin();
+            if (const auto& pointer = CompactPointers_[bestLevel]) {
+                it = std::find_if(files.begin(), files.end(),
+                                  [&](const auto& Table) { return *pointer < Table->Reader_->GetMinKey(); });
+                if (it == files.end()) {
+                    it = files.begin();
+                }
+            }
+            compaction.Inputs_.push_back(*it);
+        }
+
+        K lo = compaction.Inputs_.front()->Reader_->GetMinKey();
+        K hi = compaction.Inputs_.front()->Reader_->GetMaxKey();
+        for (const auto& table : compaction.Inputs_) {
+            lo = std::min(lo, table->Reader_->GetMinKey());
+            hi = std::max(hi, table->Reader_->GetMaxKey());
+        }
+        for (const auto& table : levels[bestLevel + 1]) {
+            if (table->Overlaps(lo, hi)) {
+                compaction.NextInputs_.push_back(table);
+            }
+        }
+        // Only this thread adds tables below L0, so the answer holds until the compaction is installed
+        compaction.DropTombstones_ = true;
+        for (size_t level = bestLevel + 2; level < levels.size(); level++) {
+            for (const auto& table : levels[level]) {
+                compaction.DropTombstones_ = compaction.DropTombstones_ && !table->Overlaps(lo, hi);
+            }
+        }
+        return compaction;
+    }
+
+    void RunCompaction(const Compaction& Compaction, std::unique_lock<std::mutex>& Lock) {
+        const size_t outputLevel = Compaction.Level_ + 1;
+        std::vector<std::shared_ptr<Table>> outputs;
+
+        if (Compaction.Inputs_.size() == 1 && Compaction.NextInputs_.empty()) {
+            // Nothing to merge with, the file can just move down
+            outputs = Compaction.Inputs_;
+            Stats_.TrivialMoves_++;
+        } else {
+            Lock.unlock();
+            outputs = MergeTables(Compaction, Lock);
+        }
+
+        // Tables only ever leave a version through this thread, so the inputs are still in the current one
+        auto version = std::make_shared<Version>(*Current_);
+        auto isInput = [&](const std::shared_ptr<Table>& Table) {
+            return std::find(Compaction.Inputs_.begin(), Compaction.Inputs_.end(), Table) != Compaction.Inputs_.end() ||
+                   std::find(Compaction.NextInputs_.begin(), Compaction.NextInputs_.end(), Table) !=
+                       Compaction.NextInputs_.end();
+        };
+        auto& inputLevel = version->Levels_[Compaction.Level_];
+        inputLevel.erase(std::remove_if(inputLevel.begin(), inputLevel.end(), isInput), inputLevel.end());
+        auto& nextLevel = version->Levels_[outputLevel];
+        nextLevel.erase(std::remove_if(nextLevel.begin(), nextLevel.end(), isInput), nextLevel.end());
+        nextLevel.insert(nextLevel.end(), outputs.begin(), outputs.end());
+        std::sort(nextLevel.begin(), nextLevel.end(), [](const auto& A, const auto& B) {
+            return A->Reader_->GetMinKey() < B->Reader_->GetMinKey();
+        });
+        InstallVersion(std::move(version));
+
+        if (Compaction.Level_ > 0) {
+            CompactPointers_[Compaction.Level_] = Compaction.Inputs_.back()->Reader_->GetMaxKey();
+        }
+        for (const auto& table : Compaction.Inputs_) {
+            if (std::find(outputs.begin(), outputs.end(), table) == outputs.end()) {
+                table->Obsolete_ = true;
+            }
+        }
+        for (const auto& table : Compaction.NextInputs_) {
+            table->Obsolete_ = true;
+        }
+        Stats_.Compactions_++;
+    }
+
+    // Merge the inputs into new files for the next level, called without the lock and returns with it held
+    std::vector<std::shared_ptr<Table>> MergeTables(const Compaction& Compaction, std::unique_lock<std::mutex>& Lock) {
+        std::vector<std::unique_ptr<KVIterator<K, V>>> children;
+        for (const auto& table : Compaction.Inputs_) {
+            auto it = table->Reader_->NewIterator();
+            it->SeekToFirst();
+            children.push_back(std::move(it));
+        }
+        for (const auto& table : Compaction.NextInputs_) {
+            auto it = table->Reader_->NewIterator();
+            it->SeekToFirst();
+            children.push_back(std::move(it));
+        }
+
+        const SSTOptions options = TableOptions();
+        std::vector<std::shared_ptr<Table>> outputs;
+        std::unique_ptr<SSTWriter<K, V>> writer;
+        uint64_t number = 0;
+        uint64_t bytesWritten = 0;
+
+        auto finishOutput = [&] {
+            writer->Finish();
+            outputs.push_back(OpenTable(number));
+            bytesWritten += outputs.back()->FileSize_;
+            writer.reset();
+        };
+
+        try {
+            for (MergingIterator<K, V> it(std::move(children)); it.Valid(); it.Next()) {
+                if (it.IsDeleted() && Compaction.DropTombstones_) {
+                    continue;
+                }
+                if (writer == nullptr) {
+                    {
+                        std::lock_guard<std::mutex> guard(*Lock.mutex());
+                        number = NextFileNumber_++;
+                    }
+                    writer = std::make_unique<SSTWriter<K, V>>(TablePath(number), options);
+                }
+                if (it.IsDeleted()) {
+                    writer->AddTombstone(it.Key());
+                } else {
+                    writer->Add(it.Key(), it.Value());
+                }
+                if (writer->GetFileSize() >= Options_.TargetFileSize_) {
+                    finishOutput();
+                }
+            }
+            if (writer != nullptr) {
+                finishOutput();
+            }
+        } catch (...) {
+            // Don't leave half written files behind
+            for (const auto& table : outputs) {
+                table->Obsolete_ = true;
+            }
+            if (writer != nullptr) {
+                writer.reset();
+                std::error_code error;
+                std::filesystem::remove(TablePath(number), error);
+            }
+            throw;
+        }
+
+        Lock.lock();
+        Stats_.BytesWritten_ += bytesWritten;
+        return outputs;
+    }
+
+    // Make Version current and record it in the MANIFEST, needs the lock
+    void InstallVersion(std::shared_ptr<const Version> NewVersion) {
+        WriteManifest(*NewVersion);
+        Current_ = std::move(NewVersion);
+        WorkCv_.notify_all();
+        BgCv_.notify_all();
+    }
+
+    // The MANIFEST is a small text file, rewritten in full and renamed into place on every change:
+    //
+    //     next_file <number>
+    //     log <oldest live log number>
+    //     table <level> <number>
+    //     ...
+    void WriteManifest(const Version& Version) const {
+        const std::string path = (std::filesystem::path(Path_) / "MANIFEST").string();
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::trunc);
+            out << "next_file " << NextFileNumber_ << "\n";
+            out << "log " << MinLogNumber_ << "\n";
+            for (size_t level = 0; level < Version.Levels_.size(); level++) {
+                for (const auto& table : Version.Levels_[level]) {
+                    out << "table " << level << " " << table->Number_ << "\n";
+                }
+            }
+            if (!out.flush()) {
+                throw std::runtime_error("Could not write " + tempPath);
+            }
+        }
+        File(tempPath, O_RDONLY).Sync();
+        std::filesystem::rename(tempPath, path);
+        // The rename is only durable once the directory entry is on disk
+        File(Path_, O_RDONLY | O_DIRECTORY).Sync();
+    }
+
+    void LoadManifest() {
+        auto version = std::make_shared<Version>();
+        version->Levels_.resize(Options_.NumLevels_);
+        NextFileNumber_ = 1;
+        MinLogNumber_ = 0;
+
+        const std::string path = (std::filesystem::path(Path_) / "MANIFEST").string();
+        std::vector<uint64_t> live;
+        std::ifstream in(path);
+        std::string tag;
+        while (in >> tag) {
+            if (tag == "next_file") {
+                in >> NextFileNumber_;
+            } else if (tag == "log") {
+                in >> MinLogNumber_;
+            } else if (tag == "table") {
+                size_t level;
+                uint64_t number;
+                in >> level >> number;
+                if (level >= version->Levels_.size()) {
+                    throw std::runtime_error("MANIFEST has more levels than NumLevels_: " + path);
+                }
+                version->Levels_[level].push_back(OpenTable(number));
+                live.push_back(number);
+            } else {
+                throw std::runtime_error("Corrupt MANIFEST: " + path);
+            }
+        }
+
+        // Tables that never made it into the MANIFEST are left overs from an interrupted flush or compaction
+        for (const auto& entry : std::filesystem::directory_iterator(Path_)) {
+            if (entry.path().extension() == ".sst") {
+                const uint64_t number = std::strtoull(entry.path().stem().c_str(), nullptr, 10);
+                if (std::find(live.begin(), live.end(), number) == live.end()) {
+                    std::filesystem::remove(entry.path());
+                }
+            }
+        }
+
+        Current_ = std::move(version);
+    }
+
+    // Replay the logs of memtables that were not flushed before the last shutdown into level 0 and start a new log
+    void RecoverLogs() {
+        std::vector<uint64_t> logs;
+        std::vector<std::filesystem::path> obsolete;
+        for (const auto& entry : std::filesystem::directory_iterator(Path_)) {
+            if (entry.path().extension() == ".log") {
+                const uint64_t number = std::strtoull(entry.path().stem().c_str(), nullptr, 10);
+                NextFileNumber_ = std::max(NextFileNumber_, number + 1);
+                if (number >= MinLogNumber_) {
+                    logs.push_back(number);
+                }
+                obsolete.push_back(entry.path());
+            }
+        }
+        std::sort(logs.begin(), logs.end());
+
+        auto version = std::make_shared<Version>(*Current_);
+        const SSTOptions options = TableOptions();
+        auto memtable = std::make_unique<MemtableType>(Options_.MemtableSize_);
+        auto flush = [&] {
+            const uint64_t number = NextFileNumber_++;
+            FlushMemtable(*memtable, TablePath(number), options);
+            version->Levels_[0].insert(version->Levels_[0].begin(),
+                                       OpenTable(number));
+            Stats_.Flushes_++;
+            Stats_.BytesWritten_ += version->Levels_[0].front()->FileSize_;
+            memtable = std::make_unique<MemtableType>(Options_.MemtableSize_);
+        };
+        for (uint64_t number : logs) {
+            ReadLog(LogPath(number), [&](std::string_view Payload) {
+                DecodeLogEntries<K, V>(Payload, [&](const K& Key, const V* Value) {
+                    auto apply = [&] { return Value != nullptr ? memtable->Put(Key, *Value) : memtable->Delete(Key); };
+                    if (!apply()) {
+                        flush();
+                        apply();
+                    }
+                });
+            });
+        }
+        if (memtable->GetEntryCount() > 0) {
+            flush();
+        }
+
+        LogNumber_ = NextFileNumber_++;
+        MinLogNumber_ = LogNumber_;
+        Log_ = std::make_shared<WriteAheadLog>(LogPath(LogNumber_), Options_.WAL_);
+        WriteManifest(*version);
+        Current_ = std::move(version);
+        // Only now that the MANIFEST has the replayed tables can the old logs go
+        for (const auto& path : obsolete) {
+            std::filesystem::remove(path);
+        }
+    }
+};
+
+}
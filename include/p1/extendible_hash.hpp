@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Extendible hash table.
+//
+// The directory has 2^GlobalDepth slots, each pointing at a bucket of at most BucketCapacity entries. A bucket with
+// local depth d is shared by all slots that agree on the low d bits of the hash. When a bucket overflows it is split
+// in two on the next hash bit (doubling the directory if the bucket was already at global depth), and when a removal
+// leaves a bucket small enough to fit together with its buddy they are merged again, halving the directory once no
+// bucket needs the top bit anymore. Growing and shrinking therefore only ever touches one bucket at a time, and the
+// number of buckets at every local depth tells when the directory can shrink without scanning it.
+//
+// Not thread safe.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ExtendibleHashTable {
+public:
+    explicit ExtendibleHashTable(size_t BucketCapacity = 8) : BucketCapacity_(BucketCapacity) {
+        assert(BucketCapacity_ > 0);
+        Directory_.push_back(new Bucket{0, {}});
+        NumBuckets_ = 1;
+        BucketsAtDepth_.push_back(1);
+    }
+
+    ~ExtendibleHashTable() {
+        // Every bucket is owned by the lowest directory slot pointing at it, walk backwards so that the other slots
+        // are done with it before it is freed
+        for (size_t i = Directory_.size(); i-- > 0;) {
+            if (CanonicalIndex(i, Directory_[i]->LocalDepth_) == i) {
+                delete Directory_[i];
+            }
+        }
+    }
+
+    ExtendibleHashTable(const ExtendibleHashTable&) = delete;
+    ExtendibleHashTable& operator=(const ExtendibleHashTable&) = delete;
+
+    bool Find(const K& Key, V* Value) const {
+        const Bucket* bucket = Directory_[IndexOf(Hash_(Key))];
+        for (const auto& item : bucket->Items_) {
+            if (item.first == Key) {
+                *Value = item.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Insert Key, or overwrite its value if it is already there
+    void Insert(const K& Key, const V& Value) {
+        const size_t hash = Hash_(Key);
+        while (true) {
+            Bucket* bucket = Directory_[IndexOf(hash)];
+            for (auto& item : bucket->Items_) {
+                if (item.first == Key) {
+                    item.second = Value;
+                    return;
+                }
+            }
+            if (bucket->Items_.size() < BucketCapacity_) {
+                bucket->Items_.emplace_back(Key, Value);
+                Size_++;
+                return;
+            }
+            // Splitting may leave everything on one side, in which case we just go around again
+            Split(IndexOf(hash));
+        }
+    }
+
+    bool Remove(const K& Key) {
+        const size_t hash = Hash_(Key);
+        Bucket* bucket = Directory_[IndexOf(hash)];
+        for (size_t i = 0; i < bucket->Items_.size(); i++) {
+            if (bucket->Items_[i].first == Key) {
+                bucket->Items_[i] = std::move(bucket->Items_.back());
+                bucket->Items_.pop_back();
+                Size_--;
+                MergeAndShrink(IndexOf(hash));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t Size() const {
+        return Size_;
+    }
+
+    int GetGlobalDepth() const {
+        return GlobalDepth_;
+    }
+
+    int GetLocalDepth(size_t DirectoryIndex) const {
+        return Directory_[DirectoryIndex]->LocalDepth_;
+    }
+
+    size_t GetNumBuckets() const {
+        return NumBuckets_;
+    }
+
+private:
+    struct Bucket {
+        int LocalDepth_;
+        std::vector<std::pair<K, V>> Items_;
+    };
+
+    const size_t BucketCapacity_;
+    std::vector<Bucket*> Directory_;
+    int GlobalDepth_{};
+    size_t NumBuckets_{};
+    // Number of buckets with each local depth, from 0 to GlobalDepth_
+    std::vector<size_t> BucketsAtDepth_;
+    size_t Size_{};
+    Hash Hash_;
+
+    size_t IndexOf(size_t HashValue) const {
+        return HashValue & ((size_t(1) << GlobalDepth_) - 1);
+    }
+
+    static size_t CanonicalIndex(size_t Index, int LocalDepth) {
+        return Index & ((size_t(1) << LocalDepth) - 1);
+    }
+
+    void Split(size_t Index) {
+        Bucket* bucket = Directory_[Index];
+        if (bucket->LocalDepth_ == GlobalDepth_) {
+            // Double the directory, the new upper half mirrors the lower half
+            const size_t size = Directory_.size();
+            Directory_.reserve(size * 2);
+            for (size_t i = 0; i < size; i++) {
+                Directory_.push_back(Directory_[i]);
+            }
+            GlobalDepth_++;
+            BucketsAtDepth_.push_back(0);
+        }
+
+        const size_t splitBit = size_t(1) << bucket->LocalDepth_;
+        BucketsAtDepth_[bucket->LocalDepth_]--;
+        bucket->LocalDepth_++;
+        BucketsAtDepth_[bucket->LocalDepth_] += 2;
+        auto* image = new Bucket{bucket->LocalDepth_, {}};
+        NumBuckets_++;
+
+        for (size_t i = CanonicalIndex(Index, bucket->LocalDepth_ - 1); i < Directory_.size(); i += splitBit) {
+            if (i & splitBit) {
+                Directory_[i] = image;
+            }
+        }
+
+        std::vector<std::pair<K, V>> items;
+        items.swap(bucket->Items_);
+        for (auto& item : items) {
+            if (Hash_(item.first) & splitBit) {
+                image->Items_.push_back(std::move(item));
+            } else {
+                bucket->Items_.push_back(std::move(item));
+            }
+        }
+    }
+
+    // Merge the bucket at Index with its split image for as long as both fit into one, then shrink the directory
+    void MergeAndShrink(size_t Index) {
+        while (true) {
+            Bucket* bucket = Directory_[Index];
+            const int depth = bucket->LocalDepth_;
+            if (depth == 0) {
+                break;
+            }
+            const size_t buddyIndex = Index ^ (size_t(1) << (depth - 1));
+            Bucket* buddy = Directory_[buddyIndex];
+            if (buddy->LocalDepth_ != depth || bucket->Items_.size() + buddy->Items_.size() > BucketCapacity_) {
+                break;
+            }
+
+            // Fold the higher of the two into the lower one
+            Bucket* keep = (Index & (size_t(1) << (depth - 1))) ? buddy : bucket;
+            Bucket* drop = keep == bucket ? buddy : bucket;
+            for (auto& item : drop->Items_) {
+                keep->Items_.push_back(std::move(item));
+            }
+            keep->LocalDepth_--;
+            BucketsAtDepth_[depth] -= 2;
+            BucketsAtDepth_[depth - 1]++;
+            for (size_t i = CanonicalIndex(Index, depth - 1); i < Directory_.size(); i += size_t(1) << (depth - 1)) {
+                Directory_[i] = keep;
+            }
+            delete drop;
+            NumBuckets_--;
+        }
+
+        // Halve the directory while no bucket distinguishes on the top bit
+        while (GlobalDepth_ > 0 && BucketsAtDepth_[GlobalDepth_] == 0) {
+            Directory_.resize(Directory_.size() / 2);
+            BucketsAtDepth_.pop_back();
+            GlobalDepth_--;
+        }
+    }
+};
+
+}
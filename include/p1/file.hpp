@@ -0,0 +1,247 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace p1 {
+
+// Unit of I/O for every on-disk structure
+constexpr size_t kPageSize = 4096;
+
+// Thin RAII wrapper around a POSIX file descriptor.
+// Every failure is reported as a std::system_error carrying errno and the path of the file.
+class File {
+public:
+    File() = default;
+
+    // Open Path with O_DIRECT so that reads and writes bypass the page cache. Falls back to buffered I/O when the
+    // filesystem refuses O_DIRECT, either at open or on the first transfer, IsDirect() tells which one it got. While it
+    // is direct, buffers, offsets and sizes have to be multiples of kPageSize.
+    static File OpenDirect(const std::string& Path, int Flags, mode_t Mode = 0644) {
+        try {
+            File file(Path, Flags | O_DIRECT, Mode);
+            file.Direct_ = true;
+            file.OpenedDirect_ = true;
+            return file;
+        } catch (const std::system_error& error) {
+            if (error.code().value() != EINVAL) {
+                throw;
+            }
+        }
+        return File(Path, Flags, Mode);
+    }
+
+    File(const std::string& Path, int Flags, mode_t Mode = 0644) : Path_(Path) {
+        do {
+            Fd_ = ::open(Path.c_str(), Flags | O_CLOEXEC, Mode);
+        } while (Fd_ < 0 && errno == EINTR);
+        if (Fd_ < 0) {
+            Throw("open");
+        }
+    }
+
+    ~File() {
+        Close();
+    }
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    File(File&& Other) noexcept
+        : Fd_(std::exchange(Other.Fd_, -1)), Path_(std::move(Other.Path_)), Direct_(Other.Direct_.exchange(false)),
+          OpenedDirect_(std::exchange(Other.OpenedDirect_, false)) {}
+
+    File& operator=(File&& Other) noexcept {
+        if (this != &Other) {
+            Close();
+            Fd_ = std::exchange(Other.Fd_, -1);
+            Path_ = std::move(Other.Path_);
+            Direct_ = Other.Direct_.exchange(false);
+            OpenedDirect_ = std::exchange(Other.OpenedDirect_, false);
+        }
+        return *this;
+    }
+
+    bool IsOpen() const {
+        return Fd_ >= 0;
+    }
+
+    int Fd() const {
+        return Fd_;
+    }
+
+    const std::string& Path() const {
+        return Path_;
+    }
+
+    // Whether transfers bypass the page cache
+    bool IsDirect() const {
+        return Direct_.load(std::memory_order_relaxed);
+    }
+
+    // Write all of Buffer at Offset
+    void Write(const void* Buffer, size_t Size, uint64_t Offset) const {
+        const char* ptr = static_cast<const char*>(Buffer);
+        bool retried = false;
+        while (Size > 0) {
+            const ssize_t written = ::pwrite(Fd_, ptr, Size, Offset);
+            if (written < 0) {
+                if (errno == EINTR || (errno == EINVAL && !std::exchange(retried, true) && DropDirect())) {
+                    continue;
+                }
+                Throw("pwrite");
+            }
+            ptr += written;
+            Offset += written;
+            Size -= written;
+        }
+    }
+
+    // Read exactly Size bytes at Offset, running into the end of the file is an error
+    void Read(void* Buffer, size_t Size, uint64_t Offset) const {
+        char* ptr = static_cast<char*>(Buffer);
+        bool retried = false;
+        while (Size > 0) {
+            const ssize_t read = ::pread(Fd_, ptr, Size, Offset);
+            if (read < 0) {
+                if (errno == EINTR || (errno == EINVAL && !std::exchange(retried, true) && DropDirect())) {
+                    continue;
+                }
+                Throw("pread");
+            }
+            if (read == 0) {
+                throw std::system_error(std::make_error_code(std::errc::io_error), "Short read from " + Path_);
+            }
+            ptr += read;
+            Offset += read;
+            Size -= read;
+        }
+    }
+
+    // Flush the file data (not necessarily the metadata) to disk
+    void Sync() const {
+        if (::fdatasync(Fd_) != 0) {
+            Throw("fdatasync");
+        }
+    }
+
+    uint64_t Size() const {
+        struct stat st {};
+        if (::fstat(Fd_, &st) != 0) {
+            Throw("fstat");
+        }
+        return st.st_size;
+    }
+
+    void Close() {
+        if (Fd_ >= 0) {
+            ::close(Fd_);
+            Fd_ = -1;
+        }
+    }
+
+private:
+    int Fd_{-1};
+    std::string Path_;
+    // Cleared when the filesystem turns out to reject direct transfers after all
+    mutable std::atomic<bool> Direct_{false};
+    bool OpenedDirect_{false};
+
+    // Called when a transfer failed with EINVAL: switch a file opened with O_DIRECT over to buffered I/O (unless
+    // another thread already did) and tell the caller to retry. False for a buffered file, the EINVAL is real then.
+    bool DropDirect() const {
+        if (!OpenedDirect_) {
+            return false;
+        }
+        if (Direct_.exchange(false)) {
+            const int flags = ::fcntl(Fd_, F_GETFL);
+            if (flags < 0 || ::fcntl(Fd_, F_SETFL, flags & ~O_DIRECT) != 0) {
+                Throw("fcntl");
+            }
+        }
+        return true;
+    }
+
+    [[noreturn]] void Throw(const char* Operation) const {
+        throw std::system_error(errno, std::generic_category(), std::string(Operation) + " " + Path_);
+    }
+};
+
+// Read-only shared mapping of a whole file, unmapped again on destruction. Reads through the mapping come straight out
+// of the page cache without a system call or a copy, a page that is not resident is faulted in on first touch.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const File& Source) : Size_(Source.Size()) {
+        if (Size_ == 0) {
+            return;
+        }
+        void* data = ::mmap(nullptr, Size_, PROT_READ, MAP_SHARED, Source.Fd(), 0);
+        if (data == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap " + Source.Path());
+        }
+        Data_ = static_cast<const char*>(data);
+    }
+
+    ~MappedFile() {
+        Unmap();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& Other) noexcept
+        : Data_(std::exchange(Other.Data_, nullptr)), Size_(std::exchange(Other.Size_, 0)) {}
+
+    MappedFile& operator=(MappedFile&& Other) noexcept {
+        if (this != &Other) {
+            Unmap();
+            Data_ = std::exchange(Other.Data_, nullptr);
+            Size_ = std::exchange(Other.Size_, 0);
+        }
+        return *this;
+    }
+
+    bool IsMapped() const {
+        return Data_ != nullptr;
+    }
+
+    const char* Data() const {
+        return Data_;
+    }
+
+    uint64_t Size() const {
+        return Size_;
+    }
+
+    // Pass an madvise hint (MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED, ...) for Size bytes at Offset, which has to
+    // be page aligned. Only a hint, so failures are ignored.
+    void Advise(uint64_t Offset, uint64_t Size, int Advice) const {
+        if (Data_ != nullptr && Size > 0) {
+            ::madvise(const_cast<char*>(Data_) + Offset, Size, Advice);
+        }
+    }
+
+private:
+    const char* Data_{};
+    uint64_t Size_{};
+
+    void Unmap() {
+        if (Data_ != nullptr) {
+            ::munmap(const_cast<char*>(Data_), Size_);
+            Data_ = nullptr;
+        }
+    }
+};
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace p1 {
+
+// Finalizer of splitmix64, turns structured input (sequential ids, page numbers) into well mixed bits.
+// std::hash is the identity for integers in libstdc++, which is useless for anything that looks at bit subsets.
+inline uint64_t Mix64(uint64_t Value) {
+    Value ^= Value >> 30;
+    Value *= 0xBF58476D1CE4E5B9ULL;
+    Value ^= Value >> 27;
+    Value *= 0x94D049BB133111EBULL;
+    Value ^= Value >> 31;
+    return Value;
+}
+
+// Hash of an arbitrary byte string, processes 8 bytes at a time and mixes each word in with Mix64
+inline uint64_t Hash64(const char* Data, size_t Size, uint64_t Seed = 0) {
+    uint64_t hash = Seed ^ (Size * 0x9E3779B97F4A7C15ULL);
+    while (Size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, Data, 8);
+        hash = (hash ^ Mix64(word)) * 0xC2B2AE3D27D4EB4FULL;
+        Data += 8;
+        Size -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, Data, Size);
+    return Mix64(hash ^ tail);
+}
+
+}
@@ -0,0 +1,399 @@
+#pragma once
+
+#include "file.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define P1_HAVE_IO_URING 1
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace p1 {
+
+// One read for an IOEngine: Size_ bytes at Offset_ of Source_ into Buffer_
+struct ReadRequest {
+    const File* Source_;
+    char* Buffer_;
+    size_t Size_;
+    uint64_t Offset_;
+};
+
+// Issues many reads at once instead of one blocking pread after the other, so that a device with internal parallelism
+// (any SSD) works on up to GetQueueDepth() of them at the same time. Safe to use from several threads at once.
+class IOEngine {
+public:
+    virtual ~IOEngine() = default;
+
+    // Complete every request and return once all of them are done. A read that fails is retried with File::Read,
+    // whose exception is passed on if it fails again.
+    virtual void Read(ReadRequest* Requests, size_t Count) = 0;
+
+    virtual size_t GetQueueDepth() const = 0;
+
+    virtual const char* GetName() const = 0;
+};
+
+// Fallback for kernels without io_uring: QueueDepth threads that pread on behalf of the callers
+class ThreadPoolIOEngine : public IOEngine {
+public:
+    explicit ThreadPoolIOEngine(size_t QueueDepth) : QueueDepth_(QueueDepth) {
+        if (QueueDepth == 0) {
+            throw std::invalid_argument("I/O engine needs a queue depth of at least one");
+        }
+        for (size_t i = 0; i < QueueDepth; i++) {
+            Threads_.emplace_back([this] { WorkLoop(); });
+        }
+    }
+
+    ~ThreadPoolIOEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            Stop_ = true;
+        }
+        WorkAvailable_.notify_all();
+        for (std::thread& thread : Threads_) {
+            thread.join();
+        }
+    }
+
+    ThreadPoolIOEngine(const ThreadPoolIOEngine&) = delete;
+    ThreadPoolIOEngine& operator=(const ThreadPoolIOEngine&) = delete;
+
+    void Read(ReadRequest* Requests, size_t Count) override {
+        if (Count == 0) {
+            return;
+        }
+        Batch batch;
+        batch.Remaining_ = Count;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            for (size_t i = 0; i < Count; i++) {
+                Queue_.push_back({&Requests[i], &batch});
+            }
+        }
+        WorkAvailable_.notify_all();
+
+        std::unique_lock<std::mutex> lock(batch.Mutex_);
+        batch.Done_.wait(lock, [&batch] { return batch.Remaining_ == 0; });
+        if (batch.Error_) {
+            std::rethrow_exception(batch.Error_);
+        }
+    }
+
+    size_t GetQueueDepth() const override {
+        return QueueDepth_;
+    }
+
+    const char* GetName() const override {
+        return "thread pool";
+    }
+
+private:
+    // The requests of one Read call, which waits on it until the workers have done all of them
+    struct Batch {
+        std::mutex Mutex_;
+        std::condition_variable Done_;
+        size_t Remaining_{};
+        std::exception_ptr Error_;
+    };
+
+    struct Task {
+        ReadRequest* Request_;
+        Batch* Batch_;
+    };
+
+    const size_t QueueDepth_;
+    std::vector<std::thread> Threads_;
+    std::mutex Mutex_;
+    std::condition_variable WorkAvailable_;
+    std::deque<Task> Queue_;
+    bool Stop_{};
+
+    void WorkLoop() {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(Mutex_);
+                WorkAvailable_.wait(lock, [this] { return Stop_ || !Queue_.empty(); });
+                if (Queue_.empty()) {
+                    return;
+                }
+                task = Queue_.front();
+                Queue_.pop_front();
+            }
+
+            std::exception_ptr error;
+            try {
+                const ReadRequest& request = *task.Request_;
+                request.Source_->Read(request.Buffer_, request.Size_, request.Offset_);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // The batch lives on the stack of the waiting caller, it must not be touched after the last decrement
+            std::lock_guard<std::mutex> lock(task.Batch_->Mutex_);
+            if (error && !task.Batch_->Error_) {
+                task.Batch_->Error_ = error;
+            }
+            if (--task.Batch_->Remaining_ == 0) {
+                task.Batch_->Done_.notify_all();
+            }
+        }
+    }
+};
+
+#if defined(P1_HAVE_IO_URING)
+
+// io_uring engine: a batch goes to the kernel with one system call, and the next requests are submitted as soon as
+// completions make room, so up to QueueDepth reads are in flight the whole time. Concurrent callers each take a ring
+// of their own from a small pool. Talks to the kernel directly instead of through liburing, reads are all it needs.
+class UringIOEngine : public IOEngine {
+public:
+    // Throws a std::system_error when the kernel does not support io_uring (or a seccomp filter forbids it)
+    explicit UringIOEngine(size_t QueueDepth) : QueueDepth_(QueueDepth) {
+        if (QueueDepth == 0) {
+            throw std::invalid_argument("I/O engine needs a queue depth of at least one");
+        }
+        Idle_.push_back(std::make_unique<Ring>(static_cast<unsigned>(QueueDepth)));
+    }
+
+    void Read(ReadRequest* Requests, size_t Count) override {
+        if (Count == 0) {
+            return;
+        }
+        std::unique_ptr<Ring> ring;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            if (!Idle_.empty()) {
+                ring = std::move(Idle_.back());
+                Idle_.pop_back();
+            }
+        }
+        if (ring == nullptr) {
+            ring = std::make_unique<Ring>(static_cast<unsigned>(QueueDepth_));
+        }
+
+        std::vector<size_t> retry;
+        // A ring whose Read threw may hold stale entries, it is closed on the way out instead of going back to Idle_
+        ring->Read(Requests, Count, retry);
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            Idle_.push_back(std::move(ring));
+        }
+        // Short reads and errors, File::Read deals with EINTR, O_DIRECT fallbacks and partial transfers
+        for (size_t index : retry) {
+            const ReadRequest& request = Requests[index];
+            request.Source_->Read(request.Buffer_, request.Size_, request.Offset_);
+        }
+    }
+
+    size_t GetQueueDepth() const override {
+        return QueueDepth_;
+    }
+
+    const char* GetName() const override {
+        return "io_uring";
+    }
+
+private:
+    // A submission and a completion queue shared with the kernel
+    class Ring {
+    public:
+        explicit Ring(unsigned Entries) {
+            io_uring_params params{};
+            Fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, Entries, &params));
+            if (Fd_ < 0) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+            }
+            try {
+                Map(params);
+            } catch (...) {
+                Unmap();
+                ::close(Fd_);
+                throw;
+            }
+        }
+
+        ~Ring() {
+            Unmap();
+            ::close(Fd_);
+        }
+
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        // Run every request through the ring, the indexes of those that came back failed or short go to Retry
+        void Read(ReadRequest* Requests, size_t Count, std::vector<size_t>& Retry) {
+            size_t next = 0;
+            // Queued in the submission ring, submitted to the kernel or not
+            size_t inFlight = 0;
+            // Queued but not yet taken by the kernel
+            unsigned pending = 0;
+            while (next < Count || inFlight > 0) {
+                unsigned tail = *SqTail_;
+                while (next < Count && inFlight < Entries_) {
+                    const unsigned slot = tail & SqMask_;
+                    const ReadRequest& request = Requests[next];
+                    io_uring_sqe& sqe = Sqes_[slot];
+                    std::memset(&sqe, 0, sizeof(sqe));
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = request.Source_->Fd();
+                    sqe.addr = reinterpret_cast<uint64_t>(request.Buffer_);
+                    sqe.len = static_cast<uint32_t>(request.Size_);
+                    sqe.off = request.Offset_;
+                    sqe.user_data = next;
+                    SqArray_[slot] = slot;
+                    tail++;
+                    next++;
+                    inFlight++;
+                    pending++;
+                }
+                __atomic_store_n(SqTail_, tail, __ATOMIC_RELEASE);
+
+                // Hand over what is queued and wait for at least one completion
+                const int submitted = static_cast<int>(
+                    ::syscall(__NR_io_uring_enter, Fd_, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (submitted < 0) {
+                    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                        const int error = errno;
+                        // The kernel may still be reading into the caller's buffers, they must outlive that
+                        Drain(inFlight - pending);
+                        throw std::system_error(error, std::generic_category(), "io_uring_enter");
+                    }
+                } else {
+                    pending -= static_cast<unsigned>(submitted);
+                }
+
+                inFlight -= Reap([&](size_t Index, int Result) {
+                    if (Result != static_cast<int>(Requests[Index].Size_)) {
+                        Retry.push_back(Index);
+                    }
+                });
+            }
+        }
+
+    private:
+        int Fd_{-1};
+        unsigned Entries_{};
+        char* SqRing_{};
+        size_t SqRingSize_{};
+        char* CqRing_{};
+        size_t CqRingSize_{};
+        io_uring_sqe* Sqes_{};
+        size_t SqesSize_{};
+        unsigned* SqTail_{};
+        unsigned SqMask_{};
+        unsigned* SqArray_{};
+        unsigned* CqHead_{};
+        unsigned* CqTail_{};
+        unsigned CqMask_{};
+        io_uring_cqe* Cqes_{};
+
+        // Call Done(index, result) for every completion posted so far and hand their slots back, returns how many
+        template <typename Callback>
+        size_t Reap(Callback&& Done) {
+            unsigned head = *CqHead_;
+            const unsigned completed = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+            size_t count = 0;
+            for (; head != completed; head++, count++) {
+                const io_uring_cqe& cqe = Cqes_[head & CqMask_];
+                Done(static_cast<size_t>(cqe.user_data), cqe.res);
+            }
+            __atomic_store_n(CqHead_, head, __ATOMIC_RELEASE);
+            return count;
+        }
+
+        // Wait for the Submitted requests the kernel took to complete and drop their results. Queued entries it never
+        // took stay behind in the submission ring, which is why a ring that went through this is never used again.
+        void Drain(size_t Submitted) {
+            while (Submitted > 0) {
+                const int result =
+                    static_cast<int>(::syscall(__NR_io_uring_enter, Fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    // Nothing left to wait with, closing the ring cancels whatever is still running
+                    return;
+                }
+                Submitted -= std::min(Submitted, Reap([](size_t, int) {}));
+            }
+        }
+
+        static char* MapRegion(int Fd, size_t Size, off_t Offset) {
+            void* region = ::mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, Offset);
+            if (region == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "mmap io_uring");
+            }
+            return static_cast<char*>(region);
+        }
+
+        void Map(const io_uring_params& Params) {
+            Entries_ = Params.sq_entries;
+            SqRingSize_ = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+            CqRingSize_ = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+            // Newer kernels put both rings into one mapping
+            const bool single = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) {
+                SqRingSize_ = CqRingSize_ = std::max(SqRingSize_, CqRingSize_);
+            }
+            SqRing_ = MapRegion(Fd_, SqRingSize_, IORING_OFF_SQ_RING);
+            CqRing_ = single ? SqRing_ : MapRegion(Fd_, CqRingSize_, IORING_OFF_CQ_RING);
+            SqesSize_ = Params.sq_entries * sizeof(io_uring_sqe);
+            Sqes_ = reinterpret_cast<io_uring_sqe*>(MapRegion(Fd_, SqesSize_, IORING_OFF_SQES));
+
+            SqTail_ = reinterpret_cast<unsigned*>(SqRing_ + Params.sq_off.tail);
+            SqMask_ = *reinterpret_cast<unsigned*>(SqRing_ + Params.sq_off.ring_mask);
+            SqArray_ = reinterpret_cast<unsigned*>(SqRing_ + Params.sq_off.array);
+            CqHead_ = reinterpret_cast<unsigned*>(CqRing_ + Params.cq_off.head);
+            CqTail_ = reinterpret_cast<unsigned*>(CqRing_ + Params.cq_off.tail);
+            CqMask_ = *reinterpret_cast<unsigned*>(CqRing_ + Params.cq_off.ring_mask);
+            Cqes_ = reinterpret_cast<io_uring_cqe*>(CqRing_ + Params.cq_off.cqes);
+        }
+
+        void Unmap() {
+            if (Sqes_ != nullptr) {
+                ::munmap(Sqes_, SqesSize_);
+            }
+            if (CqRing_ != nullptr && CqRing_ != SqRing_) {
+                ::munmap(CqRing_, CqRingSize_);
+            }
+            if (SqRing_ != nullptr) {
+                ::munmap(SqRing_, SqRingSize_);
+            }
+        }
+    };
+
+    const size_t QueueDepth_;
+    std::mutex Mutex_;
+    std::vector<std::unique_ptr<Ring>> Idle_;
+};
+
+#endif
+
+// io_uring where the kernel has it, the thread pool otherwise
+inline std::unique_ptr<IOEngine> NewIOEngine(size_t QueueDepth) {
+#if defined(P1_HAVE_IO_URING)
+    try {
+        return std::make_unique<UringIOEngine>(QueueDepth);
+    } catch (const std::system_error&) {
+    }
+#endif
+    return std::make_unique<ThreadPoolIOEngine>(QueueDepth);
+}
+
+}
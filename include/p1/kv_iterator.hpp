@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Forward cursor over sorted key-value pairs, the common interface that lets memtables and SSTs be merged
+template <typename K, typename V>
+class KVIterator {
+public:
+    virtual ~KVIterator() = default;
+
+    virtual bool Valid() const = 0;
+    virtual const K& Key() const = 0;
+    virtual const V& Value() const = 0;
+    virtual void Next() = 0;
+
+    // Whether the current entry is a tombstone, its Value() is then meaningless
+    virtual bool IsDeleted() const {
+        return false;
+    }
+};
+
+// Iterates over an already sorted vector it owns. Deleted, when given, flags the entries that are tombstones.
+template <typename K, typename V>
+class VectorIterator : public KVIterator<K, V> {
+public:
+    explicit VectorIterator(std::vector<std::pair<K, V>> Entries, std::vector<bool> Deleted = {})
+        : Entries_(std::move(Entries)), Deleted_(std::move(Deleted)) {}
+
+    bool Valid() const override {
+        return Index_ < Entries_.size();
+    }
+
+    const K& Key() const override {
+        return Entries_[Index_].first;
+    }
+
+    const V& Value() const override {
+        return Entries_[Index_].second;
+    }
+
+    bool IsDeleted() const override {
+        return !Deleted_.empty() && Deleted_[Index_];
+    }
+
+    void Next() override {
+        Index_++;
+    }
+
+private:
+    std::vector<std::pair<K, V>> Entries_;
+    std::vector<bool> Deleted_;
+    size_t Index_{};
+};
+
+// Merges several sorted iterators into one.
+// Children are ordered newest first: when several of them hold the same key, only the entry of the first one is
+// returned and the older ones are skipped. A tombstone is returned like any other entry, so that it hides the older
+// versions of its key.
+template <typename K, typename V>
+class MergingIterator : public KVIterator<K, V> {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<KVIterator<K, V>>> Children) : Children_(std::move(Children)) {
+        for (size_t i = 0; i < Children_.size(); i++) {
+            if (Children_[i]->Valid()) {
+                Heap_.push_back(i);
+            }
+        }
+        std::make_heap(Heap_.begin(), Heap_.end(), Later{this});
+    }
+
+    bool Valid() const override {
+        return !Heap_.empty();
+    }
+
+    const K& Key() const override {
+        return Children_[Heap_.front()]->Key();
+    }
+
+    const V& Value() const override {
+        return Children_[Heap_.front()]->Value();
+    }
+
+    bool IsDeleted() const override {
+        return Children_[Heap_.front()]->IsDeleted();
+    }
+
+    void Next() override {
+        const K current = Key();
+        // Advance the child we just returned and every older child sitting on the same key
+        do {
+            std::pop_heap(Heap_.begin(), Heap_.end(), Later{this});
+            KVIterator<K, V>* child = Children_[Heap_.back()].get();
+            child->Next();
+            if (child->Valid()) {
+                std::push_heap(Heap_.begin(), Heap_.end(), Later{this});
+            } else {
+                Heap_.pop_back();
+            }
+        } while (!Heap_.empty() && !(current < Key()));
+    }
+
+private:
+    // Heap order: smallest key first, ties go to the newest child
+    struct Later {
+        const MergingIterator* Self_;
+
+        bool operator()(size_t A, size_t B) const {
+            const K& a = Self_->Children_[A]->Key();
+            const K& b = Self_->Children_[B]->Key();
+            if (b < a) {
+                return true;
+            }
+            if (a < b) {
+                return false;
+            }
+            return A > B;
+        }
+    };
+
+    std::vector<std::unique_ptr<KVIterator<K, V>>> Children_;
+    std::vector<size_t> Heap_;
+};
+
+}
@@ -1,92 +1,298 @@
 #pragma once
 
 #include "avl_tree.hpp"
+#include "write_batch.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <numeric>
+#include <optional>
+#include <utility>
 #include <vector>
 #include <stdexcept>
+#include <type_traits>
 
 namespace p1 {
 
-template<typename K, typename V>
+// Positions of keys in ascending key order, the order the batched lookups (MultiLookup) want them in
+template <typename K>
+std::vector<size_t> SortedOrder(const std::vector<K>& keys) {
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t A, size_t B) {
+        return keys[A] < keys[B];
+    });
+    return order;
+}
+
+template <typename Index, typename = void>
+struct HasMultiLookup : std::false_type {};
+
+template <typename Index>
+struct HasMultiLookup<Index, std::void_t<decltype(&Index::MultiLookup)>> : std::true_type {};
+
+// Index is the ordered structure the entries live in. It defaults to the AVLTree, ConcurrentSkipList (skiplist.hpp)
+// can be plugged in instead when several threads need to write into the same memtable without an external lock.
+template<typename K, typename V, typename Index = AVLTree<K, V>>
 class Memtable {
 public:
+    // Whether Put/Get/Scan may be called from several threads at once
+    static constexpr bool kThreadSafe = Index::kThreadSafe;
+
     explicit Memtable(size_t size_limit) 
         : size_limit_(size_limit), current_size_(0) {}
 
     ~Memtable() = default;
 
+    // Returns false without inserting anything when the entry would push the memtable over its limit. Sizes are the
+    // real memory footprint of the entries (see Index::EntrySize), an overwrite is admitted as if it was a new entry
+    // but with the AVLTree only the change in size is charged.
     bool Put(const K& key, const V& value) {
-        // Calculate size of new entry, assuming fixed sizes
-        const size_t entry_size = sizeof(K) + sizeof(V);
-        
-        if (current_size_ + entry_size > size_limit_) {
+        return Admit(Index::EntrySize(key, value), [&] { tree_.Put(key, value); });
+    }
+
+    // Fill an empty memtable from [first, last), (key, value) pairs in strictly increasing key order, in O(n) instead
+    // of one Put per entry (see AVLTree::BulkLoad). Returns false without loading anything when they don't all fit.
+    template <typename ForwardIt>
+    bool BulkLoad(ForwardIt first, ForwardIt last) {
+        size_t size = 0;
+        for (ForwardIt it = first; it != last; ++it) {
+            size += Index::EntrySize(it->first, it->second);
+        }
+        if (GetCurrentSize() + size > size_limit_) {
             return false;
         }
-
-        // Insert into AVL tree
-        tree_.InsertKey(key, value);
-        current_size_ += entry_size;
+        tree_.BulkLoad(first, last);
+        current_size_.store(tree_.GetTotalDataSize(), std::memory_order_relaxed);
         return true;
     }
 
-    // Get a value by key
-    V Get(const K& key) const {
-        return tree_.GetValue(key);
+    // Record a tombstone for key, which hides it from Get and Scan here and shadows older versions of it in older
+    // memtables and SSTs. Tombstones carry no value and are charged Index::TombstoneSize. Like Put, returns false
+    // without recording anything when the memtable has no room left.
+    bool Delete(const K& key) {
+        return Admit(Index::TombstoneSize(key), [&] { tree_.Delete(key); });
+    }
+
+    // Apply every operation of batch, or return false without applying any when they don't all fit. Each key is
+    // charged once, for the last operation on it. The batch is applied in key order, readers of a concurrent index
+    // can see part of it while that is going on.
+    bool Write(const WriteBatch<K, V>& batch) {
+        const auto entries = batch.GetSortedEntries();
+        size_t charge = 0;
+        for (const auto* entry : entries) {
+            charge += entry->Deleted_ ? Index::TombstoneSize(entry->Key_) : Index::EntrySize(entry->Key_, entry->Value_);
+        }
+        return Admit(charge, [&] {
+            for (const auto* entry : entries) {
+                if (entry->Deleted_) {
+                    tree_.Delete(entry->Key_);
+                } else {
+                    tree_.Put(entry->Key_, entry->Value_);
+                }
+            }
+        });
+    }
+
+    // Get a value by key, nullopt when the key was never written or has been deleted. Misses don't throw.
+    std::optional<V> Get(const K& key) const {
+        return tree_.TryGet(key);
+    }
+
+    // Pointer to the value of key without copying it, nullptr on a miss or a deleted key. Valid until the key is
+    // written again or the memtable is cleared.
+    const V* Find(const K& key) const {
+        return tree_.Find(key);
+    }
+
+    // Like Get, but tells a deleted key (kDeleted, older data must not be consulted) from an unknown one (kNotFound)
+    LookupStatus Lookup(const K& key, V* value) const {
+        return tree_.Lookup(key, value);
+    }
+
+    // Lookup for every key of keys[0..count) whose status in statuses is still kNotFound, keys sorted ascending. The
+    // AVLTree answers the whole batch in one walk down the tree, other indexes get one Lookup per key.
+    void MultiLookup(const K* keys, size_t count, LookupStatus* statuses, V* values) const {
+        if constexpr (HasMultiLookup<Index>::value) {
+            tree_.MultiLookup(keys, count, statuses, values);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                if (statuses[i] == LookupStatus::kNotFound) {
+                    statuses[i] = tree_.Lookup(keys[i], &values[i]);
+                }
+            }
+        }
+    }
+
+    // Get for many keys at once, result[i] belongs to keys[i]. The keys are sorted first (see MultiLookup), which is
+    // what makes this cheaper than a Get per key for batches of more than a few keys.
+    std::vector<std::optional<V>> MultiGet(const std::vector<K>& keys) const {
+        const std::vector<size_t> order = SortedOrder(keys);
+        std::vector<K> sorted;
+        sorted.reserve(keys.size());
+        for (size_t i : order) {
+            sorted.push_back(keys[i]);
+        }
+        std::vector<LookupStatus> statuses(keys.size(), LookupStatus::kNotFound);
+        std::vector<V> values(keys.size());
+        MultiLookup(sorted.data(), sorted.size(), statuses.data(), values.data());
+
+        std::vector<std::optional<V>> result(keys.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            if (statuses[i] == LookupStatus::kFound) {
+                result[order[i]] = std::move(values[i]);
+            }
+        }
+        return result;
     }
 
     // Scan for all key-value pairs in range [key1, key2]
     std::vector<std::pair<K, V>> Scan(const K& key1, const K& key2) const {
-        return tree_.RangeQuery(key1, key2);
+        return tree_.Scan(key1, key2);
+    }
+
+    // Stream all key-value pairs in range [key1, key2] to callback without materializing them.
+    // callback(key, value) returns false to stop the scan early. Deleted keys are skipped.
+    template <typename Callback>
+    void Scan(const K& key1, const K& key2, Callback&& callback) const {
+        tree_.Scan(key1, key2, std::forward<Callback>(callback));
+    }
+
+    // Like Scan, but deleted keys are passed to callback(key, value) as well, with a null value
+    template <typename Callback>
+    void ScanWithTombstones(const K& key1, const K& key2, Callback&& callback) const {
+        tree_.ScanWithTombstones(key1, key2, std::forward<Callback>(callback));
+    }
+
+    // Visit every live entry in key order, callback(key, value) returns false to stop
+    template <typename Callback>
+    void InOrderTraversal(Callback&& callback) const {
+        tree_.InOrderTraversal(std::forward<Callback>(callback));
     }
 
+    // Visit every entry in key order with tombstones as null values, what a flush writes out
+    template <typename Callback>
+    void ForEach(Callback&& callback) const {
+        tree_.ForEach(std::forward<Callback>(callback));
+    }
+
+    // Bytes held by the entries, nodes and heap allocations of keys and values included
     size_t GetCurrentSize() const {
-        return current_size_;
+        return current_size_.load(std::memory_order_relaxed);
     }
 
     size_t GetSizeLimit() const {
         return size_limit_;
     }
 
+    // Bytes Put(key, value) adds to the memtable at most
+    size_t Charge(const K& key, const V& value) const {
+        return Index::EntrySize(key, value);
+    }
+
+    // Same for Delete(key)
+    size_t DeleteCharge(const K& key) const {
+        return Index::TombstoneSize(key);
+    }
+
+    // Same for Write(batch). Charges every operation, so a batch writing a key more than once is charged more than
+    // Write will take.
+    size_t Charge(const WriteBatch<K, V>& batch) const {
+        size_t charge = 0;
+        for (const auto& entry : batch.GetEntries()) {
+            charge += entry.Deleted_ ? DeleteCharge(entry.Key_) : Charge(entry.Key_, entry.Value_);
+        }
+        return charge;
+    }
+
+    // Whether size more bytes fit under the limit right now. Callers that must know before writing anywhere else (the
+    // write-ahead log) ask first with one of the charges above, with concurrent writers the answer can be stale by the
+    // time they Put.
+    bool HasRoomFor(size_t size) const {
+        return GetCurrentSize() + size <= size_limit_;
+    }
+
+    // Whether Put(key, value) would fit right now
+    bool HasRoomFor(const K& key, const V& value) const {
+        return HasRoomFor(Charge(key, value));
+    }
+
+    // Same for Delete(key)
+    bool HasRoomForDelete(const K& key) const {
+        return HasRoomFor(DeleteCharge(key));
+    }
+
+    // Same for Write(batch), which may turn away a batch writing a key more than once although Write would take it
+    bool HasRoomFor(const WriteBatch<K, V>& batch) const {
+        return HasRoomFor(Charge(batch));
+    }
+
     // Check if memtable needs to be flushed
     bool NeedsFlush() const {
-        return current_size_ >= size_limit_;
+        return GetCurrentSize() >= size_limit_;
     }
 
+    // Tombstones included
     size_t GetEntryCount() const {
         return tree_.GetSize();
     }
 
-    void Clear() {
-        tree_.Clear();
-        current_size_ = 0;
-    }
-
-    // Get iterator to the beginning (for in-order traversal)
-    auto begin() {
-        return tree_.begin();
+    // Number of tombstones, lets a flush policy react to delete heavy memtables
+    size_t GetTombstoneCount() const {
+        return tree_.GetTombstoneCount();
     }
 
-    // Get iterator to the end
-    auto end() {
-        return tree_.end();
+    // Not thread safe, even with a concurrent index
+    void Clear() {
+        tree_.Clear();
+        current_size_.store(0, std::memory_order_relaxed);
     }
 
-    // Get const iterator to the beginning
+    // Iterators over every entry in key order, tombstones included (IsDeleted()). They stream straight out of the
+    // index without copying. Only the AVLTree (bidirectional, any Put of a new key invalidates them) and the skiplist
+    // (forward, safe to use while other threads Put) have them.
     auto begin() const {
         return tree_.begin();
     }
 
-    // Get const iterator to the end
     auto end() const {
         return tree_.end();
     }
 
+    // Iterator on the first entry with a key >= key
+    auto lower_bound(const K& key) const {
+        return tree_.lower_bound(key);
+    }
+
 private:
-    AVLTree<K, V> tree_;
+    Index tree_;
     const size_t size_limit_;    
-    size_t current_size_;
+    std::atomic<size_t> current_size_;
+
+    // Run insert if entry_size more bytes fit under the limit
+    template <typename Insert>
+    bool Admit(size_t entry_size, Insert&& insert) {
+        if constexpr (kThreadSafe) {
+            // Reserve the space up front so that concurrent writers can never overshoot the limit together
+            size_t current = current_size_.load(std::memory_order_relaxed);
+            do {
+                if (current + entry_size > size_limit_) {
+                    return false;
+                }
+            } while (!current_size_.compare_exchange_weak(current, current + entry_size, std::memory_order_relaxed));
+
+            insert();
+        } else {
+            if (GetCurrentSize() + entry_size > size_limit_) {
+                return false;
+            }
+            insert();
+            current_size_.store(tree_.GetTotalDataSize(), std::memory_order_relaxed);
+        }
+        return true;
+    }
 
     Memtable(const Memtable&) = delete;
     Memtable& operator=(const Memtable&) = delete;
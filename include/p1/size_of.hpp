@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace p1 {
+
+// Bytes glibc's malloc really takes for a request of Bytes: an 8 byte chunk header, 16 byte granularity and a 32 byte
+// minimum chunk
+constexpr size_t MallocSize(size_t Bytes) {
+    return Bytes == 0 ? 0 : std::max<size_t>(32, (Bytes + 8 + 15) & ~size_t(15));
+}
+
+// Heap memory a value owns on top of its sizeof(T), which is what memtables charge for variable length keys and
+// values. Types without a specialization are assumed to own nothing.
+template <typename T, typename = void>
+struct HeapSize {
+    static size_t Of(const T& /*Value*/) {
+        return 0;
+    }
+};
+
+// Short strings live inside the object itself, only longer ones own a heap buffer of capacity() + 1 bytes
+template <typename CharT, typename Traits, typename Alloc>
+struct HeapSize<std::basic_string<CharT, Traits, Alloc>> {
+    static size_t Of(const std::basic_string<CharT, Traits, Alloc>& Value) {
+        const char* data = reinterpret_cast<const char*>(Value.data());
+        const char* self = reinterpret_cast<const char*>(&Value);
+        if (data >= self && data < self + sizeof(Value)) {
+            return 0;
+        }
+        return MallocSize((Value.capacity() + 1) * sizeof(CharT));
+    }
+};
+
+template <typename T, typename Alloc>
+struct HeapSize<std::vector<T, Alloc>> {
+    static size_t Of(const std::vector<T, Alloc>& Value) {
+        size_t size = MallocSize(Value.capacity() * sizeof(T));
+        if constexpr (!std::is_trivially_copyable_v<T>) {
+            for (const T& element : Value) {
+                size += HeapSize<T>::Of(element);
+            }
+        }
+        return size;
+    }
+};
+
+}
@@ -0,0 +1,417 @@
+#pragma once
+
+#include "arena.hpp"
+#include "size_of.hpp"
+#include "status.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace p1 {
+
+// Concurrent skiplist that can be used as the index of a Memtable instead of the AVLTree.
+//
+// Inserts are lock-free: a new node is linked in one level at a time from the bottom up with a CAS on its
+// predecessor, and a failed CAS only recomputes the splice for that level. Readers never retry or block, they just
+// follow the next pointers with acquire loads, so Get and Scan are wait-free with respect to writers.
+//
+// Nodes are never removed or modified once published. Putting a key that already exists links the new version in
+// front of the old one, lookups always see the newest version first and scans skip the older ones. Delete is a Put of
+// a tombstone version.
+// Clear() is the only operation that is not safe to run concurrently with anything else.
+template <typename K, typename V>
+class ConcurrentSkipList {
+public:
+    static constexpr bool kThreadSafe = true;
+    static constexpr int kMaxHeight = 20;
+    // Each level holds roughly 1/kBranching of the nodes of the level below it
+    static constexpr unsigned kBranching = 4;
+
+    struct SkipNode {
+        SkipNode(const K& Key, const V& Value, int Height, bool Deleted)
+            : Key_(Key), Value_(Value), Height_(Height), Deleted_(Deleted) {}
+        K Key_;
+        V Value_;
+        int Height_;
+        // Tombstone version, Value_ is default constructed
+        bool Deleted_;
+
+        SkipNode* Next(int Level) const {
+            return Tower()[Level].load(std::memory_order_acquire);
+        }
+
+        void SetNextRelaxed(int Level, SkipNode* Node) {
+            Tower()[Level].store(Node, std::memory_order_relaxed);
+        }
+
+        bool CasNext(int Level, SkipNode* Expected, SkipNode* Node) {
+            return Tower()[Level].compare_exchange_strong(Expected, Node, std::memory_order_release,
+                                                          std::memory_order_relaxed);
+        }
+
+        // The tower of next pointers is allocated right behind the node
+        std::atomic<SkipNode*>* Tower() const {
+            return reinterpret_cast<std::atomic<SkipNode*>*>(
+                const_cast<char*>(reinterpret_cast<const char*>(this)) + TowerOffset());
+        }
+
+        static constexpr size_t TowerOffset() {
+            return (sizeof(SkipNode) + alignof(std::atomic<SkipNode*>) - 1) & ~(alignof(std::atomic<SkipNode*>) - 1);
+        }
+    };
+
+    // Forward iterator over the newest version of every key in order, tombstones included (IsDeleted()). It follows
+    // level 0 with acquire loads like Scan, so it stays valid while other threads Put: nodes they link in after the
+    // iterator has passed by are not seen, ones ahead of it are.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SkipNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const SkipNode*;
+        using reference = const SkipNode&;
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            assert(Node_ != nullptr);
+            return *Node_;
+        }
+
+        pointer operator->() const {
+            return Node_;
+        }
+
+        const K& Key() const {
+            return Node_->Key_;
+        }
+
+        const V& Value() const {
+            return Node_->Value_;
+        }
+
+        bool IsDeleted() const {
+            return Node_->Deleted_;
+        }
+
+        const_iterator& operator++() {
+            Node_ = NextVersion(Node_);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& Other) const {
+            return Node_ == Other.Node_;
+        }
+
+        bool operator!=(const const_iterator& Other) const {
+            return !(*this == Other);
+        }
+
+    private:
+        friend class ConcurrentSkipList;
+
+        SkipNode* Node_{};
+
+        explicit const_iterator(SkipNode* Node) : Node_(Node) {}
+    };
+
+    ConcurrentSkipList() : Head_(NewHead()), MaxHeight_(1), Size_(0), TombstoneCount_(0) {}
+
+    ~ConcurrentSkipList() {
+        DestroyNodes();
+    }
+
+    ConcurrentSkipList(const ConcurrentSkipList&) = delete;
+    ConcurrentSkipList& operator=(const ConcurrentSkipList&) = delete;
+
+    void Put(const K& Key, const V& Value) {
+        Insert(Key, Value, false);
+    }
+
+    // Link in a tombstone version of Key, which hides it from Get and Scan and shadows older versions once flushed
+    void Delete(const K& Key) {
+        Insert(Key, V{}, true);
+        TombstoneCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    V& Get(const K& Key) {
+        return const_cast<V&>(static_cast<const ConcurrentSkipList*>(this)->Get(Key));
+    }
+
+    // Throws if Key is not in the list or its newest version is a tombstone
+    const V& Get(const K& Key) const {
+        SkipNode* node = FindGreaterOrEqual(Key);
+        if (node == nullptr || Key < node->Key_ || node->Deleted_) {
+            throw std::runtime_error("Could not find provided key in skiplist");
+        }
+        return node->Value_;
+    }
+
+    // Pointer to the newest value of Key, nullptr when there is none or it is a tombstone. Nodes are never modified,
+    // so the pointer stays valid until Clear().
+    const V* Find(const K& Key) const {
+        SkipNode* node = FindGreaterOrEqual(Key);
+        if (node == nullptr || Key < node->Key_) {
+            return nullptr;
+        }
+        return VisibleValue(node);
+    }
+
+    std::optional<V> TryGet(const K& Key) const {
+        if (const V* value = Find(Key)) {
+            return *value;
+        }
+        return std::nullopt;
+    }
+
+    // Point lookup on the newest version of Key, the value is copied to *Value only when it is found
+    LookupStatus Lookup(const K& Key, V* Value) const {
+        SkipNode* node = FindGreaterOrEqual(Key);
+        if (node == nullptr || Key < node->Key_) {
+            return LookupStatus::kNotFound;
+        }
+        if (node->Deleted_) {
+            return LookupStatus::kDeleted;
+        }
+        *Value = node->Value_;
+        return LookupStatus::kFound;
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& Key1, const K& Key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(Key1, Key2, [&](const K& Key, const V& Value) {
+            result.emplace_back(Key, Value);
+            return true;
+        });
+        return result;
+    }
+
+    // Stream the newest version of every key in [Key1, Key2] to callback until it returns false, deleted keys are
+    // skipped
+    template <typename Callback>
+    void Scan(const K& Key1, const K& Key2, Callback&& callback) const {
+        ScanWithTombstones(Key1, Key2, [&callback](const K& Key, const V* Value) {
+            return Value == nullptr || callback(Key, *Value);
+        });
+    }
+
+    // Like Scan, but keys whose newest version is a tombstone are passed to callback(key, value) with a null value
+    template <typename Callback>
+    void ScanWithTombstones(const K& Key1, const K& Key2, Callback&& callback) const {
+        for (SkipNode* node = FindGreaterOrEqual(Key1); node != nullptr && !(Key2 < node->Key_);
+             node = NextVersion(node)) {
+            if (!callback(node->Key_, VisibleValue(node))) {
+                return;
+            }
+        }
+    }
+
+    // Visit the newest version of every key in order, tombstones as null values, until callback returns false
+    template <typename Callback>
+    void ForEach(Callback&& callback) const {
+        for (SkipNode* node = Head_->Next(0); node != nullptr; node = NextVersion(node)) {
+            if (!callback(node->Key_, VisibleValue(node))) {
+                return;
+            }
+        }
+    }
+
+    // Visit the newest version of every live key in order until callback returns false
+    template <typename Callback>
+    void InOrderTraversal(Callback&& callback) const {
+        ForEach([&callback](const K& Key, const V* Value) {
+            return Value == nullptr || callback(Key, *Value);
+        });
+    }
+
+    const_iterator begin() const {
+        return const_iterator(Head_->Next(0));
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    // Iterator on the newest version of the first key >= key, end() if there is none. O(log n) expected
+    const_iterator lower_bound(const K& key) const {
+        return const_iterator(FindGreaterOrEqual(key));
+    }
+
+    // Expected memory a Put adds: the node with an average tower of kBranching / (kBranching - 1) pointers plus
+    // whatever the key and value own on the heap. Every Put adds a node, overwrites included.
+    static size_t EntrySize(const K& Key, const V& Value) {
+        return TombstoneSize(Key) + HeapSize<V>::Of(Value);
+    }
+
+    // Expected memory a Delete adds, a node without a value payload
+    static size_t TombstoneSize(const K& Key) {
+        return SkipNode::TowerOffset() + sizeof(std::atomic<SkipNode*>) * kBranching / (kBranching - 1) +
+               HeapSize<K>::Of(Key);
+    }
+
+    // Number of Put and Delete calls, older versions of a key are included
+    size_t GetSize() const {
+        return Size_.load(std::memory_order_relaxed);
+    }
+
+    // Number of Delete calls
+    size_t GetTombstoneCount() const {
+        return TombstoneCount_.load(std::memory_order_relaxed);
+    }
+
+    bool IsEmpty() const {
+        return Head_->Next(0) == nullptr;
+    }
+
+    void Clear() {
+        DestroyNodes();
+        Arena_.Reset();
+        Head_ = NewHead();
+        MaxHeight_.store(1, std::memory_order_relaxed);
+        Size_.store(0, std::memory_order_relaxed);
+        TombstoneCount_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t GetAllocatedMemory() const {
+        return Arena_.GetMemoryUsage();
+    }
+
+private:
+    ConcurrentArena Arena_;
+    SkipNode* Head_;
+    std::atomic<int> MaxHeight_;
+    std::atomic<size_t> Size_;
+    std::atomic<size_t> TombstoneCount_;
+
+    void Insert(const K& Key, const V& Value, bool Deleted) {
+        const int height = RandomHeight();
+        SkipNode* node = NewNode(Key, Value, height, Deleted);
+
+        // Raise the list height first, readers that see the new height early just find nullptr at the top
+        int maxHeight = MaxHeight_.load(std::memory_order_relaxed);
+        while (height > maxHeight) {
+            if (MaxHeight_.compare_exchange_weak(maxHeight, height, std::memory_order_relaxed)) {
+                maxHeight = height;
+                break;
+            }
+        }
+
+        SkipNode* prev[kMaxHeight + 1];
+        SkipNode* next[kMaxHeight + 1];
+        prev[maxHeight] = Head_;
+        next[maxHeight] = nullptr;
+        for (int level = maxHeight - 1; level >= 0; level--) {
+            FindSpliceForLevel(Key, prev[level + 1], level, &prev[level], &next[level]);
+        }
+
+        // Link bottom up, once level 0 succeeds the node is visible to everyone
+        for (int level = 0; level < height; level++) {
+            while (true) {
+                node->SetNextRelaxed(level, next[level]);
+                if (prev[level]->CasNext(level, next[level], node)) {
+                    break;
+                }
+                // Someone else got in between prev and next, find the new splice starting from prev
+                FindSpliceForLevel(Key, prev[level], level, &prev[level], &next[level]);
+            }
+        }
+        Size_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    SkipNode* NewNode(const K& Key, const V& Value, int Height, bool Deleted) {
+        void* memory = Arena_.Allocate(SkipNode::TowerOffset() + sizeof(std::atomic<SkipNode*>) * Height);
+        SkipNode* node = new (memory) SkipNode(Key, Value, Height, Deleted);
+        for (int level = 0; level < Height; level++) {
+            new (&node->Tower()[level]) std::atomic<SkipNode*>(nullptr);
+        }
+        return node;
+    }
+
+    SkipNode* NewHead() {
+        return NewNode(K{}, V{}, kMaxHeight, false);
+    }
+
+    void DestroyNodes() {
+        if constexpr (!std::is_trivially_destructible_v<SkipNode>) {
+            SkipNode* node = Head_;
+            while (node != nullptr) {
+                SkipNode* next = node->Next(0);
+                node->~SkipNode();
+                node = next;
+            }
+        }
+    }
+
+    static int RandomHeight() {
+        // Per thread xorshift, so that writers don't contend on a shared generator
+        thread_local uint64_t state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        int height = 1;
+        while (height < kMaxHeight) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            if (state % kBranching != 0) {
+                break;
+            }
+            height++;
+        }
+        return height;
+    }
+
+    // Starting from Before, find the nodes at Level so that Before->Key_ < Key <= After->Key_
+    static void FindSpliceForLevel(const K& Key, SkipNode* Before, int Level, SkipNode** OutPrev, SkipNode** OutNext) {
+        while (true) {
+            SkipNode* next = Before->Next(Level);
+            if (next == nullptr || !(next->Key_ < Key)) {
+                *OutPrev = Before;
+                *OutNext = next;
+                return;
+            }
+            Before = next;
+        }
+    }
+
+    // First node with a key >= Key, which is the newest version when the key exists
+    SkipNode* FindGreaterOrEqual(const K& Key) const {
+        SkipNode* node = Head_;
+        for (int level = MaxHeight_.load(std::memory_order_relaxed) - 1; level >= 0; level--) {
+            SkipNode* next = node->Next(level);
+            while (next != nullptr && next->Key_ < Key) {
+                node = next;
+                next = node->Next(level);
+            }
+        }
+        return node->Next(0);
+    }
+
+    static const V* VisibleValue(const SkipNode* Node) {
+        return Node->Deleted_ ? nullptr : &Node->Value_;
+    }
+
+    // Skip over the older versions of Node's key
+    static SkipNode* NextVersion(SkipNode* Node) {
+        SkipNode* next = Node->Next(0);
+        while (next != nullptr && !(Node->Key_ < next->Key_)) {
+            next = next->Next(0);
+        }
+        return next;
+    }
+};
+
+}
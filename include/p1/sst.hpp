@@ -0,0 +1,1251 @@
+#pragma once
+
+#include "aligned_buffer.hpp"
+#include "bloom_filter.hpp"
+#include "buffer_pool.hpp"
+#include "codec.hpp"
+#include "file.hpp"
+#include "io_engine.hpp"
+#include "kv_iterator.hpp"
+#include "memtable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Sorted string tables (SSTs) are the immutable on-disk runs a full Memtable gets flushed into.
+//
+// File layout, everything is in kPageSize pages so that reads never straddle a page:
+//
+//     [data page 0] [data page 1] ... [data page n-1] [index pages] [filter pages] [footer page]
+//
+// A data page holds as many entries as fit, in key order:
+//
+//     [u16 count] [u16 offset of entry 0] ... [u16 offset of entry count-1] [entry 0] ... [entry count-1]
+//
+// where an entry is the encoded key followed by the encoded value (see Codec). The offsets let lookups binary search
+// inside a page. Deleted keys are stored as tombstones: the top bit of their offset is set and the entry is just the
+// key, so that they shadow older versions of the key in other tables until a compaction drops them. Tables written with
+// a RestartInterval_ use a prefix compressed layout for their data pages instead, see DataPageBuilder.
+//
+// The index pages are a static B+tree over the data pages, written level by level from the bottom up with the root
+// last. Index pages use the data page layout with the first key of a child page as key and the child's page number as
+// value, and are filled up completely, so with 8 byte keys a node has 227 children and a lookup in a file of a million
+// pages reads three index pages and one data page instead of twenty pages of binary search.
+//
+// The filter pages hold a BlockedBloomFilter over all keys (padded to a whole page), readers keep it in memory and
+// consult it before touching any data page. The footer records the number of pages, entries and tombstones, where the
+// index and the filter are, and the smallest and largest key.
+
+constexpr uint64_t kSSTMagic = 0x5353547061676531ULL;
+constexpr uint32_t kSSTVersion = 5;
+// Version 4 files are the same without prefix compressed pages, they are still read
+constexpr uint32_t kSSTMinVersion = 4;
+
+// Set in the offset of a tombstone entry, offsets themselves never get this far
+constexpr uint16_t kTombstoneOffsetBit = 0x8000;
+static_assert(kPageSize <= kTombstoneOffsetBit, "Data page offsets must leave the tombstone bit free");
+
+// Set in the entry count of a prefix compressed data page, every entry takes at least two bytes so counts stay below it
+constexpr uint16_t kPrefixCompressedBit = 0x8000;
+
+struct SSTOptions {
+    // Bloom filter bits per key, 0 disables the filter
+    size_t BloomBitsPerKey_ = 10;
+    // Without an index readers binary search over the data pages
+    bool BuildIndex_ = true;
+    // Write with O_DIRECT, so that a freshly flushed table does not push other data out of the page cache (falls back
+    // to buffered writes where the filesystem does not support it)
+    bool DirectIO_ = false;
+    // Prefix compress the keys of the data pages with a restart point every RestartInterval_ keys (see DataPageBuilder),
+    // 0 keeps the flat layout. Pays off for string keys with long common prefixes, 16 is a good start.
+    size_t RestartInterval_ = 0;
+};
+
+// How an SSTReader gets at the pages of its file
+enum class SSTReadMode {
+    // pread into a private buffer, or into the buffer pool when the reader has one
+    kPread,
+    // Map the whole file and read the pages in place, bypassing the buffer pool. Saves the copy out of the page cache
+    // and the memory for a second copy of hot pages, but a page fault on a cold page blocks just like a read would.
+    kMmap,
+    // Like kPread, but with O_DIRECT: the buffer pool is the only cache, so memory use is what the pool is configured
+    // to and nothing more. Falls back to buffered reads where the filesystem does not support it.
+    kDirect,
+};
+
+struct SSTReadOptions {
+    // Keep the index pages in memory for as long as the reader is open, a point lookup then reads a single page
+    bool PinIndex_ = false;
+    SSTReadMode Mode_ = SSTReadMode::kPread;
+    // Reads scan batches and ReadPages through Engine_, several at a time, when set. Scans of a reader with a buffer
+    // pool then only seek through the pool, like iterators do. Not owned, it has to outlive the reader. Not used in
+    // kMmap mode.
+    IOEngine* Engine_ = nullptr;
+};
+
+// Read-only view of a data page in either layout. Entries are addressed by index in both, in a prefix compressed page
+// the view decodes forward from the closest restart point and remembers where it is, so walking the entries in order
+// costs one step each.
+template <typename K, typename V>
+class DataPageView {
+public:
+    DataPageView() = default;
+
+    explicit DataPageView(const char* Data)
+        : Data_(Data), Compressed_((DecodeFixed16(Data) & kPrefixCompressedBit) != 0) {}
+
+    uint16_t Count() const {
+        return DecodeFixed16(Data_) & ~kPrefixCompressedBit;
+    }
+
+    K KeyAt(size_t Index) const {
+        K key;
+        Codec<K>::Decode(KeyBytes(Index), &key);
+        return key;
+    }
+
+    bool IsTombstone(size_t Index) const {
+        if (Compressed_) {
+            MoveTo(Index);
+            return Value_ == nullptr;
+        }
+        return (OffsetAt(Index) & kTombstoneOffsetBit) != 0;
+    }
+
+    // Returns false for a tombstone, which only has a key and leaves Value alone
+    bool ReadEntry(size_t Index, K* Key, V* Value) const {
+        const char* value = Codec<K>::Decode(KeyBytes(Index), Key);
+        if (Compressed_) {
+            value = Value_;
+        }
+        if (IsTombstone(Index)) {
+            return false;
+        }
+        Codec<V>::Decode(value, Value);
+        return true;
+    }
+
+    // Index of the first entry with a key >= Key, Count() if there is none
+    size_t LowerBound(const K& Key) const {
+        if (Compressed_) {
+            return CompressedLowerBound(Key);
+        }
+        size_t lo = 0;
+        size_t hi = Count();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (KeyAt(mid) < Key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+private:
+    static constexpr size_t kNoEntry = SIZE_MAX;
+
+    const char* Data_{};
+    bool Compressed_{};
+    // Decoding position in a prefix compressed page: the entry at Cursor_, its whole encoded key, its value (null for a
+    // tombstone) and the entry after it
+    mutable size_t Cursor_ = kNoEntry;
+    mutable std::string Key_;
+    mutable const char* Value_{};
+    mutable const char* Next_{};
+
+    uint16_t OffsetAt(size_t Index) const {
+        assert(Index < Count());
+        return DecodeFixed16(Data_ + sizeof(uint16_t) * (Index + 1));
+    }
+
+    const char* EntryAt(size_t Index) const {
+        return Data_ + (OffsetAt(Index) & ~kTombstoneOffsetBit);
+    }
+
+    const char* KeyBytes(size_t Index) const {
+        if (Compressed_) {
+            MoveTo(Index);
+            return Key_.data();
+        }
+        return EntryAt(Index);
+    }
+
+    size_t RestartInterval() const {
+        return DecodeFixed16(Data_ + sizeof(uint16_t));
+    }
+
+    size_t RestartCount() const {
+        return (Count() + RestartInterval() - 1) / RestartInterval();
+    }
+
+    const char* RestartAt(size_t Restart) const {
+        return Data_ + DecodeFixed16(Data_ + sizeof(uint16_t) * (Restart + 2));
+    }
+
+    // Restart entries share nothing with the entry before them, their key is right there
+    K RestartKey(size_t Restart) const {
+        uint64_t shared;
+        uint64_t unshared;
+        uint64_t valueSize;
+        const char* ptr = DecodeVarint(RestartAt(Restart), &shared);
+        ptr = DecodeVarint(ptr, &unshared);
+        if ((unshared & 1) == 0) {
+            ptr = DecodeVarint(ptr, &valueSize);
+        }
+        K key;
+        Codec<K>::Decode(ptr, &key);
+        return key;
+    }
+
+    void MoveTo(size_t Index) const {
+        assert(Index < Count());
+        if (Index == Cursor_) {
+            return;
+        }
+        // Restart entries decode like any other, so stepping to the next entry never needs to look at the restarts
+        if (Cursor_ != kNoEntry && Index == Cursor_ + 1) {
+            Cursor_++;
+            DecodeNext();
+            return;
+        }
+        const size_t interval = RestartInterval();
+        if (Cursor_ == kNoEntry || Index < Cursor_ || Index / interval != Cursor_ / interval) {
+            Cursor_ = Index / interval * interval;
+            Next_ = RestartAt(Index / interval);
+            Key_.clear();
+            DecodeNext();
+        }
+        while (Cursor_ < Index) {
+            Cursor_++;
+            DecodeNext();
+        }
+    }
+
+    // Entry: [varint shared] [varint unshared << 1 | tombstone] [varint value size, live entries only]
+    //        [unshared key bytes] [value]
+    void DecodeNext() const {
+        uint64_t shared;
+        uint64_t unshared;
+        uint64_t valueSize = 0;
+        const char* ptr = DecodeVarint(Next_, &shared);
+        ptr = DecodeVarint(ptr, &unshared);
+        const bool tombstone = (unshared & 1) != 0;
+        unshared >>= 1;
+        if (!tombstone) {
+            ptr = DecodeVarint(ptr, &valueSize);
+        }
+        Key_.resize(shared);
+        Key_.append(ptr, unshared);
+        Value_ = tombstone ? nullptr : ptr + unshared;
+        Next_ = ptr + unshared + valueSize;
+    }
+
+    // Binary search over the restart points, then step through the run of the last one that is still smaller
+    size_t CompressedLowerBound(const K& Key) const {
+        size_t lo = 0;
+        size_t hi = RestartCount();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (RestartKey(mid) < Key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == 0) {
+            return 0;
+        }
+        const size_t end = std::min<size_t>(lo * RestartInterval(), Count());
+        size_t index = (lo - 1) * RestartInterval() + 1;
+        for (; index < end && KeyAt(index) < Key; index++) {
+        }
+        return index;
+    }
+};
+
+// Fills up a single data page. With a RestartInterval every key is stored as the number of leading bytes of its encoded
+// form that it shares with the key before it plus the rest, and every RestartInterval-th key (a restart point) is stored
+// whole. The page starts with the restart points, so lookups binary search over them and decode at most
+// RestartInterval - 1 keys after that:
+//
+//     [u16 count | kPrefixCompressedBit] [u16 restart interval] [u16 offset of restart 0] ... [entries]
+//
+// Without one (0) the page gets the flat layout with an offset per entry.
+template <typename K, typename V>
+class DataPageBuilder {
+public:
+    explicit DataPageBuilder(size_t RestartInterval = 0) : RestartInterval_(RestartInterval) {
+        if (RestartInterval > UINT16_MAX) {
+            throw std::invalid_argument("SST restart interval does not fit into a page header");
+        }
+    }
+
+    // Returns false if the entry does not fit into the page anymore
+    bool Add(const K& Key, const V& Value) {
+        return RestartInterval_ > 0 ? AppendCompressed(Key, &Value) : Append(Key, &Value);
+    }
+
+    bool AddTombstone(const K& Key) {
+        return RestartInterval_ > 0 ? AppendCompressed(Key, nullptr) : Append(Key, nullptr);
+    }
+
+    bool IsEmpty() const {
+        return Count_ == 0;
+    }
+
+    // Serialize the page into Dst (kPageSize bytes) and start over
+    void Finish(char* Dst) {
+        char* ptr;
+        size_t header;
+        if (RestartInterval_ > 0) {
+            header = CompressedHeaderSize(Restarts_.size());
+            ptr = EncodeFixed16(Dst, static_cast<uint16_t>(Count_ | kPrefixCompressedBit));
+            ptr = EncodeFixed16(ptr, static_cast<uint16_t>(RestartInterval_));
+            for (uint16_t offset : Restarts_) {
+                ptr = EncodeFixed16(ptr, static_cast<uint16_t>(header + offset));
+            }
+        } else {
+            header = HeaderSize(Offsets_.size());
+            ptr = EncodeFixed16(Dst, static_cast<uint16_t>(Offsets_.size()));
+            for (uint16_t offset : Offsets_) {
+                // The tombstone bit is carried over from the builder's offsets
+                ptr = EncodeFixed16(ptr, static_cast<uint16_t>(header + offset));
+            }
+        }
+        std::memcpy(ptr, Entries_.data(), Entries_.size());
+        std::memset(ptr + Entries_.size(), 0, kPageSize - header - Entries_.size());
+        Count_ = 0;
+        Offsets_.clear();
+        Restarts_.clear();
+        Entries_.clear();
+    }
+
+    // Largest entry that can go into an otherwise empty page
+    static constexpr size_t MaxEntrySize() {
+        return kPageSize - HeaderSize(1);
+    }
+
+private:
+    const size_t RestartInterval_;
+    size_t Count_{};
+    std::vector<uint16_t> Offsets_;
+    std::vector<uint16_t> Restarts_;
+    std::vector<char> Entries_;
+    // Encoded key of the last entry, and room to encode the next one
+    std::string LastKey_;
+    std::string Key_;
+
+    static constexpr size_t HeaderSize(size_t Count) {
+        return sizeof(uint16_t) * (Count + 1);
+    }
+
+    static constexpr size_t CompressedHeaderSize(size_t Restarts) {
+        return sizeof(uint16_t) * (Restarts + 2);
+    }
+
+    // Value is null for a tombstone
+    bool Append(const K& Key, const V* Value) {
+        const size_t entrySize = Codec<K>::Size(Key) + (Value != nullptr ? Codec<V>::Size(*Value) : 0);
+        if (HeaderSize(Offsets_.size() + 1) + Entries_.size() + entrySize > kPageSize) {
+            return false;
+        }
+        const size_t start = Entries_.size();
+        Offsets_.push_back(static_cast<uint16_t>(start | (Value != nullptr ? 0 : kTombstoneOffsetBit)));
+        Entries_.resize(start + entrySize);
+        char* ptr = Codec<K>::Encode(Entries_.data() + start, Key);
+        if (Value != nullptr) {
+            Codec<V>::Encode(ptr, *Value);
+        }
+        Count_++;
+        return true;
+    }
+
+    // Entry layout as in DataPageView::DecodeNext
+    bool AppendCompressed(const K& Key, const V* Value) {
+        Key_.resize(Codec<K>::Size(Key));
+        Codec<K>::Encode(Key_.data(), Key);
+        const bool restart = Count_ % RestartInterval_ == 0;
+        size_t shared = 0;
+        if (!restart) {
+            const size_t limit = std::min(LastKey_.size(), Key_.size());
+            while (shared < limit && LastKey_[shared] == Key_[shared]) {
+                shared++;
+            }
+        }
+        const size_t unshared = Key_.size() - shared;
+        const size_t valueSize = Value != nullptr ? Codec<V>::Size(*Value) : 0;
+        const uint64_t tagged = unshared << 1 | (Value != nullptr ? 0 : 1);
+        const size_t entrySize = VarintLength(shared) + VarintLength(tagged) +
+                                 (Value != nullptr ? VarintLength(valueSize) : 0) + unshared + valueSize;
+        if (CompressedHeaderSize(Restarts_.size() + restart) + Entries_.size() + entrySize > kPageSize) {
+            return false;
+        }
+
+        const size_t start = Entries_.size();
+        if (restart) {
+            Restarts_.push_back(static_cast<uint16_t>(start));
+        }
+        Entries_.resize(start + entrySize);
+        char* ptr = EncodeVarint(Entries_.data() + start, shared);
+        ptr = EncodeVarint(ptr, tagged);
+        if (Value != nullptr) {
+            ptr = EncodeVarint(ptr, valueSize);
+        }
+        std::memcpy(ptr, Key_.data() + shared, unshared);
+        if (Value != nullptr) {
+            Codec<V>::Encode(ptr + unshared, *Value);
+        }
+        LastKey_.swap(Key_);
+        Count_++;
+        return true;
+    }
+};
+
+// Metadata stored in the last page of an SST
+template <typename K>
+struct SSTFooter {
+    // Number of data pages, the index starts right after them
+    uint64_t PageCount_{};
+    // Tombstones included
+    uint64_t EntryCount_{};
+    uint64_t TombstoneCount_{};
+    uint64_t IndexPageCount_{};
+    // Page number of the index root and the number of index levels above the data pages, 0 without an index
+    uint64_t IndexRoot_{};
+    uint32_t IndexLevels_{};
+    // First page and size in bytes of the bloom filter, FilterSize_ is 0 without a filter
+    uint64_t FilterPage_{};
+    uint64_t FilterSize_{};
+    K MinKey_{};
+    K MaxKey_{};
+
+    uint64_t FilterPageCount() const {
+        return (FilterSize_ + kPageSize - 1) / kPageSize;
+    }
+
+    // Number of pages in the whole file
+    uint64_t FilePageCount() const {
+        return PageCount_ + IndexPageCount_ + FilterPageCount() + 1;
+    }
+
+    void EncodeTo(char* Dst) const {
+        std::memset(Dst, 0, kPageSize);
+        char* ptr = EncodeFixed64(Dst, kSSTMagic);
+        ptr = EncodeFixed32(ptr, kSSTVersion);
+        ptr = EncodeFixed64(ptr, PageCount_);
+        ptr = EncodeFixed64(ptr, EntryCount_);
+        ptr = EncodeFixed64(ptr, IndexPageCount_);
+        ptr = EncodeFixed64(ptr, IndexRoot_);
+        ptr = EncodeFixed32(ptr, IndexLevels_);
+        ptr = EncodeFixed64(ptr, FilterPage_);
+        ptr = EncodeFixed64(ptr, FilterSize_);
+        ptr = EncodeFixed64(ptr, TombstoneCount_);
+        ptr = Codec<K>::Encode(ptr, MinKey_);
+        Codec<K>::Encode(ptr, MaxKey_);
+    }
+
+    void DecodeFrom(const char* Src, const std::string& Path) {
+        if (DecodeFixed64(Src) != kSSTMagic) {
+            throw std::runtime_error("Not an SST file: " + Path);
+        }
+        const uint32_t version = DecodeFixed32(Src + 8);
+        if (version < kSSTMinVersion || version > kSSTVersion) {
+            throw std::runtime_error("Unsupported SST version in " + Path);
+        }
+        const char* ptr = Src + 12;
+        PageCount_ = DecodeFixed64(ptr);
+        EntryCount_ = DecodeFixed64(ptr + 8);
+        IndexPageCount_ = DecodeFixed64(ptr + 16);
+        IndexRoot_ = DecodeFixed64(ptr + 24);
+        IndexLevels_ = DecodeFixed32(ptr + 32);
+        FilterPage_ = DecodeFixed64(ptr + 36);
+        FilterSize_ = DecodeFixed64(ptr + 44);
+        TombstoneCount_ = DecodeFixed64(ptr + 52);
+        ptr = Codec<K>::Decode(ptr + 60, &MinKey_);
+        Codec<K>::Decode(ptr, &MaxKey_);
+    }
+
+    static size_t EncodedSize(const K& MinKey, const K& MaxKey) {
+        return 72 + Codec<K>::Size(MinKey) + Codec<K>::Size(MaxKey);
+    }
+};
+
+// Streams sorted entries into a new SST.
+// Keys have to be added in strictly increasing order, the file is only valid once Finish() returned.
+template <typename K, typename V>
+class SSTWriter {
+public:
+    explicit SSTWriter(const std::string& Path, const SSTOptions& Options = {})
+        : File_(Options.DirectIO_ ? File::OpenDirect(Path, O_WRONLY | O_CREAT | O_TRUNC)
+                                  : File(Path, O_WRONLY | O_CREAT | O_TRUNC)),
+          Buffer_(kPageSize * kWriteBufferPages),
+          Page_(Options.RestartInterval_), Filter_(Options.BloomBitsPerKey_), UseFilter_(Options.BloomBitsPerKey_ > 0),
+          BuildIndex_(Options.BuildIndex_) {}
+
+    void Add(const K& Key, const V& Value) {
+        Append(Key, &Value);
+    }
+
+    // Record that Key was deleted, the tombstone takes the place of a value for Key in the key order
+    void AddTombstone(const K& Key) {
+        Append(Key, nullptr);
+        Footer_.TombstoneCount_++;
+    }
+
+    // Write out the last data page, the index, the filter and the footer and make everything durable
+    void Finish() {
+        if (!Page_.IsEmpty()) {
+            FinishPage();
+        }
+        if (BuildIndex_ && Footer_.PageCount_ > 1) {
+            WriteIndex();
+        }
+        Footer_.FilterPage_ = Footer_.PageCount_ + Footer_.IndexPageCount_;
+        if (UseFilter_) {
+            const std::string filter = Filter_.Finish();
+            Footer_.FilterSize_ = filter.size();
+            for (size_t offset = 0; offset < filter.size(); offset += kPageSize) {
+                char* page = NextBufferPage();
+                const size_t size = std::min(kPageSize, filter.size() - offset);
+                std::memcpy(page, filter.data() + offset, size);
+                std::memset(page + size, 0, kPageSize - size);
+            }
+        }
+        if (SSTFooter<K>::EncodedSize(Footer_.MinKey_, Footer_.MaxKey_) > kPageSize) {
+            throw std::invalid_argument("SST min/max keys do not fit into the footer");
+        }
+        Footer_.EncodeTo(NextBufferPage());
+        FlushBuffer();
+        File_.Sync();
+        File_.Close();
+    }
+
+    // Largest key added so far, only meaningful when GetEntryCount() > 0
+    const K& GetLastKey() const {
+        return Footer_.MaxKey_;
+    }
+
+    // Tombstones included
+    uint64_t GetEntryCount() const {
+        return Footer_.EntryCount_;
+    }
+
+    uint64_t GetTombstoneCount() const {
+        return Footer_.TombstoneCount_;
+    }
+
+    uint64_t GetPageCount() const {
+        return Footer_.PageCount_;
+    }
+
+    // Only known once Finish() returned
+    uint32_t GetIndexLevels() const {
+        return Footer_.IndexLevels_;
+    }
+
+    // Size of the finished file including the filter and the footer
+    uint64_t GetFileSize() const {
+        return Footer_.FilePageCount() * kPageSize;
+    }
+
+    // Whether the pages go to the file with O_DIRECT
+    bool IsDirect() const {
+        return File_.IsDirect();
+    }
+
+private:
+    // Pages are batched up so that a flush issues a few large writes instead of one per page
+    static constexpr size_t kWriteBufferPages = 64;
+
+    File File_;
+    // Page aligned for O_DIRECT
+    AlignedBuffer Buffer_;
+    size_t BufferedPages_{};
+    uint64_t FileOffset_{};
+    DataPageBuilder<K, V> Page_;
+    SSTFooter<K> Footer_;
+    BloomFilterBuilder Filter_;
+    const bool UseFilter_;
+    const bool BuildIndex_;
+    // First key of every data page, the bottom level of the index is built from them
+    std::vector<K> PageFirstKeys_;
+
+    // Value is null for a tombstone. Tombstones go into the filter too, a lookup has to find them to stop at this table.
+    void Append(const K& Key, const V* Value) {
+        if (Footer_.EntryCount_ > 0 && !(Footer_.MaxKey_ < Key)) {
+            throw std::invalid_argument("SST keys have to be added in strictly increasing order");
+        }
+        auto add = [&] { return Value != nullptr ? Page_.Add(Key, *Value) : Page_.AddTombstone(Key); };
+        bool newPage = Page_.IsEmpty();
+        if (!add()) {
+            if (Page_.IsEmpty()) {
+                throw std::invalid_argument("Entry does not fit into an SST page");
+            }
+            FinishPage();
+            add();
+            newPage = true;
+        }
+        if (newPage && BuildIndex_) {
+            PageFirstKeys_.push_back(Key);
+        }
+
+        if (Footer_.EntryCount_ == 0) {
+            Footer_.MinKey_ = Key;
+        }
+        Footer_.MaxKey_ = Key;
+        Footer_.EntryCount_++;
+        if (UseFilter_) {
+            Filter_.AddKeyHash(HashKey(Key));
+        }
+    }
+
+    void FinishPage() {
+        Page_.Finish(NextBufferPage());
+        Footer_.PageCount_++;
+    }
+
+    // Build the index bottom-up: every level holds the first key and page number of each page of the level below, until
+    // a level fits into a single page
+    void WriteIndex() {
+        std::vector<std::pair<K, uint64_t>> children;
+        children.reserve(PageFirstKeys_.size());
+        for (uint64_t page = 0; page < PageFirstKeys_.size(); page++) {
+            children.emplace_back(std::move(PageFirstKeys_[page]), page);
+        }
+        PageFirstKeys_.clear();
+
+        uint64_t nextPage = Footer_.PageCount_;
+        DataPageBuilder<K, uint64_t> node;
+        while (children.size() > 1) {
+            std::vector<std::pair<K, uint64_t>> parents;
+            for (auto& [key, child] : children) {
+                bool newNode = node.IsEmpty();
+                if (!node.Add(key, child)) {
+                    if (node.IsEmpty()) {
+                        throw std::invalid_argument("Key does not fit into an SST index page");
+                    }
+                    node.Finish(NextBufferPage());
+                    nextPage++;
+                    node.Add(key, child);
+                    newNode = true;
+                }
+                if (newNode) {
+                    parents.emplace_back(std::move(key), nextPage);
+                }
+            }
+            node.Finish(NextBufferPage());
+            nextPage++;
+            Footer_.IndexLevels_++;
+            children = std::move(parents);
+        }
+        Footer_.IndexRoot_ = children.front().second;
+        Footer_.IndexPageCount_ = nextPage - Footer_.PageCount_;
+    }
+
+    char* NextBufferPage() {
+        if (BufferedPages_ == kWriteBufferPages) {
+            FlushBuffer();
+        }
+        return Buffer_.Data() + kPageSize * BufferedPages_++;
+    }
+
+    void FlushBuffer() {
+        File_.Write(Buffer_.Data(), BufferedPages_ * kPageSize, FileOffset_);
+        FileOffset_ += BufferedPages_ * kPageSize;
+        BufferedPages_ = 0;
+    }
+};
+
+// Answers point lookups and range scans from an SST written by SSTWriter.
+// Get descends the index to the one data page that can hold the key (files without an index are binary searched over
+// their pages instead, one page read per step), Scan seeks the same way and then reads sequentially. Pages are pinned
+// through Pool when one is given, otherwise they are read straight from the file into a private buffer. In kMmap mode
+// they are read in place from a mapping of the file instead, which point lookups advise as random access (no kernel
+// read-ahead) while scans ask for the pages ahead of them. In kDirect mode every read bypasses the page cache, and
+// all of them go through page aligned buffers. Safe to use from several threads at once.
+template <typename K, typename V>
+class SSTReader {
+public:
+    explicit SSTReader(const std::string& Path, BufferPool* Pool = nullptr, const SSTReadOptions& Options = {})
+        : File_(Options.Mode_ == SSTReadMode::kDirect ? File::OpenDirect(Path, O_RDONLY) : File(Path, O_RDONLY)),
+          FileId_(BufferPool::NewFileId()), Pool_(Pool), Engine_(Options.Engine_),
+          ScanBatchPages_(Options.Mode_ == SSTReadMode::kDirect ? kDirectScanReadAheadPages : kScanReadAheadPages),
+          ScanBuffers_(kPageSize * ScanBatchPages_) {
+        const uint64_t size = File_.Size();
+        if (size < kPageSize || size % kPageSize != 0) {
+            throw std::runtime_error("Truncated SST file: " + Path);
+        }
+        alignas(kPageSize) char page[kPageSize];
+        File_.Read(page, kPageSize, size - kPageSize);
+        Footer_.DecodeFrom(page, Path);
+        if (Footer_.FilePageCount() * kPageSize != size) {
+            throw std::runtime_error("SST page count does not match the file size: " + Path);
+        }
+        if (Footer_.FilterSize_ > 0) {
+            AlignedBuffer pages(Footer_.FilterPageCount() * kPageSize);
+            File_.Read(pages.Data(), pages.Size(), Footer_.FilterPage_ * kPageSize);
+            Filter_ = BlockedBloomFilter(std::string_view(pages.Data(), Footer_.FilterSize_));
+        }
+        if (Options.PinIndex_ && Footer_.IndexPageCount_ > 0) {
+            PinnedIndex_ = AlignedBuffer(Footer_.IndexPageCount_ * kPageSize);
+            File_.Read(PinnedIndex_.Data(), PinnedIndex_.Size(), Footer_.PageCount_ * kPageSize);
+        }
+        if (Options.Mode_ == SSTReadMode::kMmap) {
+            Map_ = MappedFile(File_);
+            Map_.Advise(0, (Footer_.PageCount_ + Footer_.IndexPageCount_) * kPageSize, MADV_RANDOM);
+        }
+    }
+
+    // nullopt when the key is not in the table or was deleted
+    std::optional<V> Get(const K& Key) const {
+        V value;
+        if (Lookup(Key, &value) != LookupStatus::kFound) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Point lookup that reports tombstones as kDeleted, so that callers stop before looking at older tables. The value
+    // is copied to *Value only when it is found.
+    LookupStatus Lookup(const K& Key, V* Value) const {
+        if (Footer_.EntryCount_ == 0 || Key < Footer_.MinKey_ || Footer_.MaxKey_ < Key) {
+            return LookupStatus::kNotFound;
+        }
+        if (!Filter_.MayContain(HashKey(Key))) {
+            FilterSkips_.fetch_add(1, std::memory_order_relaxed);
+            return LookupStatus::kNotFound;
+        }
+
+        alignas(kPageSize) char scratch[kPageSize];
+        PageGuard page = FindPage(Key, scratch).second;
+        if (Map_.IsMapped()) {
+            // The binary search below hops across the whole page, one cache miss per step. Request every line up front
+            // so the misses overlap, which is what the copy out of the page cache gets for free from streaming.
+            for (size_t offset = 0; offset < kPageSize; offset += 64) {
+                __builtin_prefetch(page.Data() + offset);
+            }
+        }
+        return LookupInPage(page.Data(), Key, Value);
+    }
+
+    // Lookup for every key of Keys[0..Count) whose status in Statuses is still kNotFound, Keys sorted ascending. Keys
+    // that land on the same data page share one read of it, and the distinct pages are fetched a batch at a time
+    // (through the buffer pool's TryFetchPages, with the engine when there is one) instead of one after the other. A
+    // batch the pool has no frames to spare for is read into a private buffer instead.
+    void MultiLookup(const K* Keys, size_t Count, LookupStatus* Statuses, V* Values) const {
+        if (Footer_.EntryCount_ == 0) {
+            return;
+        }
+        // (data page, key) for every key the table may have, the page numbers ascend with the keys
+        std::vector<std::pair<uint64_t, size_t>> probes;
+        alignas(kPageSize) char scratch[kPageSize];
+        for (size_t i = 0; i < Count; i++) {
+            if (Statuses[i] != LookupStatus::kNotFound || Keys[i] < Footer_.MinKey_ || Footer_.MaxKey_ < Keys[i]) {
+                continue;
+            }
+            if (!Filter_.MayContain(HashKey(Keys[i]))) {
+                FilterSkips_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (Footer_.IndexLevels_ == 0) {
+                // Without an index finding the page takes data page reads already
+                Statuses[i] = Lookup(Keys[i], &Values[i]);
+                continue;
+            }
+            probes.emplace_back(IndexLookup(Keys[i], scratch), i);
+        }
+
+        std::vector<uint64_t> pageNos;
+        for (const auto& probe : probes) {
+            if (pageNos.empty() || pageNos.back() != probe.first) {
+                pageNos.push_back(probe.first);
+            }
+        }
+        // Every page of a batch stays pinned until its keys are done, so a small pool gets smaller batches
+        if (pageNos.empty()) {
+            return;
+        }
+        size_t batchPages = std::min(pageNos.size(), kMultiLookupPages);
+        if (Pool_ != nullptr) {
+            batchPages = std::clamp<size_t>(Pool_->GetCapacity() / 4, 1, batchPages);
+        }
+        const bool pooled = Pool_ != nullptr && !Map_.IsMapped();
+        std::vector<const char*> pages(batchPages);
+        std::vector<PageGuard> guards(pooled ? batchPages : 0);
+        std::vector<uint64_t> offsets(guards.size());
+        // Without a pool, and when the pool has no frames to spare for a batch, its pages are read into this one
+        AlignedBuffer buffer = Pool_ == nullptr && !Map_.IsMapped() ? AlignedBuffer(batchPages * kPageSize)
+                                                                    : AlignedBuffer();
+        auto probe = probes.begin();
+        for (size_t first = 0; first < pageNos.size(); first += batchPages) {
+            const size_t count = std::min(batchPages, pageNos.size() - first);
+            bool fetched = false;
+            if (pooled) {
+                for (size_t i = 0; i < count; i++) {
+                    offsets[i] = pageNos[first + i] * kPageSize;
+                }
+                fetched = Pool_->TryFetchPages(File_, FileId_, offsets.data(), count, guards.data(), Engine_);
+            }
+            if (Map_.IsMapped()) {
+                PageReads_.fetch_add(count, std::memory_order_relaxed);
+                for (size_t i = 0; i < count; i++) {
+                    pages[i] = Map_.Data() + pageNos[first + i] * kPageSize;
+                    // Same as in Lookup, and the misses of all pages of the batch overlap too
+                    for (size_t offset = 0; offset < kPageSize; offset += 64) {
+                        __builtin_prefetch(pages[i] + offset);
+                    }
+                }
+            } else if (fetched) {
+                PageReads_.fetch_add(count, std::memory_order_relaxed);
+                for (size_t i = 0; i < count; i++) {
+                    pages[i] = guards[i].Data();
+                }
+            } else {
+                // Concurrent batches hold half of the pool already, leave the rest to the other readers
+                if (buffer.Data() == nullptr) {
+                    buffer = AlignedBuffer(batchPages * kPageSize);
+                }
+                ReadPages(pageNos.data() + first, count, buffer.Data());
+                for (size_t i = 0; i < count; i++) {
+                    pages[i] = buffer.Data() + i * kPageSize;
+                }
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                for (; probe != probes.end() && probe->first == pageNos[first + i]; ++probe) {
+                    Statuses[probe->second] = LookupInPage(pages[i], Keys[probe->second], &Values[probe->second]);
+                }
+            }
+            for (PageGuard& guard : guards) {
+                guard.Release();
+            }
+        }
+    }
+
+    std::vector<std::pair<K, V>> Scan(const K& Key1, const K& Key2) const {
+        std::vector<std::pair<K, V>> result;
+        Scan(Key1, Key2, [&](const K& Key, const V& Value) {
+            result.emplace_back(Key, Value);
+            return true;
+        });
+        return result;
+    }
+
+    // Stream every entry in [Key1, Key2] to callback in order until it returns false, tombstones are skipped
+    template <typename Callback>
+    void Scan(const K& Key1, const K& Key2, Callback&& callback) const {
+        if (Footer_.EntryCount_ == 0 || Key2 < Key1 || Key2 < Footer_.MinKey_ || Footer_.MaxKey_ < Key1) {
+            return;
+        }
+
+        // Without a pool the following pages are read a whole batch at a time, a mapping is asked for the same batches.
+        // So they are with a pool when there is an engine, which can only speed up reads it gets many of at once.
+        const AlignedBufferPool::Lease buffer = Map_.IsMapped() ? AlignedBufferPool::Lease() : ScanBuffers_.Acquire();
+        auto [pageNo, page] = FindPage(Key1, buffer.Data());
+        uint64_t bufferStart = pageNo;
+        uint64_t bufferedPages = 1;
+        size_t index = DataPageView<K, V>(page.Data()).LowerBound(Key1);
+
+        K key;
+        V value;
+        while (true) {
+            DataPageView<K, V> view(page.Data());
+            for (; index < view.Count(); index++) {
+                const bool live = view.ReadEntry(index, &key, &value);
+                if (Key2 < key) {
+                    return;
+                }
+                if (live && !callback(key, value)) {
+                    return;
+                }
+            }
+
+            index = 0;
+            if (++pageNo == Footer_.PageCount_) {
+                return;
+            }
+            if (Map_.IsMapped()) {
+                if (pageNo == bufferStart + bufferedPages) {
+                    bufferStart = pageNo;
+                    bufferedPages = std::min<uint64_t>(kScanReadAheadPages, Footer_.PageCount_ - pageNo);
+                    ReadAhead(pageNo);
+                }
+                page = ReadPage(pageNo, nullptr);
+                continue;
+            }
+            if (Pool_ != nullptr && Engine_ == nullptr) {
+                page = ReadPage(pageNo, nullptr);
+                continue;
+            }
+            if (pageNo == bufferStart + bufferedPages) {
+                bufferStart = pageNo;
+                bufferedPages = std::min<uint64_t>(ScanBatchPages_, Footer_.PageCount_ - pageNo);
+                ReadBatch(pageNo, bufferedPages, buffer.Data());
+                PageReads_.fetch_add(bufferedPages, std::memory_order_relaxed);
+            }
+            page = PageGuard(buffer.Data() + (pageNo - bufferStart) * kPageSize);
+        }
+    }
+
+    // Tombstones included
+    uint64_t GetEntryCount() const {
+        return Footer_.EntryCount_;
+    }
+
+    uint64_t GetTombstoneCount() const {
+        return Footer_.TombstoneCount_;
+    }
+
+    uint64_t GetPageCount() const {
+        return Footer_.PageCount_;
+    }
+
+    // Number of index pages a lookup reads before it gets to the data page
+    uint32_t GetIndexLevels() const {
+        return Footer_.IndexLevels_;
+    }
+
+    bool IsIndexPinned() const {
+        return PinnedIndex_.Data() != nullptr;
+    }
+
+    bool IsMapped() const {
+        return Map_.IsMapped();
+    }
+
+    // Whether pages are read with O_DIRECT, false in kDirect mode too when the filesystem does not support it
+    bool IsDirect() const {
+        return File_.IsDirect();
+    }
+
+    const K& GetMinKey() const {
+        return Footer_.MinKey_;
+    }
+
+    const K& GetMaxKey() const {
+        return Footer_.MaxKey_;
+    }
+
+    // Number of pages requested so far (whether or not the buffer pool had them), for measuring read amplification.
+    // Pinned index pages don't count.
+    uint64_t GetPageReads() const {
+        return PageReads_.load(std::memory_order_relaxed);
+    }
+
+    // Number of lookups the bloom filter answered without reading a page
+    uint64_t GetFilterSkips() const {
+        return FilterSkips_.load(std::memory_order_relaxed);
+    }
+
+    bool HasFilter() const {
+        return !Filter_.IsEmpty();
+    }
+
+    // Copy the pages PageNos into consecutive kPageSize slots of Buffer (page aligned in kDirect mode), all at once
+    // through the engine if there is one. Bypasses the buffer pool: this is for batches of reads that are known up
+    // front, which would otherwise wait for one page after the other.
+    void ReadPages(const uint64_t* PageNos, size_t Count, char* Buffer) const {
+        PageReads_.fetch_add(Count, std::memory_order_relaxed);
+        if (Map_.IsMapped()) {
+            for (size_t i = 0; i < Count; i++) {
+                std::memcpy(Buffer + i * kPageSize, Map_.Data() + PageNos[i] * kPageSize, kPageSize);
+            }
+            return;
+        }
+        if (Engine_ == nullptr) {
+            for (size_t i = 0; i < Count; i++) {
+                File_.Read(Buffer + i * kPageSize, kPageSize, PageNos[i] * kPageSize);
+            }
+            return;
+        }
+        std::vector<ReadRequest> requests(Count);
+        for (size_t i = 0; i < Count; i++) {
+            requests[i] = {&File_, Buffer + i * kPageSize, kPageSize, PageNos[i] * kPageSize};
+        }
+        Engine_->Read(requests.data(), Count);
+    }
+
+    // Cursor over the entries of the table, used to merge tables. Only the seek goes through the buffer pool, the
+    // pages after it are read straight from the file in batches so that compactions don't evict the working set (or
+    // straight from the mapping in kMmap mode). Tombstones are returned too, with IsDeleted() set and a default
+    // constructed value.
+    class Iterator : public KVIterator<K, V> {
+    public:
+        explicit Iterator(const SSTReader* Reader)
+            : Reader_(Reader),
+              Buffer_(Reader->Map_.IsMapped() ? AlignedBufferPool::Lease() : Reader->ScanBuffers_.Acquire()),
+              Pages_(Buffer_.Data()) {}
+
+        void SeekToFirst() {
+            if (Reader_->Footer_.EntryCount_ == 0) {
+                Valid_ = false;
+                return;
+            }
+            LoadPages(0);
+            PageNo_ = 0;
+            Page_ = CurrentPage();
+            Index_ = 0;
+            Settle();
+        }
+
+        // Position on the first entry with a key >= Key
+        void Seek(const K& Key) {
+            if (Reader_->Footer_.EntryCount_ == 0 || Reader_->Footer_.MaxKey_ < Key) {
+                Valid_ = false;
+                return;
+            }
+            auto [pageNo, page] = Reader_->FindPage(Key, Buffer_.Data());
+            if (Reader_->Map_.IsMapped()) {
+                Pages_ = page.Data();
+            } else if (page.Data() != Buffer_.Data()) {
+                std::memcpy(Buffer_.Data(), page.Data(), kPageSize);
+            }
+            BufferStart_ = pageNo;
+            BufferedPages_ = 1;
+            PageNo_ = pageNo;
+            Page_ = CurrentPage();
+            Index_ = Page_.LowerBound(Key);
+            Settle();
+        }
+
+        bool Valid() const override {
+            return Valid_;
+        }
+
+        const K& Key() const override {
+            return Key_;
+        }
+
+        const V& Value() const override {
+            return Value_;
+        }
+
+        bool IsDeleted() const override {
+            return Deleted_;
+        }
+
+        void Next() override {
+            Index_++;
+            Settle();
+        }
+
+    private:
+        const SSTReader* Reader_;
+        AlignedBufferPool::Lease Buffer_;
+        // First of the pages from BufferStart_ on, either Buffer_ or a place in the mapping
+        const char* Pages_;
+        uint64_t BufferStart_{};
+        uint64_t BufferedPages_{};
+        uint64_t PageNo_{};
+        // View of page PageNo_, kept so that stepping through a prefix compressed page decodes each key once
+        DataPageView<K, V> Page_;
+        size_t Index_{};
+        bool Valid_{};
+        bool Deleted_{};
+        K Key_{};
+        V Value_{};
+
+        DataPageView<K, V> CurrentPage() const {
+            return DataPageView<K, V>(Pages_ + (PageNo_ - BufferStart_) * kPageSize);
+        }
+
+        void LoadPages(uint64_t PageNo) {
+            BufferStart_ = PageNo;
+            BufferedPages_ = std::min<uint64_t>(Reader_->ScanBatchPages_, Reader_->Footer_.PageCount_ - PageNo);
+            if (Reader_->Map_.IsMapped()) {
+                Pages_ = Reader_->Map_.Data() + PageNo * kPageSize;
+                Reader_->ReadAhead(PageNo);
+            } else {
+                Reader_->ReadBatch(PageNo, BufferedPages_, Buffer_.Data());
+            }
+            Reader_->PageReads_.fetch_add(BufferedPages_, std::memory_order_relaxed);
+        }
+
+        // Step over the end of the current page if needed and decode the entry under the cursor
+        void Settle() {
+            while (Index_ >= Page_.Count()) {
+                if (++PageNo_ == Reader_->Footer_.PageCount_) {
+                    Valid_ = false;
+                    return;
+                }
+                Index_ = 0;
+                if (PageNo_ == BufferStart_ + BufferedPages_) {
+                    LoadPages(PageNo_);
+                }
+                Page_ = CurrentPage();
+            }
+            Deleted_ = !Page_.ReadEntry(Index_, &Key_, &Value_);
+            if (Deleted_) {
+                Value_ = V{};
+            }
+            Valid_ = true;
+        }
+    };
+
+    std::unique_ptr<Iterator> NewIterator() const {
+        return std::make_unique<Iterator>(this);
+    }
+
+private:
+    static constexpr size_t kScanReadAheadPages = 16;
+    // Direct reads get no read-ahead from the kernel, so scans make up for it with fewer, larger reads
+    static constexpr size_t kDirectScanReadAheadPages = 256;
+    // Distinct data pages a MultiLookup fetches at a time
+    static constexpr size_t kMultiLookupPages = 64;
+
+    File File_;
+    const uint64_t FileId_;
+    BufferPool* Pool_;
+    IOEngine* Engine_;
+    SSTFooter<K> Footer_;
+    BlockedBloomFilter Filter_;
+    AlignedBuffer PinnedIndex_;
+    // Only in kMmap mode
+    MappedFile Map_;
+    // Pages scans and iterators read at a time without a mapping, and their buffers for it. They are page aligned for
+    // O_DIRECT and reused from one scan to the next.
+    const size_t ScanBatchPages_;
+    mutable AlignedBufferPool ScanBuffers_;
+    mutable std::atomic<uint64_t> PageReads_{};
+    mutable std::atomic<uint64_t> FilterSkips_{};
+
+    // Read Count consecutive pages from PageNo on into Buffer. An engine gets them as up to one request per queue slot,
+    // which the device can work on in parallel, instead of as one large blocking read.
+    void ReadBatch(uint64_t PageNo, uint64_t Count, char* Buffer) const {
+        if (Engine_ == nullptr || Count == 1) {
+            File_.Read(Buffer, Count * kPageSize, PageNo * kPageSize);
+            return;
+        }
+        const uint64_t parts = std::min<uint64_t>(Count, Engine_->GetQueueDepth());
+        std::vector<ReadRequest> requests(parts);
+        for (uint64_t i = 0; i < parts; i++) {
+            const uint64_t first = Count * i / parts;
+            const uint64_t last = Count * (i + 1) / parts;
+            requests[i] = {&File_, Buffer + first * kPageSize, (last - first) * kPageSize, (PageNo + first) * kPageSize};
+        }
+        Engine_->Read(requests.data(), requests.size());
+    }
+
+    // Have the kernel start reading the scan batch at PageNo and the one after it from the mapping, so that the next
+    // batch is on its way while this one is processed. The mapping itself stays advised for random access.
+    void ReadAhead(uint64_t PageNo) const {
+        const uint64_t count = std::min<uint64_t>(2 * kScanReadAheadPages, Footer_.PageCount_ - PageNo);
+        Map_.Advise(PageNo * kPageSize, count * kPageSize, MADV_WILLNEED);
+    }
+
+    // Pin page PageNo, Scratch is only used to hold the page when there is neither a mapping nor a buffer pool
+    PageGuard ReadPage(uint64_t PageNo, char* Scratch) const {
+        PageReads_.fetch_add(1, std::memory_order_relaxed);
+        if (Map_.IsMapped()) {
+            return PageGuard(Map_.Data() + PageNo * kPageSize);
+        }
+        if (Pool_ != nullptr) {
+            return Pool_->FetchPage(File_, FileId_, PageNo * kPageSize);
+        }
+        File_.Read(Scratch, kPageSize, PageNo * kPageSize);
+        return PageGuard(Scratch);
+    }
+
+    // Find the last data page whose first key is <= Key (page 0 if there is none), returns its number and the pinned page
+    std::pair<uint64_t, PageGuard> FindPage(const K& Key, char* Scratch) const {
+        if (Footer_.IndexLevels_ == 0) {
+            return BinarySearchPage(Key, Scratch);
+        }
+        const uint64_t pageNo = IndexLookup(Key, Scratch);
+        return {pageNo, ReadPage(pageNo, Scratch)};
+    }
+
+    // Same page number through the index alone, for tables that have one
+    uint64_t IndexLookup(const K& Key, char* Scratch) const {
+        uint64_t pageNo = Footer_.IndexRoot_;
+        for (uint32_t level = 0; level < Footer_.IndexLevels_; level++) {
+            PageGuard node = ReadIndexPage(pageNo, Scratch);
+            DataPageView<K, uint64_t> view(node.Data());
+            size_t index = view.LowerBound(Key);
+            if (index == view.Count() || Key < view.KeyAt(index)) {
+                index = index > 0 ? index - 1 : 0;
+            }
+            K key;
+            view.ReadEntry(index, &key, &pageNo);
+        }
+        return pageNo;
+    }
+
+    static LookupStatus LookupInPage(const char* Page, const K& Key, V* Value) {
+        DataPageView<K, V> view(Page);
+        const size_t index = view.LowerBound(Key);
+        if (index == view.Count()) {
+            return LookupStatus::kNotFound;
+        }
+
+        K key;
+        const bool live = view.ReadEntry(index, &key, Value);
+        if (Key < key) {
+            return LookupStatus::kNotFound;
+        }
+        return live ? LookupStatus::kFound : LookupStatus::kDeleted;
+    }
+
+    PageGuard ReadIndexPage(uint64_t PageNo, char* Scratch) const {
+        if (PinnedIndex_.Data() != nullptr) {
+            return PageGuard(PinnedIndex_.Data() + (PageNo - Footer_.PageCount_) * kPageSize);
+        }
+        return ReadPage(PageNo, Scratch);
+    }
+
+    std::pair<uint64_t, PageGuard> BinarySearchPage(const K& Key, char* Scratch) const {
+        uint64_t lo = 0;
+        uint64_t hi = Footer_.PageCount_ - 1;
+        uint64_t loaded = Footer_.PageCount_;
+        PageGuard page;
+        while (lo < hi) {
+            const uint64_t mid = lo + (hi - lo + 1) / 2;
+            page = ReadPage(mid, Scratch);
+            loaded = mid;
+            if (Key < DataPageView<K, V>(page.Data()).KeyAt(0)) {
+                hi = mid - 1;
+            } else {
+                lo = mid;
+            }
+        }
+        if (loaded != lo) {
+            page = ReadPage(lo, Scratch);
+        }
+        return {lo, std::move(page)};
+    }
+};
+
+// Write the contents of memtable into a new SST at Path, tombstones included, returns the number of entries written
+template <typename K, typename V, typename Index>
+uint64_t FlushMemtable(const Memtable<K, V, Index>& memtable, const std::string& Path,
+                       const SSTOptions& Options = {}) {
+    SSTWriter<K, V> writer(Path, Options);
+    memtable.ForEach([&writer](const K& Key, const V* Value) {
+        // Only the first of several entries for the same key makes it into the file
+        if (writer.GetEntryCount() == 0 || writer.GetLastKey() < Key) {
+            if (Value != nullptr) {
+                writer.Add(Key, *Value);
+            } else {
+                writer.AddTombstone(Key);
+            }
+        }
+        return true;
+    });
+    writer.Finish();
+    return writer.GetEntryCount();
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace p1 {
+
+// Whether a Put added a new key or overwrote the value of an existing one
+enum class PutResult {
+    kInserted,
+    kUpdated,
+};
+
+// Outcome of a point lookup. kDeleted means a tombstone was found: the key is gone and older data for it (in older
+// memtables or SSTs) must not be consulted.
+enum class LookupStatus {
+    kFound,
+    kDeleted,
+    kNotFound,
+};
+
+}
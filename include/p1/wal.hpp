@@ -0,0 +1,372 @@
+#pragma once
+
+#include "codec.hpp"
+#include "file.hpp"
+#include "hash.hpp"
+#include "memtable.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace p1 {
+
+// When the log reaches the disk
+enum class WALSyncPolicy {
+    // fdatasync before a commit returns, nothing acknowledged is ever lost
+    kEveryWrite,
+    // Commits return once the record is in the page cache, a background thread syncs every SyncIntervalMs_. A crash
+    // loses at most that window.
+    kInterval,
+    // Leave it to the OS. Survives a process crash but not a machine crash.
+    kNone,
+};
+
+struct WALOptions {
+    WALSyncPolicy SyncPolicy_ = WALSyncPolicy::kEveryWrite;
+    // How often kInterval syncs, at least 1. Syncing on every commit is what kEveryWrite is for.
+    uint32_t SyncIntervalMs_ = 10;
+};
+
+// Append-only log of opaque records with group commit.
+//
+// The file is a sequence of records, each framed as
+//
+//     [u32 checksum][u32 length][length bytes of payload]
+//
+// where the checksum covers the payload. A crash can leave a torn record at the end, readers stop at the first record
+// that does not check out.
+//
+// Writing a record is split in two steps. Append copies the record into an in-memory buffer and hands out its sequence
+// number, Commit then waits until that record is written (and synced, depending on the policy). The first committer to
+// find no write in progress becomes the leader: it takes everything buffered so far, issues one write and one
+// fdatasync for all of it and then wakes everyone whose record went along. Records appended while the leader is busy
+// pile up for the next leader, so the more writers there are the more records share each sync.
+//
+// All methods are thread safe.
+class WriteAheadLog {
+public:
+    // Create the log at Path, truncating any old file there
+    explicit WriteAheadLog(const std::string& Path, const WALOptions& Options = {})
+        : File_(CheckOptions(Path, Options), O_WRONLY | O_CREAT | O_TRUNC), Options_(Options) {
+        if (Options_.SyncPolicy_ == WALSyncPolicy::kInterval) {
+            SyncThread_ = std::thread([this] { SyncLoop(); });
+        }
+    }
+
+    ~WriteAheadLog() {
+        try {
+            Close();
+        } catch (...) {
+        }
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Buffer a record and return its sequence number, does no I/O
+    uint64_t Append(std::string_view Payload) {
+        char header[8];
+        EncodeFixed32(header, static_cast<uint32_t>(Hash64(Payload.data(), Payload.size())));
+        EncodeFixed32(header + 4, static_cast<uint32_t>(Payload.size()));
+
+        std::lock_guard<std::mutex> lock(Mutex_);
+        if (Closed_) {
+            throw std::logic_error("Append to a closed log: " + File_.Path());
+        }
+        Pending_.append(header, sizeof(header));
+        Pending_.append(Payload.data(), Payload.size());
+        return ++LastSequence_;
+    }
+
+    // Wait until record Sequence is written (and synced for kEveryWrite), possibly writing it and everything buffered
+    // with it ourselves
+    void Commit(uint64_t Sequence) {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        while (true) {
+            if (Error_) {
+                std::rethrow_exception(Error_);
+            }
+            if (Committed_ >= Sequence) {
+                return;
+            }
+            if (!Writing_) {
+                break;
+            }
+            CommitCv_.wait(lock);
+        }
+
+        // We are the leader
+        Writing_ = true;
+        WriteBuffer_.swap(Pending_);
+        const uint64_t last = LastSequence_;
+        const uint64_t offset = Offset_;
+        Offset_ += WriteBuffer_.size();
+        lock.unlock();
+
+        try {
+            File_.Write(WriteBuffer_.data(), WriteBuffer_.size(), offset);
+            if (Options_.SyncPolicy_ == WALSyncPolicy::kEveryWrite) {
+                File_.Sync();
+            }
+        } catch (...) {
+            lock.lock();
+            Error_ = std::current_exception();
+            Writing_ = false;
+            CommitCv_.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        WriteBuffer_.clear();
+        Committed_ = last;
+        if (Options_.SyncPolicy_ == WALSyncPolicy::kEveryWrite) {
+            Synced_ = last;
+            Syncs_++;
+        }
+        Writes_++;
+        Writing_ = false;
+        CommitCv_.notify_all();
+    }
+
+    void AddRecord(std::string_view Payload) {
+        Commit(Append(Payload));
+    }
+
+    // Write and sync everything appended so far, whatever the policy
+    void Sync() {
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            last = LastSequence_;
+        }
+        Commit(last);
+        SyncUpTo(last);
+    }
+
+    // Commit what is still buffered, sync unless the policy is kNone and close the file
+    void Close() {
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            if (Closed_) {
+                return;
+            }
+            Closed_ = true;
+            last = LastSequence_;
+        }
+        if (SyncThread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(Mutex_);
+                StopSyncing_ = true;
+            }
+            SyncCv_.notify_all();
+            SyncThread_.join();
+        }
+        Commit(last);
+        if (Options_.SyncPolicy_ != WALSyncPolicy::kNone) {
+            SyncUpTo(last);
+        }
+        File_.Close();
+    }
+
+    const std::string& GetPath() const {
+        return File_.Path();
+    }
+
+    uint64_t GetRecords() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return LastSequence_;
+    }
+
+    // Number of group writes, GetRecords() / GetWrites() is the average group size
+    uint64_t GetWrites() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return Writes_;
+    }
+
+    uint64_t GetSyncs() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return Syncs_;
+    }
+
+    // Bytes appended, including what is still buffered
+    uint64_t GetSize() const {
+        std::lock_guard<std::mutex> lock(Mutex_);
+        return Offset_ + Pending_.size();
+    }
+
+private:
+    File File_;
+    const WALOptions Options_;
+
+    mutable std::mutex Mutex_;
+    std::condition_variable CommitCv_;
+    std::condition_variable SyncCv_;
+    // Records appended since the last leader took the buffer
+    std::string Pending_;
+    // What the current leader is writing, kept around to reuse its capacity
+    std::string WriteBuffer_;
+    uint64_t LastSequence_{};
+    uint64_t Committed_{};
+    uint64_t Synced_{};
+    uint64_t Offset_{};
+    bool Writing_{};
+    bool Closed_{};
+    bool StopSyncing_{};
+    std::exception_ptr Error_;
+    uint64_t Writes_{};
+    uint64_t Syncs_{};
+    std::thread SyncThread_;
+
+    // fdatasync runs outside the lock, concurrent leaders keep writing while it is in flight
+    void SyncUpTo(uint64_t Sequence) {
+        {
+            std::lock_guard<std::mutex> lock(Mutex_);
+            if (Synced_ >= Sequence) {
+                return;
+            }
+        }
+        File_.Sync();
+        std::lock_guard<std::mutex> lock(Mutex_);
+        if (Synced_ < Sequence) {
+            Synced_ = Sequence;
+        }
+        Syncs_++;
+    }
+
+    // Validates Options before the file at Path is truncated
+    static const std::string& CheckOptions(const std::string& Path, const WALOptions& Options) {
+        if (Options.SyncPolicy_ == WALSyncPolicy::kInterval && Options.SyncIntervalMs_ == 0) {
+            throw std::invalid_argument("WAL sync interval must be at least 1 ms");
+        }
+        return Path;
+    }
+
+    void SyncLoop() {
+        std::unique_lock<std::mutex> lock(Mutex_);
+        while (!StopSyncing_) {
+            SyncCv_.wait_for(lock, std::chrono::milliseconds(Options_.SyncIntervalMs_));
+            if (Error_ || Synced_ >= Committed_) {
+                continue;
+            }
+            const uint64_t committed = Committed_;
+            lock.unlock();
+            try {
+                SyncUpTo(committed);
+            } catch (...) {
+                lock.lock();
+                Error_ = std::current_exception();
+                CommitCv_.notify_all();
+                continue;
+            }
+            lock.lock();
+        }
+    }
+};
+
+// Call callback(payload) for every intact record of the log at Path in order. Reading stops at the end of the file or
+// at the first torn or corrupt record, whatever follows it is ignored. Returns the number of records read.
+template <typename Callback>
+uint64_t ReadLog(const std::string& Path, Callback&& callback) {
+    File file(Path, O_RDONLY);
+    const uint64_t size = file.Size();
+    std::string data(size, '\0');
+    if (size > 0) {
+        file.Read(data.data(), size, 0);
+    }
+
+    uint64_t records = 0;
+    uint64_t offset = 0;
+    while (size - offset >= 8) {
+        const uint32_t checksum = DecodeFixed32(data.data() + offset);
+        const uint32_t length = DecodeFixed32(data.data() + offset + 4);
+        if (length > size - offset - 8) {
+            break;
+        }
+        const char* payload = data.data() + offset + 8;
+        if (static_cast<uint32_t>(Hash64(payload, length)) != checksum) {
+            break;
+        }
+        callback(std::string_view(payload, length));
+        records++;
+        offset += 8 + length;
+    }
+    return records;
+}
+
+// Memtable entries are logged as [u8 type][key][value], a record holds one or more of them
+enum class LogEntryType : uint8_t {
+    kPut = 1,
+    kDelete = 2,
+};
+
+template <typename K, typename V>
+void EncodeLogPut(std::string* Dst, const K& Key, const V& Value) {
+    const size_t start = Dst->size();
+    Dst->resize(start + 1 + Codec<K>::Size(Key) + Codec<V>::Size(Value));
+    char* ptr = Dst->data() + start;
+    *ptr++ = static_cast<char>(LogEntryType::kPut);
+    ptr = Codec<K>::Encode(ptr, Key);
+    Codec<V>::Encode(ptr, Value);
+}
+
+template <typename K>
+void EncodeLogDelete(std::string* Dst, const K& Key) {
+    const size_t start = Dst->size();
+    Dst->resize(start + 1 + Codec<K>::Size(Key));
+    char* ptr = Dst->data() + start;
+    *ptr++ = static_cast<char>(LogEntryType::kDelete);
+    Codec<K>::Encode(ptr, Key);
+}
+
+// Call callback(key, value) for every entry of a record, value is null for a delete
+template <typename K, typename V, typename Callback>
+void DecodeLogEntries(std::string_view Payload, Callback&& callback) {
+    const char* ptr = Payload.data();
+    const char* end = ptr + Payload.size();
+    K key{};
+    V value{};
+    while (ptr < end) {
+        const auto type = static_cast<LogEntryType>(*ptr++);
+        if (type != LogEntryType::kPut && type != LogEntryType::kDelete) {
+            throw std::runtime_error("Unknown log entry type");
+        }
+        // The checksum only says the record is what the writer wrote, not that its lengths make sense
+        ptr = Codec<K>::Decode(ptr, end, &key);
+        if (ptr != nullptr && type == LogEntryType::kPut) {
+            ptr = Codec<V>::Decode(ptr, end, &value);
+        }
+        if (ptr == nullptr) {
+            throw std::runtime_error("Log entry runs past the end of its record");
+        }
+        callback(key, type == LogEntryType::kPut ? &value : nullptr);
+    }
+}
+
+// Rebuild a memtable from the log at Path, returns the number of entries replayed.
+// Throws if the memtable runs out of room, it should be at least as big as the one that wrote the log.
+template <typename K, typename V, typename Index>
+uint64_t ReplayLog(const std::string& Path, Memtable<K, V, Index>& Memtable) {
+    uint64_t entries = 0;
+    ReadLog(Path, [&](std::string_view Payload) {
+        DecodeLogEntries<K, V>(Payload, [&](const K& Key, const V* Value) {
+            if (!(Value != nullptr ? Memtable.Put(Key, *Value) : Memtable.Delete(Key))) {
+                throw std::runtime_error("Memtable is too small to replay " + Path);
+            }
+            entries++;
+        });
+    });
+    return entries;
+}
+
+}
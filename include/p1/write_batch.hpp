@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace p1 {
+
+// Puts and deletes collected to be applied together by Memtable::Write or Database::Write, either all of them or none.
+// Later operations on a key win over earlier ones in the same batch, just like separate writes would.
+template <typename K, typename V>
+class WriteBatch {
+public:
+    struct Entry {
+        K Key_;
+        // Default constructed for a delete
+        V Value_;
+        bool Deleted_;
+    };
+
+    void Put(const K& Key, const V& Value) {
+        Entries_.push_back({Key, Value, false});
+    }
+
+    void Put(K&& Key, V&& Value) {
+        Entries_.push_back({std::move(Key), std::move(Value), false});
+    }
+
+    void Delete(const K& Key) {
+        Entries_.push_back({Key, V{}, true});
+    }
+
+    void Clear() {
+        Entries_.clear();
+    }
+
+    // Number of operations, a key written twice counts twice
+    size_t GetCount() const {
+        return Entries_.size();
+    }
+
+    bool IsEmpty() const {
+        return Entries_.empty();
+    }
+
+    // Operations in the order they were added, what goes into the write-ahead log
+    const std::vector<Entry>& GetEntries() const {
+        return Entries_;
+    }
+
+    // The last operation on every key, in key order. Applying them in this order instead of as added makes
+    // consecutive inserts walk down mostly the same, already cached path of the tree and writes every key only once.
+    std::vector<const Entry*> GetSortedEntries() const {
+        std::vector<const Entry*> sorted;
+        sorted.reserve(Entries_.size());
+        for (const Entry& entry : Entries_) {
+            sorted.push_back(&entry);
+        }
+        // Stable, so that among equal keys the last one added is still last
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* A, const Entry* B) { return A->Key_ < B->Key_; });
+        auto last = sorted.begin();
+        for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+            if (last != it && ((*last)->Key_ < (*it)->Key_)) {
+                ++last;
+            }
+            *last = *it;
+        }
+        sorted.erase(sorted.empty() ? sorted.end() : last + 1, sorted.end());
+        return sorted;
+    }
+
+private:
+    std::vector<Entry> Entries_;
+};
+
+}
@@ -0,0 +1,65 @@
+#include "catch/catch.hpp"
+#include "p1/arena.hpp"
+#include "p1/avl_tree.hpp"
+
+#include <cstdint>
+#include <string>
+
+TEST_CASE("Arena hands out aligned, non-overlapping memory", "[arena]") {
+    p1::Arena arena(1024);
+
+    auto* a = static_cast<char*>(arena.Allocate(3, 1));
+    auto* b = static_cast<uint64_t*>(arena.Allocate(sizeof(uint64_t), alignof(uint64_t)));
+    REQUIRE(reinterpret_cast<uintptr_t>(b) % alignof(uint64_t) == 0);
+    REQUIRE(reinterpret_cast<char*>(b) >= a + 3);
+
+    // Bigger than a block, has to get its own allocation
+    auto* big = static_cast<char*>(arena.Allocate(4096, 16));
+    REQUIRE(big != nullptr);
+    REQUIRE(arena.GetMemoryUsage() >= 1024 + 4096);
+}
+
+TEST_CASE("Arena reuses its blocks after Reset", "[arena]") {
+    p1::Arena arena(1024);
+    void* first = arena.Allocate(64, 8);
+    for (int i = 0; i < 100; i++) {
+        arena.Allocate(64, 8);
+    }
+    const size_t usage = arena.GetMemoryUsage();
+
+    arena.Reset();
+    REQUIRE(arena.GetMemoryUsage() == usage);
+    REQUIRE(arena.Allocate(64, 8) == first);
+
+    arena.Release();
+    REQUIRE(arena.GetMemoryUsage() == 0);
+}
+
+TEST_CASE("AVL Tree can be cleared and reused with either allocator", "[arena][avl]") {
+    p1::AVLTree<uint64_t, uint64_t> arenaTree;
+    p1::AVLTree<uint64_t, uint64_t, p1::HeapAllocator> heapTree;
+    p1::AVLTree<std::string, std::string> stringTree;
+
+    for (int round = 0; round < 3; round++) {
+        for (uint64_t i = 0; i < 1000; i++) {
+            arenaTree.Put(i, i * 10);
+            heapTree.Put(i, i * 10);
+            stringTree.Put(std::to_string(i), std::string(40, 'x'));
+        }
+        REQUIRE(arenaTree.GetSize() == 1000);
+        REQUIRE(arenaTree.Get(500) == 5000);
+        REQUIRE(heapTree.Get(999) == 9990);
+        REQUIRE(stringTree.Get("123") == std::string(40, 'x'));
+
+        arenaTree.Clear();
+        heapTree.Clear();
+        stringTree.Clear();
+        REQUIRE(arenaTree.IsEmpty());
+        REQUIRE(heapTree.IsEmpty());
+        REQUIRE(stringTree.IsEmpty());
+    }
+
+    // The arena keeps its blocks for the next round of inserts
+    REQUIRE(arenaTree.GetAllocatedMemory() > 0);
+    REQUIRE(heapTree.GetAllocatedMemory() == 0);
+}
@@ -0,0 +1,155 @@
+#include "catch/catch.hpp"
+#include "p1/art.hpp"
+#include "p1/memtable.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Adaptive radix tree matches std::map", "[art]") {
+    using Tree = p1::AdaptiveRadixTree<uint64_t, uint64_t>;
+
+    // Dense keys fill Node256s, random ones mostly Node4s, the shifted ones share long prefixes
+    auto dense = [](uint64_t i) { return i; };
+    auto sparse = [](uint64_t i) { return i << 20; };
+    auto random = [rng = std::mt19937_64(42)](uint64_t) mutable { return rng(); };
+    std::vector<std::function<uint64_t(uint64_t)>> distributions = {dense, sparse, random};
+
+    for (auto& next : distributions) {
+        Tree tree;
+        std::map<uint64_t, uint64_t> expected;
+        for (uint64_t i = 0; i < 20000; i++) {
+            const uint64_t key = next(i);
+            const bool inserted = expected.emplace(key, i).second;
+            REQUIRE(tree.Put(key, i) == (inserted ? p1::PutResult::kInserted : p1::PutResult::kUpdated));
+            expected[key] = i;
+        }
+        REQUIRE(tree.GetSize() == expected.size());
+
+        for (const auto& [key, value] : expected) {
+            REQUIRE(tree.Get(key) == value);
+        }
+        REQUIRE(tree.Find(expected.rbegin()->first + 1) == nullptr);
+        for (uint64_t i = 0; i < 1000; i++) {
+            const uint64_t key = next(i) ^ 1;
+            REQUIRE(tree.TryGet(key).has_value() == (expected.count(key) > 0));
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t>> all(expected.begin(), expected.end());
+        REQUIRE(tree.Scan(0, UINT64_MAX) == all);
+
+        // Range bounds that fall between keys, on keys and past both ends
+        std::mt19937_64 rng(7);
+        for (int i = 0; i < 200; i++) {
+            uint64_t key1 = all[rng() % all.size()].first + (i % 3) - 1;
+            uint64_t key2 = key1 + (rng() % 4096) * (all.back().first / all.size() + 1);
+            if (key2 < key1) {
+                key2 = UINT64_MAX;
+            }
+            std::vector<std::pair<uint64_t, uint64_t>> range(expected.lower_bound(key1), expected.upper_bound(key2));
+            REQUIRE(tree.Scan(key1, key2) == range);
+        }
+        REQUIRE(tree.Scan(5, 4).empty());
+    }
+}
+
+TEST_CASE("Adaptive radix tree signed keys and tombstones", "[art]") {
+    // Heap allocated nodes, so that growing nodes and Clear really free them
+    using Tree = p1::AdaptiveRadixTree<int32_t, std::string, p1::HeapAllocator>;
+
+    Tree tree;
+    for (int32_t key : {5, -1, 0, INT32_MIN, INT32_MAX, -300, 256, 255}) {
+        tree.Put(key, std::to_string(key));
+    }
+    std::vector<int32_t> keys;
+    tree.InOrderTraversal([&keys](const int32_t& Key, const std::string& Value) {
+        keys.push_back(Key);
+        return Value == std::to_string(Key);
+    });
+    REQUIRE(keys == std::vector<int32_t>{INT32_MIN, -300, -1, 0, 5, 255, 256, INT32_MAX});
+
+    const std::string big(1000, 'v');
+    const size_t before = tree.GetTotalDataSize();
+    tree.Put(0, big);
+    REQUIRE(tree.GetTotalDataSize() > before + 1000);
+    REQUIRE(tree.Delete(0));
+    REQUIRE(tree.GetTotalDataSize() == before);
+    REQUIRE_FALSE(tree.Delete(0));
+    REQUIRE_FALSE(tree.Delete(7));
+    REQUIRE(tree.GetTombstoneCount() == 2);
+    REQUIRE(tree.GetSize() == 9);
+
+    std::string value;
+    REQUIRE(tree.Lookup(0, &value) == p1::LookupStatus::kDeleted);
+    REQUIRE(tree.Lookup(1, &value) == p1::LookupStatus::kNotFound);
+    REQUIRE(tree.Lookup(-1, &value) == p1::LookupStatus::kFound);
+    REQUIRE(value == "-1");
+    REQUIRE_THROWS_AS(tree.Get(0), std::runtime_error);
+    REQUIRE(tree.Scan(-1, 10) == std::vector<std::pair<int32_t, std::string>>{{-1, "-1"}, {5, "5"}});
+
+    size_t tombstones = 0;
+    tree.ScanWithTombstones(-1, 10, [&tombstones](const int32_t&, const std::string* Value) {
+        tombstones += Value == nullptr;
+        return true;
+    });
+    REQUIRE(tombstones == 2);
+
+    REQUIRE(tree.Put(0, "back") == p1::PutResult::kInserted);
+    REQUIRE(tree.GetTombstoneCount() == 1);
+    for (int32_t key = 1000; key < 2000; key++) {
+        tree.Put(key, big);
+    }
+    REQUIRE(tree.Scan(1000, 1999).size() == 1000);
+
+    tree.Clear();
+    REQUIRE(tree.IsEmpty());
+    REQUIRE(tree.GetTotalDataSize() == 0);
+    REQUIRE(tree.Scan(INT32_MIN, INT32_MAX).empty());
+}
+
+namespace {
+
+// Arena that counts what it hands out, the arena never gets a grown node back before Clear
+struct CountingArena : p1::Arena {
+    static inline size_t Used_ = 0;
+
+    void* Allocate(size_t Bytes, size_t Alignment) {
+        Used_ += AllocationSize(Bytes, Alignment);
+        return p1::Arena::Allocate(Bytes, Alignment);
+    }
+};
+
+}
+
+TEST_CASE("Adaptive radix tree charges the nodes an arena still holds", "[art]") {
+    CountingArena::Used_ = 0;
+    p1::AdaptiveRadixTree<uint64_t, uint64_t, CountingArena> tree;
+    // Dense keys grow the root from a Node4 all the way to a Node256
+    for (uint64_t key = 0; key < 256; key++) {
+        tree.Put(key, key);
+        REQUIRE(tree.GetTotalDataSize() == CountingArena::Used_);
+    }
+}
+
+TEST_CASE("Adaptive radix tree as memtable index", "[art]") {
+    using Index = p1::AdaptiveRadixTree<uint64_t, uint64_t>;
+    p1::Memtable<uint64_t, uint64_t, Index> memtable(100 * Index::EntrySize(0, 0));
+
+    uint64_t written = 0;
+    while (memtable.Put(written, written * 2)) {
+        written++;
+    }
+    // Dense keys share their inner nodes, so more than the worst case of 100 fit
+    REQUIRE(written > 100);
+    REQUIRE(memtable.GetCurrentSize() <= memtable.GetSizeLimit());
+    REQUIRE(memtable.Get(written - 1) == (written - 1) * 2);
+    REQUIRE(memtable.Delete(3) == false);
+
+    memtable.Clear();
+    REQUIRE(memtable.Delete(3));
+    REQUIRE(memtable.Lookup(3, &written) == p1::LookupStatus::kDeleted);
+}
@@ -1,6 +1,13 @@
 #include "catch/catch.hpp"
 #include "p1/avl_tree.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
 TEST_CASE("AVL Tree", "[avl]") {
     using Tree = p1::AVLTree<uint64_t, uint64_t>;
 
@@ -18,3 +25,302 @@ TEST_CASE("AVL Tree", "[avl]") {
 
 
 
+TEST_CASE("AVL Tree range scan", "[avl]") {
+    using Tree = p1::AVLTree<uint64_t, uint64_t>;
+
+    Tree tree;
+    for (uint64_t i = 0; i < 1000; i += 2) {
+        tree.Put(i, i * 10);
+    }
+
+    SECTION("Bounds that are not in the tree") {
+        auto result = tree.Scan(101, 109);
+        REQUIRE(result.size() == 4);
+        REQUIRE(result.front().first == 102);
+        REQUIRE(result.back().first == 108);
+    }
+
+    SECTION("Empty ranges") {
+        REQUIRE(tree.Scan(2000, 3000).empty());
+        REQUIRE(tree.Scan(5, 5).empty());
+        REQUIRE(tree.Scan(10, 0).empty());
+    }
+
+    SECTION("Streaming scan stops as soon as the callback returns false") {
+        std::vector<uint64_t> seen;
+        tree.Scan(0, 998, [&](const uint64_t& key, const uint64_t&) {
+            seen.push_back(key);
+            return seen.size() < 3;
+        });
+        REQUIRE(seen == std::vector<uint64_t>{0, 2, 4});
+    }
+
+    SECTION("In-order traversal stops on the whole stack") {
+        uint64_t visited = 0;
+        tree.InOrderTraversal([&](const uint64_t&, const uint64_t&) {
+            visited++;
+            return visited < 10;
+        });
+        REQUIRE(visited == 10);
+    }
+}
+
+TEST_CASE("AVL Tree upsert", "[avl]") {
+    using Tree = p1::AVLTree<std::string, std::string>;
+
+    Tree tree;
+    REQUIRE(tree.Put("b", "1") == p1::PutResult::kInserted);
+    REQUIRE(tree.Put("a", "1") == p1::PutResult::kInserted);
+    const size_t size = tree.GetTotalDataSize();
+
+    // Overwrites neither add nodes nor show up twice in scans
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(tree.Put("b", std::to_string(i % 10)) == p1::PutResult::kUpdated);
+    }
+    REQUIRE(tree.GetSize() == 2);
+    REQUIRE(tree.GetTotalDataSize() == size);
+    REQUIRE(tree.Get("b") == "9");
+    REQUIRE(tree.Scan("a", "z") == std::vector<std::pair<std::string, std::string>>{{"a", "1"}, {"b", "9"}});
+
+    SECTION("Moves into new nodes") {
+        std::string key(100, 'k');
+        std::string value(1000, 'v');
+        REQUIRE(tree.Put(std::move(key), std::move(value)) == p1::PutResult::kInserted);
+        REQUIRE(key.empty());
+        REQUIRE(value.empty());
+        REQUIRE(tree.Get(std::string(100, 'k')) == std::string(1000, 'v'));
+        REQUIRE(tree.GetTotalDataSize() == size + Tree::EntrySize(std::string(100, 'k'), std::string(1000, 'v')));
+    }
+
+    SECTION("Moves onto existing values and keeps the key") {
+        std::string key = "b";
+        std::string value(1000, 'v');
+        REQUIRE(tree.Put(std::move(key), std::move(value)) == p1::PutResult::kUpdated);
+        REQUIRE(key == "b");
+        REQUIRE(value.empty());
+        REQUIRE(tree.Get("b") == std::string(1000, 'v'));
+        REQUIRE(tree.GetTotalDataSize() == size + p1::MallocSize(1001));
+    }
+
+    SECTION("Many overwrites keep the tree balanced") {
+        p1::AVLTree<uint64_t, uint64_t> numbers;
+        for (uint64_t round = 0; round < 10; round++) {
+            for (uint64_t i = 0; i < 1000; i++) {
+                numbers.Put(i, round);
+            }
+        }
+        REQUIRE(numbers.GetSize() == 1000);
+        REQUIRE(numbers.GetTotalDataSize() == 1000 * p1::AVLTree<uint64_t, uint64_t>::EntrySize(0, 0));
+        REQUIRE(numbers.Get(500) == 9);
+    }
+}
+
+TEST_CASE("AVL Tree lookups without exceptions", "[avl]") {
+    p1::AVLTree<uint64_t, std::string> tree;
+    for (uint64_t i = 0; i < 1000; i += 2) {
+        tree.Put(i, std::to_string(i));
+    }
+    tree.Delete(10);
+
+    for (uint64_t i = 0; i < 1000; i++) {
+        const bool present = i % 2 == 0 && i != 10;
+        REQUIRE((tree.Find(i) != nullptr) == present);
+        REQUIRE(tree.TryGet(i).has_value() == present);
+        if (present) {
+            REQUIRE(*tree.Find(i) == std::to_string(i));
+            REQUIRE(tree.TryGet(i) == std::to_string(i));
+        } else {
+            REQUIRE_THROWS_AS(tree.Get(i), std::runtime_error);
+        }
+    }
+
+    // Find hands out the stored value itself
+    *tree.Find(4) = "four";
+    REQUIRE(tree.Get(4) == "four");
+}
+
+TEST_CASE("AVL Tree delete leaves tombstones", "[avl]") {
+    using Tree = p1::AVLTree<std::string, std::string>;
+
+    Tree tree;
+    const std::string big(1000, 'v');
+    tree.Put("a", "1");
+    tree.Put("b", big);
+    REQUIRE(tree.Delete("b"));
+    REQUIRE(tree.GetSize() == 2);
+    REQUIRE(tree.GetTombstoneCount() == 1);
+    // The value's heap buffer is released, the node and key stay charged
+    REQUIRE(tree.GetTotalDataSize() == Tree::EntrySize("a", "1") + Tree::TombstoneSize("b"));
+    REQUIRE_THROWS_AS(tree.Get("b"), std::runtime_error);
+
+    std::string value;
+    REQUIRE(tree.Lookup("a", &value) == p1::LookupStatus::kFound);
+    REQUIRE(value == "1");
+    REQUIRE(tree.Lookup("b", &value) == p1::LookupStatus::kDeleted);
+    REQUIRE(tree.Lookup("c", &value) == p1::LookupStatus::kNotFound);
+
+    // Keys that were never written still get a tombstone so that older data for them is shadowed
+    REQUIRE_FALSE(tree.Delete("c"));
+    REQUIRE_FALSE(tree.Delete("b"));
+    REQUIRE(tree.GetTombstoneCount() == 2);
+    REQUIRE(tree.Scan("a", "z") == std::vector<std::pair<std::string, std::string>>{{"a", "1"}});
+
+    std::vector<std::string> all;
+    tree.ForEach([&all](const std::string& Key, const std::string* Value) {
+        all.push_back(Key + (Value == nullptr ? "-" : "=" + *Value));
+        return true;
+    });
+    REQUIRE(all == std::vector<std::string>{"a=1", "b-", "c-"});
+
+    size_t visited = 0;
+    tree.InOrderTraversal([&visited](const std::string&, const std::string&) { return ++visited > 0; });
+    REQUIRE(visited == 1);
+
+    SECTION("Putting a deleted key brings it back") {
+        REQUIRE(tree.Put("b", "2") == p1::PutResult::kInserted);
+        REQUIRE(tree.Get("b") == "2");
+        REQUIRE(tree.GetTombstoneCount() == 1);
+        REQUIRE(tree.GetSize() == 3);
+        REQUIRE(tree.GetTotalDataSize() ==
+                Tree::EntrySize("a", "1") + Tree::EntrySize("b", "2") + Tree::TombstoneSize("c"));
+    }
+
+    SECTION("Deletes keep the tree balanced") {
+        p1::AVLTree<uint64_t, uint64_t> numbers;
+        for (uint64_t i = 0; i < 1000; i++) {
+            numbers.Delete(i);
+        }
+        REQUIRE(numbers.GetSize() == 1000);
+        REQUIRE(numbers.GetTombstoneCount() == 1000);
+        REQUIRE(numbers.Scan(0, 1000).empty());
+    }
+}
+
+TEST_CASE("AVL Tree iterative insert and traversal", "[avl]") {
+    using Tree = p1::AVLTree<uint64_t, uint64_t>;
+
+    // Ascending, descending and interleaved runs each exercise a different rotation on the way back up; a tree that
+    // failed to rebalance would outgrow the fixed descent stack long before this many keys
+    Tree tree;
+    const uint64_t n = 100'000;
+    for (uint64_t i = 0; i < n; i++) {
+        tree.Put(3 * i, i);
+    }
+    for (uint64_t i = n; i > 0; i--) {
+        tree.Put(3 * i - 2, i);
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        tree.Put(3 * ((i * 7919) % n) + 2, i);
+    }
+    REQUIRE(tree.GetSize() == 3 * n);
+    REQUIRE(tree.Put(0, 42) == p1::PutResult::kUpdated);
+    REQUIRE(tree.Get(0) == 42);
+
+    uint64_t expected = 0;
+    bool ordered = true;
+    tree.InOrderTraversal([&](const uint64_t& Key, const uint64_t&) {
+        ordered = ordered && Key == expected++;
+        return true;
+    });
+    REQUIRE(ordered);
+    REQUIRE(expected == 3 * n);
+
+    // The callback is taken by reference, stateful visitors see their own state and can stop the walk
+    uint64_t visited = 0;
+    tree.InOrderTraversal([&visited](const uint64_t&, const uint64_t&) { return ++visited < 10; });
+    REQUIRE(visited == 10);
+}
+
+TEST_CASE("AVL Tree iterators", "[avl]") {
+    using Tree = p1::AVLTree<uint64_t, uint64_t>;
+
+    Tree tree;
+    REQUIRE(tree.begin() == tree.end());
+    REQUIRE(tree.lower_bound(5) == tree.end());
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 1000; i++) {
+        tree.Put((i * 37) % 1000 * 2, i);
+    }
+    for (uint64_t i = 0; i < 2000; i += 2) {
+        keys.push_back(i);
+    }
+    tree.Delete(10);
+
+    std::vector<uint64_t> forward;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        forward.push_back(it.Key());
+        REQUIRE(it.IsDeleted() == (it.Key() == 10));
+    }
+    REQUIRE(forward == keys);
+    REQUIRE(static_cast<size_t>(std::distance(tree.begin(), tree.end())) == tree.GetSize());
+
+    std::vector<uint64_t> backward;
+    for (auto it = tree.end(); it != tree.begin();) {
+        backward.push_back((--it)->Key_);
+    }
+    REQUIRE(std::equal(backward.rbegin(), backward.rend(), keys.begin(), keys.end()));
+
+    REQUIRE(tree.lower_bound(0).Key() == 0);
+    REQUIRE(tree.lower_bound(501).Key() == 502);
+    REQUIRE(tree.lower_bound(502).Key() == 502);
+    REQUIRE(tree.lower_bound(1998).Key() == 1998);
+    REQUIRE(tree.lower_bound(1999) == tree.end());
+    REQUIRE(std::prev(tree.lower_bound(1999)).Key() == 1998);
+
+    auto it = tree.lower_bound(100);
+    auto copy = it++;
+    REQUIRE(copy.Key() == 100);
+    REQUIRE(it.Key() == 102);
+    REQUIRE((--it).Key() == 100);
+    REQUIRE(it == copy);
+    REQUIRE(tree.Get(it.Key()) == it.Value());
+
+    // Overwrites leave iterators where they are
+    tree.Put(100, 7);
+    REQUIRE(it.Value() == 7);
+}
+
+TEST_CASE("AVL Tree bulk load", "[avl]") {
+    using Tree = p1::AVLTree<uint64_t, std::string>;
+
+    std::vector<std::pair<uint64_t, std::string>> entries;
+    for (uint64_t i = 0; i < 1000; i++) {
+        entries.emplace_back(i * 2, std::to_string(i));
+    }
+
+    Tree tree(entries.begin(), entries.end());
+    REQUIRE(tree.GetSize() == 1000);
+    // 1000 nodes fit in a tree of height 10, which is as low as it gets
+    REQUIRE(tree.GetHeight() == 10);
+    REQUIRE(tree.GetTotalDataSize() == [&] {
+        size_t size = 0;
+        for (const auto& [key, value] : entries) {
+            size += Tree::EntrySize(key, value);
+        }
+        return size;
+    }());
+    REQUIRE(tree.Get(0) == "0");
+    REQUIRE(tree.Get(1998) == "999");
+    REQUIRE(tree.Find(1) == nullptr);
+    REQUIRE(tree.Scan(0, 10000) == entries);
+
+    // It is an ordinary tree afterwards
+    REQUIRE(tree.Put(1, "x") == p1::PutResult::kInserted);
+    REQUIRE(tree.Delete(4));
+    REQUIRE(tree.Put(2, "y") == p1::PutResult::kUpdated);
+    REQUIRE(tree.Scan(0, 4) == std::vector<std::pair<uint64_t, std::string>>{{0, "0"}, {1, "x"}, {2, "y"}});
+
+    REQUIRE_THROWS_AS(tree.BulkLoad(entries.begin(), entries.end()), std::logic_error);
+
+    Tree empty(entries.begin(), entries.begin());
+    REQUIRE(empty.IsEmpty());
+    REQUIRE(empty.GetHeight() == 0);
+
+    Tree unordered;
+    std::swap(entries[10], entries[11]);
+    REQUIRE_THROWS_AS(unordered.BulkLoad(entries.begin(), entries.end()), std::invalid_argument);
+    entries[11] = entries[10];
+    REQUIRE_THROWS_AS(unordered.BulkLoad(entries.begin(), entries.end()), std::invalid_argument);
+    REQUIRE(unordered.IsEmpty());
+}
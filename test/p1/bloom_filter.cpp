@@ -0,0 +1,102 @@
+#include "catch/catch.hpp"
+#include "p1/bloom_filter.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// Fraction of NumQueries keys that were never added but still pass the filter
+double FalsePositiveRate(const p1::BlockedBloomFilter& Filter, uint64_t FirstAbsent, uint64_t NumQueries) {
+    uint64_t falsePositives = 0;
+    for (uint64_t i = FirstAbsent; i < FirstAbsent + NumQueries; i++) {
+        falsePositives += Filter.MayContain(p1::HashKey(i));
+    }
+    return static_cast<double>(falsePositives) / NumQueries;
+}
+
+}
+
+TEST_CASE("Blocked bloom filter has no false negatives", "[bloom]") {
+    p1::BloomFilterBuilder builder(10);
+    for (uint64_t i = 0; i < 10000; i++) {
+        builder.AddKeyHash(p1::HashKey(i * 7));
+    }
+    p1::BlockedBloomFilter filter(builder.Finish());
+    for (uint64_t i = 0; i < 10000; i++) {
+        REQUIRE(filter.MayContain(p1::HashKey(i * 7)));
+    }
+}
+
+TEST_CASE("Blocked bloom filter false positive rate", "[bloom]") {
+    constexpr uint64_t kKeys = 100000;
+
+    // Expected rates for a 512 bit blocked filter, with some slack for the randomness of a single run
+    const std::pair<size_t, double> expected[] = {{6, 0.065}, {10, 0.015}, {16, 0.0015}};
+    for (const auto& [bitsPerKey, maxRate] : expected) {
+        p1::BloomFilterBuilder builder(bitsPerKey);
+        for (uint64_t i = 0; i < kKeys; i++) {
+            builder.AddKeyHash(p1::HashKey(i));
+        }
+        p1::BlockedBloomFilter filter(builder.Finish());
+
+        const double rate = FalsePositiveRate(filter, kKeys, 200000);
+        INFO("bits per key: " << bitsPerKey << ", false positive rate: " << rate);
+        REQUIRE(rate < maxRate);
+        REQUIRE(rate > 0);
+    }
+}
+
+TEST_CASE("Blocked bloom filter over string keys", "[bloom]") {
+    p1::BloomFilterBuilder builder(10);
+    for (int i = 0; i < 10000; i++) {
+        builder.AddKeyHash(p1::HashKey("tenant/table/" + std::to_string(i)));
+    }
+    p1::BlockedBloomFilter filter(builder.Finish());
+
+    uint64_t falsePositives = 0;
+    for (int i = 0; i < 10000; i++) {
+        REQUIRE(filter.MayContain(p1::HashKey("tenant/table/" + std::to_string(i))));
+        falsePositives += filter.MayContain(p1::HashKey("tenant/other/" + std::to_string(i)));
+    }
+    REQUIRE(falsePositives < 200);
+
+    REQUIRE_THROWS_AS(p1::BlockedBloomFilter(std::string(10, 'x')), std::runtime_error);
+}
+
+TEST_CASE("SST lookups consult the bloom filter before reading pages", "[bloom][sst]") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / ("bloom_sst." + std::to_string(::getpid()))).string();
+    constexpr uint64_t kKeys = 50000;
+
+    p1::SSTOptions options;
+    options.BloomBitsPerKey_ = 10;
+    p1::SSTWriter<uint64_t, uint64_t> writer(path, options);
+    for (uint64_t i = 0; i < kKeys; i++) {
+        writer.Add(i * 2, i);
+    }
+    writer.Finish();
+
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    REQUIRE(reader.HasFilter());
+    for (uint64_t i = 0; i < kKeys; i++) {
+        REQUIRE(reader.Get(i * 2) == i);
+    }
+    const uint64_t readsForHits = reader.GetPageReads();
+
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < kKeys; i++) {
+        found += reader.Get(i * 2 + 1).has_value();
+    }
+    REQUIRE(found == 0);
+    REQUIRE(reader.GetFilterSkips() > kKeys * 97 / 100);
+    REQUIRE(reader.GetPageReads() - readsForHits < readsForHits / 20);
+
+    // Scans are not affected by the filter
+    REQUIRE(reader.Scan(0, kKeys).size() == kKeys / 2 + 1);
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,125 @@
+#include "catch/catch.hpp"
+#include "p1/bplus_tree.hpp"
+#include "p1/memtable.hpp"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("B+tree matches std::map", "[bplus]") {
+    using Tree = p1::BPlusTree<uint64_t, uint64_t>;
+
+    // Ascending and descending runs split the rightmost and leftmost nodes over and over, random ones the middle
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<uint64_t>> orders(3);
+    for (uint64_t i = 0; i < 50000; i++) {
+        orders[0].push_back(i);
+        orders[1].push_back(50000 - i);
+        // Top bit set on half of them, which the unsigned AVX2 compare has to get right
+        orders[2].push_back(rng() % 100000 | (i % 2 == 0 ? 1ull << 63 : 0));
+    }
+
+    for (const auto& keys : orders) {
+        Tree tree;
+        std::map<uint64_t, uint64_t> expected;
+        for (size_t i = 0; i < keys.size(); i++) {
+            const bool inserted = expected.emplace(keys[i], i).second;
+            expected[keys[i]] = i;
+            REQUIRE(tree.Put(keys[i], i) == (inserted ? p1::PutResult::kInserted : p1::PutResult::kUpdated));
+        }
+        REQUIRE(tree.GetSize() == expected.size());
+        // 50000 keys at 16 to 32 per node
+        REQUIRE(tree.GetHeight() <= 4);
+
+        for (const auto& [key, value] : expected) {
+            REQUIRE(tree.Get(key) == value);
+        }
+        for (uint64_t key : keys) {
+            REQUIRE((tree.Find(key + 1) != nullptr) == (expected.count(key + 1) > 0));
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t>> all(expected.begin(), expected.end());
+        REQUIRE(tree.Scan(0, UINT64_MAX) == all);
+        for (int i = 0; i < 200; i++) {
+            const uint64_t key1 = all[rng() % all.size()].first + (i % 3) - 1;
+            const uint64_t key2 = key1 + rng() % 1000;
+            std::vector<std::pair<uint64_t, uint64_t>> range(expected.lower_bound(key1), expected.upper_bound(key2));
+            REQUIRE(tree.Scan(key1, key2) == range);
+        }
+        REQUIRE(tree.Scan(5, 4).empty());
+    }
+}
+
+TEST_CASE("B+tree string keys and tombstones", "[bplus]") {
+    // Heap allocated nodes, so that Clear and the destructor really free them
+    using Tree = p1::BPlusTree<std::string, std::string, p1::HeapAllocator>;
+
+    Tree tree;
+    std::map<std::string, std::string> expected;
+    for (int i = 0; i < 2000; i++) {
+        const std::string key = "key" + std::to_string(i * 7919 % 2000);
+        tree.Put(key, std::to_string(i));
+        expected[key] = std::to_string(i);
+    }
+    REQUIRE(tree.Scan("", "~") == std::vector<std::pair<std::string, std::string>>(expected.begin(), expected.end()));
+
+    const std::string big(1000, 'v');
+    const size_t before = tree.GetTotalDataSize();
+    tree.Put("key5", big);
+    REQUIRE(tree.GetTotalDataSize() > before + 1000);
+    REQUIRE(tree.Delete("key5"));
+    REQUIRE(tree.GetTotalDataSize() < before + 1000);
+    REQUIRE_FALSE(tree.Delete("key5"));
+    REQUIRE_FALSE(tree.Delete("missing"));
+    REQUIRE(tree.GetTombstoneCount() == 2);
+    REQUIRE(tree.GetSize() == 2001);
+
+    std::string value;
+    REQUIRE(tree.Lookup("key5", &value) == p1::LookupStatus::kDeleted);
+    REQUIRE(tree.Lookup("nope", &value) == p1::LookupStatus::kNotFound);
+    REQUIRE(tree.Lookup("key6", &value) == p1::LookupStatus::kFound);
+    REQUIRE_THROWS_AS(tree.Get("key5"), std::runtime_error);
+
+    size_t live = 0;
+    size_t tombstones = 0;
+    tree.ScanWithTombstones("key5", "key5~", [&](const std::string&, const std::string* Value) {
+        (Value == nullptr ? tombstones : live)++;
+        return true;
+    });
+    // key5 itself and key50..key59, key500..key599
+    REQUIRE(tombstones == 1);
+    REQUIRE(live == 110);
+
+    REQUIRE(tree.Put("key5", "back") == p1::PutResult::kInserted);
+    REQUIRE(tree.GetTombstoneCount() == 1);
+
+    tree.Clear();
+    REQUIRE(tree.IsEmpty());
+    REQUIRE(tree.GetTotalDataSize() == 0);
+    REQUIRE(tree.Scan("", "~").empty());
+    tree.Put("a", "b");
+    REQUIRE(tree.Get("a") == "b");
+}
+
+TEST_CASE("B+tree as memtable index", "[bplus]") {
+    using Index = p1::BPlusTree<uint64_t, uint64_t>;
+    p1::Memtable<uint64_t, uint64_t, Index> memtable(64 << 10);
+    for (uint64_t i = 0; i < 1000; i++) {
+        REQUIRE(memtable.Put(i * 3, i));
+    }
+    REQUIRE(memtable.Get(999 * 3) == 999u);
+    REQUIRE(memtable.Scan(0, 30).size() == 11);
+    REQUIRE(memtable.Delete(3));
+    REQUIRE_FALSE(memtable.Get(3).has_value());
+
+    // Nodes are charged as they are allocated, a full memtable is past its limit by at most the nodes of one split
+    uint64_t written = 1000;
+    while (memtable.Put(written * 3, written)) {
+        written++;
+    }
+    REQUIRE(memtable.GetCurrentSize() <= memtable.GetSizeLimit() + 2048);
+    REQUIRE(memtable.Get((written - 1) * 3) == written - 1);
+}
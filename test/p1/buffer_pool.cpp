@@ -0,0 +1,200 @@
+#include "catch/catch.hpp"
+#include "p1/buffer_pool.hpp"
+#include "p1/extendible_hash.hpp"
+#include "p1/hash.hpp"
+#include "p1/io_engine.hpp"
+#include "p1/sst.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct MixedHash {
+    size_t operator()(uint64_t Key) const {
+        return p1::Mix64(Key);
+    }
+};
+
+}
+
+TEST_CASE("Extendible hash table grows and shrinks", "[buffer_pool]") {
+    p1::ExtendibleHashTable<uint64_t, uint64_t, MixedHash> table(4);
+    constexpr uint64_t kKeys = 5000;
+
+    for (uint64_t i = 0; i < kKeys; i++) {
+        table.Insert(i, i * 3);
+    }
+    REQUIRE(table.Size() == kKeys);
+    REQUIRE(table.GetNumBuckets() >= kKeys / 4);
+    REQUIRE(table.GetGlobalDepth() > 8);
+
+    // Overwrites don't add entries
+    table.Insert(10, 11);
+    REQUIRE(table.Size() == kKeys);
+
+    uint64_t value = 0;
+    REQUIRE(table.Find(10, &value));
+    REQUIRE(value == 11);
+    REQUIRE(table.Find(kKeys - 1, &value));
+    REQUIRE(value == (kKeys - 1) * 3);
+    REQUIRE_FALSE(table.Find(kKeys, &value));
+
+    // Halfway down the directory is exactly as deep as the deepest bucket
+    for (uint64_t i = 0; i < kKeys; i += 2) {
+        REQUIRE(table.Remove(i));
+    }
+    REQUIRE(table.Size() == kKeys / 2);
+    int deepest = 0;
+    for (size_t i = 0; i < (size_t(1) << table.GetGlobalDepth()); i++) {
+        deepest = std::max(deepest, table.GetLocalDepth(i));
+    }
+    REQUIRE(deepest == table.GetGlobalDepth());
+
+    for (uint64_t i = 1; i < kKeys; i += 2) {
+        REQUIRE(table.Remove(i));
+    }
+    REQUIRE_FALSE(table.Remove(0));
+    REQUIRE(table.Size() == 0);
+    REQUIRE(table.GetNumBuckets() == 1);
+    REQUIRE(table.GetGlobalDepth() == 0);
+}
+
+TEST_CASE("Buffer pool hits, misses and clock eviction", "[buffer_pool]") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / ("buffer_pool." + std::to_string(::getpid()))).string();
+    {
+        p1::File file(path, O_RDWR | O_CREAT | O_TRUNC);
+        char page[p1::kPageSize];
+        for (int i = 0; i < 8; i++) {
+            std::memset(page, 'a' + i, sizeof(page));
+            file.Write(page, sizeof(page), i * p1::kPageSize);
+        }
+    }
+
+    p1::File file(path, O_RDONLY);
+    const uint64_t fileId = p1::BufferPool::NewFileId();
+    REQUIRE_THROWS_AS(p1::BufferPool(0), std::invalid_argument);
+    p1::BufferPool pool(4);
+
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(pool.FetchPage(file, fileId, i * p1::kPageSize).Data()[0] == 'a' + i);
+    }
+    REQUIRE(pool.GetMisses() == 4);
+    REQUIRE(pool.FetchPage(file, fileId, 0).Data()[100] == 'a');
+    REQUIRE(pool.GetHits() == 1);
+    REQUIRE(pool.GetEvictions() == 0);
+
+    // The pool is full, reading a fifth page evicts one of the others
+    REQUIRE(pool.FetchPage(file, fileId, 4 * p1::kPageSize).Data()[0] == 'e');
+    REQUIRE(pool.GetEvictions() == 1);
+
+    SECTION("Pinned pages are never evicted") {
+        std::vector<p1::PageGuard> pinned;
+        for (int i = 4; i < 8; i++) {
+            pinned.push_back(pool.FetchPage(file, fileId, i * p1::kPageSize));
+        }
+        REQUIRE_THROWS_AS(pool.FetchPage(file, fileId, 0), std::runtime_error);
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(pinned[i].Data()[0] == 'e' + i);
+        }
+
+        pinned.pop_back();
+        REQUIRE(pool.FetchPage(file, fileId, 0).Data()[0] == 'a');
+    }
+
+    SECTION("Batched fetches read all misses at once") {
+        auto engine = p1::NewIOEngine(2);
+        // Page 7 twice, the second one waits for the read of the first
+        const uint64_t offsets[] = {7 * p1::kPageSize, 4 * p1::kPageSize, 7 * p1::kPageSize};
+        std::vector<p1::PageGuard> guards(3);
+        pool.ResetCounters();
+        pool.FetchPages(file, fileId, offsets, 3, guards.data(), engine.get());
+        REQUIRE(guards[0].Data()[0] == 'h');
+        REQUIRE(guards[1].Data()[0] == 'e');
+        REQUIRE(guards[2].Data() == guards[0].Data());
+        REQUIRE(pool.GetMisses() == 1);
+        REQUIRE(pool.GetHits() == 2);
+
+        // More pages than the pool can pin at once throws without leaving anything pinned
+        const uint64_t tooMany[] = {0, p1::kPageSize, 2 * p1::kPageSize, 3 * p1::kPageSize};
+        std::vector<p1::PageGuard> more(4);
+        REQUIRE_THROWS_AS(pool.FetchPages(file, fileId, tooMany, 4, more.data(), nullptr), std::runtime_error);
+        guards.clear();
+        pool.FetchPages(file, fileId, tooMany, 4, more.data(), nullptr);
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(more[i].Data()[0] == 'a' + i);
+        }
+    }
+
+    SECTION("Reads past the end of the file leave the pool usable") {
+        REQUIRE_THROWS(pool.FetchPage(file, fileId, 100 * p1::kPageSize));
+        REQUIRE(pool.FetchPage(file, fileId, 7 * p1::kPageSize).Data()[0] == 'h');
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST reads through a buffer pool", "[buffer_pool][sst]") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / ("buffer_pool_sst." + std::to_string(::getpid()))).string();
+    p1::SSTWriter<uint64_t, uint64_t> writer(path);
+    for (uint64_t i = 0; i < 20000; i++) {
+        writer.Add(i, i + 1);
+    }
+    writer.Finish();
+
+    p1::BufferPool pool(16);
+    p1::SSTReader<uint64_t, uint64_t> reader(path, &pool);
+    for (uint64_t i = 0; i < 20000; i += 13) {
+        REQUIRE(reader.Get(i) == i + 1);
+    }
+    REQUIRE(reader.Scan(1000, 15000).size() == 14001);
+    REQUIRE(pool.GetHits() > 0);
+    REQUIRE(pool.GetEvictions() > 0);
+
+    // The index root is shared by every lookup and stays resident
+    REQUIRE(reader.Get(5000) == 5001);
+    pool.ResetCounters();
+    REQUIRE(reader.Get(777) == 778);
+    REQUIRE(pool.GetHits() > 0);
+
+    // Other readers hold most of the frames, batched lookups read their pages themselves instead of failing
+    const std::string pinnedPath = path + ".pinned";
+    {
+        p1::File file(pinnedPath, O_RDWR | O_CREAT | O_TRUNC);
+        char page[p1::kPageSize] = {};
+        for (int i = 0; i < 14; i++) {
+            file.Write(page, sizeof(page), i * p1::kPageSize);
+        }
+    }
+    p1::File pinnedFile(pinnedPath, O_RDONLY);
+    const uint64_t pinnedId = p1::BufferPool::NewFileId();
+    std::vector<p1::PageGuard> pinned;
+    for (int i = 0; i < 14; i++) {
+        pinned.push_back(pool.FetchPage(pinnedFile, pinnedId, i * p1::kPageSize));
+    }
+    const uint64_t offsets[] = {0, p1::kPageSize};
+    std::vector<p1::PageGuard> guards(2);
+    REQUIRE_FALSE(pool.TryFetchPages(pinnedFile, pinnedId, offsets, 2, guards.data(), nullptr));
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 20000; i += 500) {
+        keys.push_back(i);
+    }
+    std::vector<p1::LookupStatus> statuses(keys.size(), p1::LookupStatus::kNotFound);
+    std::vector<uint64_t> values(keys.size());
+    reader.MultiLookup(keys.data(), keys.size(), statuses.data(), values.data());
+    for (size_t i = 0; i < keys.size(); i++) {
+        REQUIRE(statuses[i] == p1::LookupStatus::kFound);
+        REQUIRE(values[i] == keys[i] + 1);
+    }
+
+    pinned.clear();
+    std::filesystem::remove(pinnedPath);
+    std::filesystem::remove(path);
+}
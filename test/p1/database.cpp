@@ -0,0 +1,602 @@
+#include "catch/catch.hpp"
+#include "p1/database.hpp"
+#include "p1/kv_iterator.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::string TempDir(const std::string& Name) {
+    const auto path = std::filesystem::temp_directory_path() / (Name + "." + std::to_string(::getpid()));
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+// Small memtables and levels so that a few thousand keys go through several flushes and compactions
+p1::DatabaseOptions SmallOptions() {
+    p1::DatabaseOptions options;
+    options.MemtableSize_ = 16 << 10;
+    options.L0CompactionTrigger_ = 2;
+    options.L0StopWritesTrigger_ = 6;
+    options.BaseLevelSize_ = 64 << 10;
+    options.LevelSizeRatio_ = 4;
+    options.TargetFileSize_ = 32 << 10;
+    options.BufferPoolPages_ = 64;
+    options.WAL_.SyncPolicy_ = p1::WALSyncPolicy::kNone;
+    return options;
+}
+
+}
+
+TEST_CASE("Merging iterator keeps the newest version", "[database]") {
+    using Iterator = p1::VectorIterator<int, int>;
+    std::vector<std::unique_ptr<p1::KVIterator<int, int>>> children;
+    children.push_back(std::make_unique<Iterator>(std::vector<std::pair<int, int>>{{1, 10}, {3, 30}}));
+    children.push_back(std::make_unique<Iterator>(std::vector<std::pair<int, int>>{{1, 11}, {2, 21}, {3, 31}}));
+    children.push_back(std::make_unique<Iterator>(std::vector<std::pair<int, int>>{}));
+    children.push_back(std::make_unique<Iterator>(std::vector<std::pair<int, int>>{{0, 2}, {3, 32}, {4, 42}}));
+
+    std::vector<std::pair<int, int>> merged;
+    for (p1::MergingIterator<int, int> it(std::move(children)); it.Valid(); it.Next()) {
+        merged.emplace_back(it.Key(), it.Value());
+    }
+    REQUIRE(merged == std::vector<std::pair<int, int>>{{0, 2}, {1, 10}, {2, 21}, {3, 30}, {4, 42}});
+}
+
+TEST_CASE("Database put, get and scan across levels", "[database]") {
+    const std::string path = TempDir("db_basic");
+    std::map<uint64_t, uint64_t> expected;
+    {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, SmallOptions());
+
+        // Three rounds over the same keys so that newer versions have to shadow older ones in deeper levels
+        for (uint64_t round = 0; round < 3; round++) {
+            for (uint64_t i = 0; i < 5000; i++) {
+                const uint64_t key = (i * 7919) % 5000;
+                if (round == 0 || key % (round + 1) == 0) {
+                    db.Put(key, key * 10 + round);
+                    expected[key] = key * 10 + round;
+                }
+            }
+        }
+        db.Flush();
+        db.WaitForCompactions();
+
+        const auto stats = db.GetStats();
+        REQUIRE(stats.Flushes_ > 0);
+        REQUIRE(stats.Compactions_ > 0);
+        REQUIRE(stats.FilesPerLevel_.size() == 7);
+        REQUIRE(stats.FilesPerLevel_[0] < 2);
+
+        for (const auto& [key, value] : expected) {
+            REQUIRE(db.Get(key) == value);
+        }
+        REQUIRE_FALSE(db.Get(5000).has_value());
+
+        std::vector<uint64_t> keys = {5000, 17, 4999, 17, 0};
+        for (uint64_t key = 4000; key >= 9; key -= 9) {
+            keys.push_back(key);
+        }
+        const auto multi = db.MultiGet(keys);
+        REQUIRE(multi.size() == keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            REQUIRE(multi[i] == db.Get(keys[i]));
+        }
+        REQUIRE(multi[1] == expected[17]);
+
+        auto result = db.Scan(100, 199);
+        REQUIRE(result.size() == 100);
+        for (const auto& [key, value] : result) {
+            REQUIRE(expected[key] == value);
+        }
+        REQUIRE(db.Scan(0, 10000).size() == expected.size());
+
+        size_t count = 0;
+        db.Scan(0, 10000, [&count](uint64_t, uint64_t) { return ++count < 10; });
+        REQUIRE(count == 10);
+    }
+
+    SECTION("Reopen sees everything that was written") {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, SmallOptions());
+        for (const auto& [key, value] : expected) {
+            REQUIRE(db.Get(key) == value);
+        }
+        db.Put(1, 1);
+        REQUIRE(db.Get(1) == 1u);
+    }
+
+    SECTION("Reopen with memory mapped tables") {
+        auto options = SmallOptions();
+        options.ReadMode_ = p1::SSTReadMode::kMmap;
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, options);
+        for (const auto& [key, value] : expected) {
+            REQUIRE(db.Get(key) == value);
+        }
+        REQUIRE(db.Scan(0, 10000).size() == expected.size());
+    }
+
+    SECTION("Reopen with direct I/O through the I/O engine") {
+        auto options = SmallOptions();
+        options.ReadMode_ = p1::SSTReadMode::kDirect;
+        options.IOQueueDepth_ = 8;
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, options);
+        // New tables are written with O_DIRECT too
+        for (uint64_t key = 0; key < 5000; key += 3) {
+            db.Put(key, key);
+            expected[key] = key;
+        }
+        db.Flush();
+        db.WaitForCompactions();
+        for (const auto& [key, value] : expected) {
+            REQUIRE(db.Get(key) == value);
+        }
+        REQUIRE(db.Scan(0, 10000).size() == expected.size());
+
+        std::vector<uint64_t> keys;
+        for (uint64_t key = 0; key < 5100; key++) {
+            keys.push_back(key);
+        }
+        const auto multi = db.MultiGet(keys);
+        for (uint64_t key = 0; key < 5100; key++) {
+            REQUIRE(multi[key] == (expected.count(key) ? std::optional<uint64_t>(expected[key]) : std::nullopt));
+        }
+    }
+
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database memtable is visible before flush", "[database]") {
+    const std::string path = TempDir("db_memtable");
+    p1::Database<std::string, std::string> db;
+    db.Open(path, SmallOptions());
+
+    db.Put("b", "1");
+    db.Put("a", "2");
+    db.Put("b", "3");
+    REQUIRE(db.Get("b") == std::string("3"));
+    REQUIRE(db.Scan("a", "z") == std::vector<std::pair<std::string, std::string>>{{"a", "2"}, {"b", "3"}});
+
+    db.Flush();
+    REQUIRE(db.GetStats().FilesPerLevel_[0] == 1);
+    REQUIRE(db.Get("b") == std::string("3"));
+    REQUIRE_FALSE(db.Get("c").has_value());
+
+    db.Close();
+    REQUIRE_THROWS_AS(db.Get("b"), std::logic_error);
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database scan streams the active memtable", "[database]") {
+    const std::string path = TempDir("db_scan_memtable");
+    p1::DatabaseOptions options = SmallOptions();
+    options.MemtableSize_ = 1 << 20;
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, options);
+
+    // Several chunks worth of entries, with tombstones on both sides of chunk boundaries
+    for (uint64_t key = 0; key < 2000; key++) {
+        db.Put(key, key);
+    }
+    for (uint64_t key = 250; key < 2000; key += 3) {
+        db.Delete(key);
+    }
+
+    std::vector<uint64_t> keys;
+    db.Scan(100, 1899, [&](uint64_t Key, uint64_t Value) {
+        REQUIRE(Key == Value);
+        // Writers don't wait for the scan to finish
+        db.Put(10000 + Key, Key);
+        keys.push_back(Key);
+        return true;
+    });
+    std::vector<uint64_t> expected;
+    for (uint64_t key = 100; key < 1900; key++) {
+        if (key < 250 || (key - 250) % 3 != 0) {
+            expected.push_back(key);
+        }
+    }
+    REQUIRE(keys == expected);
+    REQUIRE(db.Get(10000 + 1899) == 1899u);
+
+    size_t count = 0;
+    db.Scan(0, 1999, [&count](uint64_t, uint64_t) { return ++count < 700; });
+    REQUIRE(count == 700);
+
+    db.Close();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database with prefix compressed tables", "[database]") {
+    const std::string path = TempDir("db_prefix");
+    auto options = SmallOptions();
+    options.RestartInterval_ = 16;
+    auto key = [](uint64_t I) {
+        return "tenant" + std::to_string(I % 7) + "/orders/row" + std::to_string(1000000 + I);
+    };
+    std::map<std::string, std::string> expected;
+    {
+        p1::Database<std::string, std::string> db;
+        db.Open(path, options);
+        for (uint64_t i = 0; i < 3000; i++) {
+            db.Put(key(i), std::to_string(i));
+            expected[key(i)] = std::to_string(i);
+        }
+        for (uint64_t i = 0; i < 3000; i += 5) {
+            db.Delete(key(i));
+            expected.erase(key(i));
+        }
+        db.Flush();
+        db.WaitForCompactions();
+        REQUIRE(db.GetStats().Compactions_ > 0);
+    }
+
+    // Tables in both layouts side by side once the flat ones join
+    options.RestartInterval_ = 0;
+    p1::Database<std::string, std::string> db;
+    db.Open(path, options);
+    for (uint64_t i = 1; i < 3000; i += 5) {
+        db.Put(key(i), "new");
+        expected[key(i)] = "new";
+    }
+    db.Flush();
+    std::vector<std::string> keys;
+    for (uint64_t i = 0; i < 3000; i++) {
+        keys.push_back(key(i));
+        REQUIRE(db.Get(key(i)) == (expected.count(key(i)) ? std::optional<std::string>(expected[key(i)]) : std::nullopt));
+    }
+    const auto multi = db.MultiGet(keys);
+    for (size_t i = 0; i < keys.size(); i++) {
+        REQUIRE(multi[i] == db.Get(keys[i]));
+    }
+    const auto scan = db.Scan("tenant", "tenant~");
+    REQUIRE(scan == std::vector<std::pair<std::string, std::string>>(expected.begin(), expected.end()));
+    db.Close();
+
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database queues several immutable memtables", "[database]") {
+    const std::string path = TempDir("db_immutables");
+    p1::DatabaseOptions options = SmallOptions();
+    options.MaxImmutableMemtables_ = 3;
+    // Keep L0 from stalling writers, only the immutable cap should hold them back
+    options.L0StopWritesTrigger_ = 1000;
+    p1::Database<uint64_t, uint64_t> db;
+
+    options.MaxImmutableMemtables_ = 0;
+    REQUIRE_THROWS_AS(db.Open(path, options), std::invalid_argument);
+    options.MaxImmutableMemtables_ = 3;
+    db.Open(path, options);
+
+    // Every key is overwritten in a later memtable, reads have to find the newest of the queued versions
+    const uint64_t numKeys = 2000;
+    for (uint64_t round = 0; round < 3; round++) {
+        for (uint64_t i = 0; i < numKeys; i++) {
+            db.Put(i, round * numKeys + i);
+            REQUIRE(db.GetStats().ImmutableMemtables_ <= 3);
+        }
+        for (uint64_t i = 0; i < numKeys; i += 97) {
+            REQUIRE(db.Get(i) == round * numKeys + i);
+        }
+        const auto scan = db.Scan(100, 199);
+        REQUIRE(scan.size() == 100);
+        REQUIRE(scan.front() == std::make_pair<uint64_t, uint64_t>(100, round * numKeys + 100));
+    }
+
+    db.Flush();
+    const auto stats = db.GetStats();
+    REQUIRE(stats.ImmutableMemtables_ == 0);
+    REQUIRE(stats.Flushes_ > 3);
+    db.Close();
+
+    // Queued memtables that made it to disk are not replayed again, the rest comes back from their logs
+    db.Open(path, options);
+    for (uint64_t i = 0; i < numKeys; i += 97) {
+        REQUIRE(db.Get(i) == 2 * numKeys + i);
+    }
+    db.Close();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database write batches", "[database]") {
+    const std::string path = TempDir("db_batch");
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, SmallOptions());
+
+    // Enough batches to go through several memtable switches, a batch never straddles two memtables
+    for (uint64_t round = 0; round < 50; round++) {
+        p1::WriteBatch<uint64_t, uint64_t> batch;
+        for (uint64_t i = 0; i < 100; i++) {
+            batch.Put(round * 100 + i, round);
+        }
+        batch.Delete(round * 100);
+        db.Write(batch);
+        REQUIRE(db.Get(round * 100 + 99) == round);
+        REQUIRE_FALSE(db.Get(round * 100).has_value());
+    }
+
+    p1::WriteBatch<uint64_t, uint64_t> huge;
+    for (uint64_t i = 0; i < 10000; i++) {
+        huge.Put(i, i);
+    }
+    REQUIRE_THROWS_AS(db.Write(huge), std::invalid_argument);
+    REQUIRE(db.Get(1) == 0u);
+    db.Close();
+
+    // Batches come back from the log as a whole
+    db.Open(path, SmallOptions());
+    REQUIRE(db.Get(4999) == 49u);
+    REQUIRE_FALSE(db.Get(4900).has_value());
+    REQUIRE(db.Scan(0, 10000).size() == 50 * 99);
+    db.Close();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database deletes shadow older versions", "[database]") {
+    const std::string path = TempDir("db_delete");
+    std::map<uint64_t, uint64_t> expected;
+    {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, SmallOptions());
+        for (uint64_t i = 0; i < 5000; i++) {
+            db.Put(i, i);
+            expected[i] = i;
+        }
+        db.Flush();
+        db.WaitForCompactions();
+
+        // Delete every third key once its value is in the deeper levels, and a few that never existed
+        for (uint64_t i = 0; i < 5100; i += 3) {
+            db.Delete(i);
+            expected.erase(i);
+        }
+        REQUIRE_FALSE(db.Get(3).has_value());
+        REQUIRE(db.Get(4) == 4u);
+        REQUIRE(db.Scan(0, 10) == std::vector<std::pair<uint64_t, uint64_t>>{{1, 1}, {2, 2}, {4, 4}, {5, 5}, {7, 7},
+                                                                              {8, 8}, {10, 10}});
+
+        db.Flush();
+        REQUIRE_FALSE(db.Get(3).has_value());
+        db.WaitForCompactions();
+        for (uint64_t i = 0; i < 5100; i++) {
+            REQUIRE(db.Get(i) == (expected.count(i) ? std::optional<uint64_t>(i) : std::nullopt));
+        }
+        std::vector<uint64_t> keys(5100);
+        std::iota(keys.rbegin(), keys.rend(), uint64_t{0});
+        const auto multi = db.MultiGet(keys);
+        for (uint64_t i = 0; i < 5100; i++) {
+            REQUIRE(multi[i] == db.Get(keys[i]));
+        }
+        REQUIRE(db.Scan(0, 10000).size() == expected.size());
+
+        // Deleted keys can be written again
+        db.Put(3, 33);
+        REQUIRE(db.Get(3) == 33u);
+        expected[3] = 33;
+        db.Delete(4);
+        expected.erase(4);
+    }
+
+    SECTION("Deletes survive a reopen") {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, SmallOptions());
+        REQUIRE(db.Get(3) == 33u);
+        REQUIRE_FALSE(db.Get(4).has_value());
+        REQUIRE_FALSE(db.Get(6).has_value());
+        REQUIRE(db.Scan(0, 10000).size() == expected.size());
+    }
+
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database recovers unflushed writes from the log", "[database]") {
+    const std::string path = TempDir("db_recover");
+    const std::string crashed = TempDir("db_recover_crashed");
+    auto options = SmallOptions();
+    options.WAL_.SyncPolicy_ = p1::WALSyncPolicy::kEveryWrite;
+    {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, options);
+        // Enough for a few flushes, the tail stays in the memtable and its log
+        for (uint64_t i = 0; i < 3000; i++) {
+            db.Put(i, i + 1);
+        }
+        db.WaitForCompactions();
+        REQUIRE(std::filesystem::file_size(std::filesystem::path(path) / "MANIFEST") > 0);
+
+        // Copying the directory of an open database is as good as a crash
+        std::filesystem::copy(path, crashed);
+        db.Close();
+    }
+
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(crashed, options);
+    for (uint64_t i = 0; i < 3000; i++) {
+        REQUIRE(db.Get(i) == i + 1);
+    }
+    size_t logs = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(crashed)) {
+        logs += entry.path().extension() == ".log";
+    }
+    REQUIRE(logs == 1);
+
+    // Recovering twice doesn't resurrect anything older
+    db.Put(0, 42);
+    db.Close();
+    db.Open(crashed, options);
+    REQUIRE(db.Get(0) == 42u);
+    db.Close();
+
+    std::filesystem::remove_all(path);
+    std::filesystem::remove_all(crashed);
+}
+
+TEST_CASE("Database writes are visible only once they are in the log", "[database]") {
+    const std::string path = TempDir("db_visible");
+    const std::string crashed = TempDir("db_visible_crashed");
+    auto options = SmallOptions();
+    // Overwrites of a few keys, the memtable never fills up and the log is all there is on disk
+    options.MemtableSize_ = 1 << 20;
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, options);
+
+    constexpr uint64_t kThreads = 4;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < kThreads; t++) {
+        threads.emplace_back([&db, &stop, t] {
+            for (uint64_t i = 1; !stop; i++) {
+                db.Put(t, i);
+            }
+        });
+    }
+    for (int round = 0; round < 5; round++) {
+        std::vector<uint64_t> seen;
+        for (uint64_t t = 0; t < kThreads; t++) {
+            seen.push_back(db.Get(t).value_or(0));
+        }
+        // Whatever a reader saw survives a crash right after
+        std::filesystem::remove_all(crashed);
+        std::filesystem::copy(path, crashed);
+        p1::Database<uint64_t, uint64_t> copy;
+        copy.Open(crashed, options);
+        for (uint64_t t = 0; t < kThreads; t++) {
+            REQUIRE(copy.Get(t).value_or(0) >= seen[t]);
+        }
+        copy.Close();
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    db.Close();
+    std::filesystem::remove_all(path);
+    std::filesystem::remove_all(crashed);
+}
+
+TEST_CASE("Database flushes between concurrent writes keep every write", "[database]") {
+    const std::string path = TempDir("db_flush_writes");
+    constexpr uint64_t kThreads = 4;
+    constexpr uint64_t kPerThread = 2000;
+    {
+        p1::Database<uint64_t, uint64_t> db;
+        db.Open(path, SmallOptions());
+        std::atomic<uint64_t> running{kThreads};
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < kThreads; t++) {
+            threads.emplace_back([&db, &running, t] {
+                for (uint64_t i = 0; i < kPerThread; i++) {
+                    db.Put(i * kThreads + t, t);
+                }
+                running--;
+            });
+        }
+        // Memtable switches race with groups of writes being committed to the old log
+        while (running > 0) {
+            db.Flush();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        db.Close();
+    }
+
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, SmallOptions());
+    for (uint64_t key = 0; key < kThreads * kPerThread; key++) {
+        REQUIRE(db.Get(key) == key % kThreads);
+    }
+    db.Close();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database concurrent writers and readers", "[database]") {
+    const std::string path = TempDir("db_concurrent");
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, SmallOptions());
+
+    constexpr uint64_t kThreads = 4;
+    constexpr uint64_t kPerThread = 3000;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < kThreads; t++) {
+        threads.emplace_back([&db, t] {
+            for (uint64_t i = 0; i < kPerThread; i++) {
+                db.Put(i * kThreads + t, t);
+                if (i % 100 == 0) {
+                    db.Get(i);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    db.WaitForCompactions();
+
+    for (uint64_t key = 0; key < kThreads * kPerThread; key++) {
+        REQUIRE(db.Get(key) == key % kThreads);
+    }
+    db.Close();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Database concurrent MultiGets on a small buffer pool", "[database]") {
+    const std::string path = TempDir("db_small_pool");
+    auto options = SmallOptions();
+    options.BufferPoolPages_ = 8;
+    p1::Database<uint64_t, uint64_t> db;
+    db.Open(path, options);
+
+    constexpr uint64_t kKeys = 5000;
+    for (uint64_t key = 0; key < kKeys; key++) {
+        db.Put(key, key * 3);
+    }
+    db.Flush();
+    db.WaitForCompactions();
+
+    // Every batch spans many pages, together they would pin every frame of the pool
+    constexpr uint64_t kThreads = 8;
+    std::atomic<uint64_t> errors{0};
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < kThreads; t++) {
+        threads.emplace_back([&db, &errors, t] {
+            try {
+                for (uint64_t round = 0; round < 50; round++) {
+                    std::vector<uint64_t> keys;
+                    for (uint64_t key = (t + round) % 13; key < kKeys; key += 13) {
+                        keys.push_back(key);
+                    }
+                    const auto values = db.MultiGet(keys);
+                    for (size_t i = 0; i < keys.size(); i++) {
+                        errors += values[i] != keys[i] * 3;
+                    }
+                    errors += db.Get(round * 97) != round * 97 * 3;
+                }
+            } catch (...) {
+                errors++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(errors == 0);
+
+    db.Close();
+    std::filesystem::remove_all(path);
+}
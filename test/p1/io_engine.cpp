@@ -0,0 +1,93 @@
+#include "catch/catch.hpp"
+#include "p1/aligned_buffer.hpp"
+#include "p1/file.hpp"
+#include "p1/io_engine.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+std::string TempPath(const std::string& Name) {
+    return (std::filesystem::temp_directory_path() / (Name + "." + std::to_string(::getpid()))).string();
+}
+
+// Every page is filled with its own page number
+void WritePages(const std::string& Path, uint64_t Pages) {
+    p1::File file(Path, O_WRONLY | O_CREAT | O_TRUNC);
+    std::vector<uint64_t> page(p1::kPageSize / sizeof(uint64_t));
+    for (uint64_t i = 0; i < Pages; i++) {
+        std::fill(page.begin(), page.end(), i);
+        file.Write(page.data(), p1::kPageSize, i * p1::kPageSize);
+    }
+}
+
+}
+
+TEST_CASE("I/O engines read batches deeper than their queue", "[io_engine]") {
+    const std::string path = TempPath("io_engine");
+    constexpr uint64_t kPages = 256;
+    WritePages(path, kPages);
+
+    std::vector<std::unique_ptr<p1::IOEngine>> engines;
+    engines.push_back(std::make_unique<p1::ThreadPoolIOEngine>(3));
+    engines.push_back(p1::NewIOEngine(4));
+#if defined(P1_HAVE_IO_URING)
+    try {
+        engines.push_back(std::make_unique<p1::UringIOEngine>(8));
+    } catch (const std::system_error&) {
+        // Kernel without io_uring, NewIOEngine handed out a thread pool above
+    }
+#endif
+
+    for (const p1::File& file : {p1::File(path, O_RDONLY), p1::File::OpenDirect(path, O_RDONLY)}) {
+        for (auto& engine : engines) {
+            std::mt19937_64 rng(7);
+            constexpr size_t kRequests = 100;
+            p1::AlignedBuffer buffer(kRequests * 2 * p1::kPageSize);
+            std::vector<p1::ReadRequest> requests(kRequests);
+            std::vector<uint64_t> pageNos(kRequests);
+            for (size_t i = 0; i < kRequests; i++) {
+                // One and two page reads mixed
+                const uint64_t pages = 1 + i % 2;
+                pageNos[i] = rng() % (kPages - 1);
+                requests[i] = {&file, buffer.Data() + i * 2 * p1::kPageSize, pages * p1::kPageSize,
+                               pageNos[i] * p1::kPageSize};
+            }
+            engine->Read(requests.data(), requests.size());
+
+            for (size_t i = 0; i < kRequests; i++) {
+                uint64_t first;
+                uint64_t last;
+                std::memcpy(&first, requests[i].Buffer_, sizeof(first));
+                std::memcpy(&last, requests[i].Buffer_ + requests[i].Size_ - sizeof(last), sizeof(last));
+                REQUIRE(first == pageNos[i]);
+                REQUIRE(last == pageNos[i] + i % 2);
+            }
+            engine->Read(nullptr, 0);
+        }
+    }
+
+    SECTION("A read past the end of the file fails") {
+        p1::File file(path, O_RDONLY);
+        p1::AlignedBuffer buffer(2 * p1::kPageSize);
+        for (auto& engine : engines) {
+            p1::ReadRequest requests[] = {{&file, buffer.Data(), p1::kPageSize, 0},
+                                          {&file, buffer.Data() + p1::kPageSize, p1::kPageSize, kPages * p1::kPageSize}};
+            REQUIRE_THROWS_AS(engine->Read(requests, 2), std::system_error);
+            // And the engine is still good afterwards
+            engine->Read(requests, 1);
+        }
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,234 @@
+#include "catch/catch.hpp"
+#include "p1/memtable.hpp"
+#include "p1/skiplist.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEMPLATE_TEST_CASE("Memtable with different indexes", "[memtable]", (p1::AVLTree<uint64_t, uint64_t>),
+                   (p1::ConcurrentSkipList<uint64_t, uint64_t>)) {
+    const size_t kEntrySize = TestType::EntrySize(0, 0);
+    p1::Memtable<uint64_t, uint64_t, TestType> memtable(10 * kEntrySize);
+
+    for (uint64_t i = 0; i < 10; i++) {
+        REQUIRE(memtable.Put(i, i + 100));
+    }
+    REQUIRE(memtable.NeedsFlush());
+    REQUIRE_FALSE(memtable.Put(10, 110));
+    REQUIRE(memtable.GetEntryCount() == 10);
+    REQUIRE(memtable.GetCurrentSize() == 10 * kEntrySize);
+
+    REQUIRE(memtable.Get(3) == 103);
+    auto result = memtable.Scan(2, 5);
+    REQUIRE(result.size() == 4);
+    REQUIRE(result.front().first == 2);
+    REQUIRE(result.back().second == 105);
+
+    memtable.Clear();
+    REQUIRE(memtable.GetCurrentSize() == 0);
+    REQUIRE(memtable.Put(10, 110));
+}
+
+TEMPLATE_TEST_CASE("Memtable deletes", "[memtable]", (p1::AVLTree<uint64_t, uint64_t>),
+                   (p1::ConcurrentSkipList<uint64_t, uint64_t>)) {
+    const size_t kEntrySize = TestType::EntrySize(0, 0);
+    p1::Memtable<uint64_t, uint64_t, TestType> memtable(10 * kEntrySize);
+    for (uint64_t i = 0; i < 5; i++) {
+        REQUIRE(memtable.Put(i, i + 100));
+    }
+
+    REQUIRE(memtable.Delete(2));
+    REQUIRE(memtable.Delete(7));
+    REQUIRE(memtable.GetTombstoneCount() == 2);
+    REQUIRE(TestType::TombstoneSize(0) <= kEntrySize);
+
+    REQUIRE(memtable.Get(1) == 101u);
+    REQUIRE(*memtable.Find(1) == 101u);
+    REQUIRE(memtable.Find(2) == nullptr);
+    REQUIRE(memtable.Find(8) == nullptr);
+    REQUIRE_FALSE(memtable.Get(2).has_value());
+    REQUIRE_FALSE(memtable.Get(7).has_value());
+    REQUIRE_FALSE(memtable.Get(8).has_value());
+    uint64_t value = 0;
+    REQUIRE(memtable.Lookup(2, &value) == p1::LookupStatus::kDeleted);
+    REQUIRE(memtable.Lookup(8, &value) == p1::LookupStatus::kNotFound);
+
+    auto result = memtable.Scan(0, 10);
+    REQUIRE(result.size() == 4);
+    REQUIRE(result[2].first == 3);
+
+    size_t tombstones = 0;
+    memtable.ScanWithTombstones(0, 10, [&tombstones](const uint64_t&, const uint64_t* Value) {
+        tombstones += Value == nullptr;
+        return true;
+    });
+    REQUIRE(tombstones == 2);
+
+    REQUIRE(memtable.Put(2, 1));
+    REQUIRE(memtable.Get(2) == 1u);
+}
+
+TEMPLATE_TEST_CASE("Memtable write batches", "[memtable]", (p1::AVLTree<uint64_t, uint64_t>),
+                   (p1::ConcurrentSkipList<uint64_t, uint64_t>)) {
+    const size_t kEntrySize = TestType::EntrySize(0, 0);
+    p1::Memtable<uint64_t, uint64_t, TestType> memtable(10 * kEntrySize);
+    REQUIRE(memtable.Put(1, 1));
+
+    p1::WriteBatch<uint64_t, uint64_t> batch;
+    for (uint64_t i = 9; i >= 2; i--) {
+        batch.Put(i, i);
+    }
+    // Only the last operation on a key counts, and only that one is charged
+    batch.Put(5, 50);
+    batch.Delete(9);
+    batch.Put(1, 10);
+    REQUIRE(batch.GetCount() == 11);
+    REQUIRE(memtable.HasRoomFor(batch) == false);
+    REQUIRE(memtable.Write(batch));
+    REQUIRE(memtable.Scan(0, 100).size() == 8);
+    REQUIRE(memtable.Get(1) == 10u);
+    REQUIRE(memtable.Get(5) == 50u);
+    REQUIRE_FALSE(memtable.Get(9).has_value());
+    REQUIRE(memtable.GetTombstoneCount() == 1);
+
+    // All or nothing: a batch that doesn't fit leaves the memtable untouched
+    p1::WriteBatch<uint64_t, uint64_t> tooBig;
+    for (uint64_t i = 100; i < 110; i++) {
+        tooBig.Put(i, i);
+    }
+    const size_t size = memtable.GetCurrentSize();
+    REQUIRE_FALSE(memtable.HasRoomFor(tooBig));
+    REQUIRE_FALSE(memtable.Write(tooBig));
+    REQUIRE(memtable.GetCurrentSize() == size);
+    REQUIRE_FALSE(memtable.Get(100).has_value());
+
+    REQUIRE(memtable.Write(p1::WriteBatch<uint64_t, uint64_t>()));
+    REQUIRE(memtable.GetCurrentSize() == size);
+}
+
+TEMPLATE_TEST_CASE("Memtable multi get", "[memtable]", (p1::AVLTree<uint64_t, uint64_t>),
+                   (p1::ConcurrentSkipList<uint64_t, uint64_t>)) {
+    p1::Memtable<uint64_t, uint64_t, TestType> memtable(1 << 20);
+    for (uint64_t i = 0; i < 1000; i += 2) {
+        memtable.Put(i, i + 1);
+    }
+    memtable.Delete(10);
+
+    // Unsorted, with misses, a tombstone and a key asked for twice
+    const std::vector<uint64_t> keys = {500, 3, 10, 998, 0, 500, 2000, 42};
+    const auto result = memtable.MultiGet(keys);
+    REQUIRE(result.size() == keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        REQUIRE(result[i] == memtable.Get(keys[i]));
+    }
+    REQUIRE(result[0] == 501u);
+    REQUIRE(result[5] == 501u);
+    REQUIRE_FALSE(result[2].has_value());
+    REQUIRE(memtable.MultiGet({}).empty());
+
+    // Keys that already have an answer are left alone, tombstones come back as kDeleted
+    const uint64_t sorted[] = {2, 4, 10, 11};
+    p1::LookupStatus statuses[] = {p1::LookupStatus::kNotFound, p1::LookupStatus::kDeleted,
+                                   p1::LookupStatus::kNotFound, p1::LookupStatus::kNotFound};
+    uint64_t values[4] = {};
+    memtable.MultiLookup(sorted, 4, statuses, values);
+    REQUIRE(statuses[0] == p1::LookupStatus::kFound);
+    REQUIRE(values[0] == 3);
+    REQUIRE(statuses[1] == p1::LookupStatus::kDeleted);
+    REQUIRE(values[1] == 0);
+    REQUIRE(statuses[2] == p1::LookupStatus::kDeleted);
+    REQUIRE(statuses[3] == p1::LookupStatus::kNotFound);
+}
+
+TEST_CASE("Memtable bulk load", "[memtable]") {
+    using Tree = p1::AVLTree<uint64_t, uint64_t>;
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+    for (uint64_t i = 0; i < 100; i++) {
+        entries.emplace_back(i, i + 100);
+    }
+
+    p1::Memtable<uint64_t, uint64_t> tooSmall(99 * Tree::EntrySize(0, 0));
+    REQUIRE_FALSE(tooSmall.BulkLoad(entries.begin(), entries.end()));
+    REQUIRE(tooSmall.GetEntryCount() == 0);
+
+    p1::Memtable<uint64_t, uint64_t> memtable(100 * Tree::EntrySize(0, 0));
+    REQUIRE(memtable.BulkLoad(entries.begin(), entries.end()));
+    REQUIRE(memtable.GetCurrentSize() == 100 * Tree::EntrySize(0, 0));
+    REQUIRE(memtable.NeedsFlush());
+    REQUIRE(memtable.Get(42) == 142u);
+    REQUIRE(memtable.Scan(0, 1000) == entries);
+}
+
+TEMPLATE_TEST_CASE("Memtable streaming scan", "[memtable]", (p1::AVLTree<uint64_t, uint64_t>),
+                   (p1::ConcurrentSkipList<uint64_t, uint64_t>)) {
+    p1::Memtable<uint64_t, uint64_t, TestType> memtable(1 << 20);
+    for (uint64_t i = 0; i < 100; i++) {
+        memtable.Put(i, i);
+    }
+    // The skiplist keeps the older versions of both keys around, its iterators have to skip them
+    memtable.Put(15, 115);
+    memtable.Delete(50);
+
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    memtable.Scan(10, 19, [&](const uint64_t&, const uint64_t& value) {
+        sum += value;
+        count++;
+        return true;
+    });
+    REQUIRE(count == 10);
+    REQUIRE(sum == 245);
+
+    // The same range through the iterators, which also work in range-for and the standard algorithms
+    sum = 0;
+    for (auto it = memtable.lower_bound(10); it != memtable.end() && it.Key() <= 19; ++it) {
+        sum += it.Value();
+    }
+    REQUIRE(sum == 245);
+    REQUIRE(memtable.lower_bound(50).IsDeleted());
+    REQUIRE(memtable.lower_bound(100) == memtable.end());
+    count = 0;
+    for (const auto& entry : memtable) {
+        count += entry.Key_ == count;
+    }
+    REQUIRE(count == 100);
+}
+
+TEST_CASE("Memtable charges the real size of string entries", "[memtable]") {
+    using Tree = p1::AVLTree<std::string, std::string>;
+    p1::Memtable<std::string, std::string> memtable(1 << 20);
+
+    // Short strings fit into the string objects, long ones are charged for their heap buffers too
+    REQUIRE(memtable.Put("a", "b"));
+    REQUIRE(memtable.GetCurrentSize() == Tree::EntrySize("a", "b"));
+    const std::string big(1000, 'v');
+    REQUIRE(memtable.Put(std::string(100, 'k'), big));
+    REQUIRE(memtable.GetCurrentSize() == Tree::EntrySize("a", "b") + Tree::EntrySize(std::string(100, 'k'), big));
+    REQUIRE(memtable.GetCurrentSize() > 1100);
+
+    SECTION("Overwrites only charge the difference") {
+        const size_t before = memtable.GetCurrentSize();
+        REQUIRE(memtable.Put(std::string(100, 'k'), big));
+        REQUIRE(memtable.GetCurrentSize() == before);
+        REQUIRE(memtable.GetEntryCount() == 2);
+
+        REQUIRE(memtable.Put("a", std::string(500, 'w')));
+        REQUIRE(memtable.GetCurrentSize() == before + p1::MallocSize(501));
+        REQUIRE(memtable.Get("a") == std::string(500, 'w'));
+        REQUIRE(memtable.Scan("a", "a").size() == 1);
+    }
+
+    SECTION("The limit bounds the payload") {
+        p1::Memtable<std::string, std::string> small(64 << 10);
+        size_t entries = 0;
+        while (small.Put("key" + std::to_string(entries), big)) {
+            entries++;
+        }
+        REQUIRE(small.GetCurrentSize() <= small.GetSizeLimit());
+        // 1000 byte values, so at most 64 of them fit where fixed size accounting would have taken over a thousand
+        REQUIRE(entries < 64);
+        REQUIRE(entries > 50);
+    }
+}
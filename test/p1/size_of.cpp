@@ -0,0 +1,28 @@
+#include "catch/catch.hpp"
+#include "p1/size_of.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST_CASE("Heap size of keys and values", "[size_of]") {
+    REQUIRE(p1::HeapSize<uint64_t>::Of(42) == 0);
+
+    // Small string optimization, nothing on the heap
+    REQUIRE(p1::HeapSize<std::string>::Of("short") == 0);
+
+    std::string value(100, 'x');
+    REQUIRE(p1::HeapSize<std::string>::Of(value) == p1::MallocSize(value.capacity() + 1));
+    REQUIRE(p1::HeapSize<std::string>::Of(value) >= 101);
+    value.reserve(1000);
+    REQUIRE(p1::HeapSize<std::string>::Of(value) >= 1001);
+
+    std::vector<std::string> strings{std::string(100, 'a'), "b"};
+    REQUIRE(p1::HeapSize<std::vector<std::string>>::Of(strings) ==
+            p1::MallocSize(strings.capacity() * sizeof(std::string)) + p1::HeapSize<std::string>::Of(strings[0]));
+
+    REQUIRE(p1::MallocSize(0) == 0);
+    REQUIRE(p1::MallocSize(1) == 32);
+    REQUIRE(p1::MallocSize(24) == 32);
+    REQUIRE(p1::MallocSize(25) == 48);
+}
@@ -0,0 +1,74 @@
+#include "catch/catch.hpp"
+#include "p1/skiplist.hpp"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Skiplist basic operations", "[skiplist]") {
+    p1::ConcurrentSkipList<uint64_t, uint64_t> list;
+    REQUIRE(list.IsEmpty());
+
+    for (uint64_t i = 100; i > 0; i--) {
+        list.Put(i, i * 10);
+    }
+    REQUIRE(list.GetSize() == 100);
+    REQUIRE(list.Get(1) == 10);
+    REQUIRE(list.Get(100) == 1000);
+    REQUIRE_THROWS_AS(list.Get(101), std::runtime_error);
+
+    auto result = list.Scan(10, 14);
+    REQUIRE(result.size() == 5);
+    for (size_t i = 0; i < result.size(); i++) {
+        REQUIRE(result[i].first == 10 + i);
+    }
+
+    list.Clear();
+    REQUIRE(list.IsEmpty());
+    REQUIRE_THROWS_AS(list.Get(1), std::runtime_error);
+}
+
+TEST_CASE("Skiplist returns the newest version of a key", "[skiplist]") {
+    p1::ConcurrentSkipList<std::string, std::string> list;
+    list.Put("a", "1");
+    list.Put("b", "1");
+    list.Put("a", "2");
+    list.Put("a", "3");
+
+    REQUIRE(list.Get("a") == "3");
+    auto result = list.Scan("a", "z");
+    REQUIRE(result.size() == 2);
+    REQUIRE(result[0] == std::make_pair(std::string("a"), std::string("3")));
+    REQUIRE(result[1] == std::make_pair(std::string("b"), std::string("1")));
+}
+
+TEST_CASE("Skiplist concurrent inserts", "[skiplist]") {
+    constexpr uint64_t kThreads = 8;
+    constexpr uint64_t kPerThread = 5000;
+    p1::ConcurrentSkipList<uint64_t, uint64_t> list;
+
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < kThreads; t++) {
+        threads.emplace_back([&list, t] {
+            // Interleave the key ranges so that the threads fight over the same splices
+            for (uint64_t i = 0; i < kPerThread; i++) {
+                list.Put(i * kThreads + t, t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(list.GetSize() == kThreads * kPerThread);
+    uint64_t expected = 0;
+    bool ordered = true;
+    list.InOrderTraversal([&](const uint64_t& key, const uint64_t& value) {
+        ordered = ordered && key == expected && value == key % kThreads;
+        expected++;
+        return true;
+    });
+    REQUIRE(ordered);
+    REQUIRE(expected == kThreads * kPerThread);
+}
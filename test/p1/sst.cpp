@@ -0,0 +1,445 @@
+#include "catch/catch.hpp"
+#include "p1/buffer_pool.hpp"
+#include "p1/io_engine.hpp"
+#include "p1/memtable.hpp"
+#include "p1/sst.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+std::string TempPath(const std::string& Name) {
+    return (std::filesystem::temp_directory_path() / (Name + "." + std::to_string(::getpid()))).string();
+}
+
+}
+
+TEST_CASE("SST round trip with fixed width entries", "[sst]") {
+    const std::string path = TempPath("sst_fixed");
+    constexpr uint64_t kEntries = 10000;
+
+    p1::SSTWriter<uint64_t, uint64_t> writer(path);
+    for (uint64_t i = 0; i < kEntries; i++) {
+        writer.Add(i * 2, i);
+    }
+    writer.Finish();
+    REQUIRE(writer.GetPageCount() > 1);
+    REQUIRE(std::filesystem::file_size(path) == writer.GetFileSize());
+    REQUIRE_THROWS_AS(writer.Add(0, 0), std::invalid_argument);
+
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    REQUIRE(reader.GetEntryCount() == kEntries);
+    REQUIRE(reader.GetMinKey() == 0);
+    REQUIRE(reader.GetMaxKey() == (kEntries - 1) * 2);
+
+    for (uint64_t i = 0; i < kEntries; i += 7) {
+        REQUIRE(reader.Get(i * 2) == i);
+        REQUIRE_FALSE(reader.Get(i * 2 + 1).has_value());
+    }
+    REQUIRE_FALSE(reader.Get(kEntries * 2).has_value());
+
+    // Crosses several page boundaries
+    auto result = reader.Scan(101, 3001);
+    REQUIRE(result.size() == 1450);
+    REQUIRE(result.front().first == 102);
+    REQUIRE(result.back().first == 3000);
+
+    uint64_t seen = 0;
+    reader.Scan(0, kEntries * 2, [&](const uint64_t&, const uint64_t&) { return ++seen < 5; });
+    REQUIRE(seen == 5);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST flushed from a memtable with string entries", "[sst]") {
+    const std::string path = TempPath("sst_string");
+    p1::Memtable<std::string, std::string> memtable(1 << 20);
+    for (int i = 0; i < 2000; i++) {
+        memtable.Put("key" + std::to_string(i), std::string(i % 50, 'v'));
+    }
+
+    REQUIRE(p1::FlushMemtable(memtable, path) == 2000);
+
+    p1::SSTReader<std::string, std::string> reader(path);
+    REQUIRE(reader.GetMinKey() == "key0");
+    REQUIRE(reader.GetMaxKey() == "key999");
+    REQUIRE(reader.Get("key1234") == std::string(1234 % 50, 'v'));
+    REQUIRE_FALSE(reader.Get("key").has_value());
+    // key10, key100-key109, key1000-key1099 and key11
+    REQUIRE(reader.Scan("key10", "key11").size() == 112);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST prefix compressed pages", "[sst]") {
+    const std::string path = TempPath("sst_prefix");
+    const std::string flatPath = TempPath("sst_prefix_flat");
+    // tenant/table/row keys, consecutive keys share most of their bytes
+    auto key = [](int I) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "tenant%02d/table%d/row%08d", I / 3000, I / 1000 % 3, I % 1000 * 7);
+        return std::string(buffer);
+    };
+    p1::Memtable<std::string, std::string> memtable(16 << 20);
+    for (int i = 0; i < 30000; i++) {
+        if (i % 11 == 0) {
+            memtable.Delete(key(i));
+        } else {
+            memtable.Put(key(i), std::to_string(i));
+        }
+    }
+    p1::FlushMemtable(memtable, flatPath);
+
+    for (size_t interval : {1, 3, 16}) {
+        p1::FlushMemtable(memtable, path, {10, true, false, interval});
+        // With every key a restart point nothing is shared, and the entries are longer than flat ones
+        if (interval > 1) {
+            REQUIRE(std::filesystem::file_size(path) < std::filesystem::file_size(flatPath));
+        }
+
+        p1::SSTReader<std::string, std::string> flat(flatPath);
+        p1::SSTReader<std::string, std::string> reader(path);
+        REQUIRE(reader.GetEntryCount() == 30000);
+        REQUIRE(reader.GetMinKey() == key(0));
+        for (int i = 0; i < 30000; i += 7) {
+            REQUIRE(reader.Get(key(i)) == memtable.Get(key(i)));
+            // Between two keys and before and after the whole run of a page
+            REQUIRE_FALSE(reader.Get(key(i) + "!").has_value());
+        }
+        REQUIRE_FALSE(reader.Get("tenant").has_value());
+        REQUIRE_FALSE(reader.Get("tenant99").has_value());
+        std::string value;
+        REQUIRE(reader.Lookup(key(11), &value) == p1::LookupStatus::kDeleted);
+
+        REQUIRE(reader.Scan(key(0), key(29999)) == flat.Scan(key(0), key(29999)));
+        REQUIRE(reader.Scan(key(1234) + "!", key(5678)) == flat.Scan(key(1234) + "!", key(5678)));
+        auto it = reader.NewIterator();
+        auto flatIt = flat.NewIterator();
+        size_t entries = 0;
+        for (it->Seek(key(20000)), flatIt->Seek(key(20000)); it->Valid(); it->Next(), flatIt->Next()) {
+            REQUIRE(it->Key() == flatIt->Key());
+            REQUIRE(it->IsDeleted() == flatIt->IsDeleted());
+            REQUIRE(it->Value() == flatIt->Value());
+            entries++;
+        }
+        REQUIRE_FALSE(flatIt->Valid());
+        REQUIRE(entries == 10000);
+    }
+
+    // Without an index lookups binary search over the first keys of the pages
+    p1::FlushMemtable(memtable, path, {10, false, false, 16});
+    p1::SSTReader<std::string, std::string> binarySearch(path);
+    for (int i = 1; i < 30000; i += 997) {
+        REQUIRE(binarySearch.Get(key(i)) == memtable.Get(key(i)));
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(flatPath);
+}
+
+TEST_CASE("SST tombstones", "[sst]") {
+    const std::string path = TempPath("sst_tombstones");
+    p1::Memtable<uint64_t, uint64_t> memtable(1 << 20);
+    for (uint64_t i = 0; i < 3000; i++) {
+        if (i % 3 == 0) {
+            memtable.Delete(i);
+        } else {
+            memtable.Put(i, i * 10);
+        }
+    }
+    REQUIRE(p1::FlushMemtable(memtable, path) == 3000);
+
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    REQUIRE(reader.GetEntryCount() == 3000);
+    REQUIRE(reader.GetTombstoneCount() == 1000);
+    uint64_t value = 0;
+    REQUIRE(reader.Lookup(1500, &value) == p1::LookupStatus::kDeleted);
+    REQUIRE(reader.Lookup(1501, &value) == p1::LookupStatus::kFound);
+    REQUIRE(value == 15010);
+    REQUIRE(reader.Lookup(5000, &value) == p1::LookupStatus::kNotFound);
+    REQUIRE_FALSE(reader.Get(1500).has_value());
+    REQUIRE(reader.Scan(0, 2999).size() == 2000);
+
+    size_t deleted = 0;
+    size_t entries = 0;
+    auto it = reader.NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        entries++;
+        deleted += it->IsDeleted();
+        REQUIRE(it->IsDeleted() == (it->Key() % 3 == 0));
+    }
+    REQUIRE(entries == 3000);
+    REQUIRE(deleted == 1000);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST rejects entries and files it cannot handle", "[sst]") {
+    const std::string path = TempPath("sst_invalid");
+    {
+        p1::SSTWriter<std::string, std::string> writer(path);
+        REQUIRE_THROWS_AS(writer.Add("key", std::string(p1::kPageSize, 'x')), std::invalid_argument);
+    }
+    REQUIRE_THROWS_AS((p1::SSTReader<std::string, std::string>(path)), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST index lookups read one page per level", "[sst]") {
+    const std::string path = TempPath("sst_index");
+    const std::string flatPath = TempPath("sst_flat");
+    // 227 entries per data page and 227 children per index page, so this takes two index levels
+    constexpr uint64_t kEntries = 60000;
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        p1::SSTWriter<uint64_t, uint64_t> flat(flatPath, {10, false});
+        for (uint64_t i = 0; i < kEntries; i++) {
+            writer.Add(i * 2 + 1, i);
+            flat.Add(i * 2 + 1, i);
+        }
+        writer.Finish();
+        flat.Finish();
+        REQUIRE(writer.GetIndexLevels() == 2);
+        REQUIRE(flat.GetIndexLevels() == 0);
+    }
+
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    p1::SSTReader<uint64_t, uint64_t> pinned(path, nullptr, {true});
+    p1::SSTReader<uint64_t, uint64_t> binarySearch(flatPath);
+    REQUIRE(pinned.IsIndexPinned());
+    REQUIRE_FALSE(binarySearch.IsIndexPinned());
+
+    for (uint64_t i = 0; i < kEntries; i += 13) {
+        REQUIRE(reader.Get(i * 2 + 1) == i);
+        REQUIRE(pinned.Get(i * 2 + 1) == i);
+        REQUIRE(binarySearch.Get(i * 2 + 1) == i);
+    }
+
+    const uint64_t before = reader.GetPageReads();
+    const uint64_t pinnedBefore = pinned.GetPageReads();
+    const uint64_t binaryBefore = binarySearch.GetPageReads();
+    REQUIRE(reader.Get(77777) == 38888u);
+    REQUIRE(pinned.Get(77777) == 38888u);
+    REQUIRE(binarySearch.Get(77777) == 38888u);
+    REQUIRE(reader.GetPageReads() - before == 3);
+    REQUIRE(pinned.GetPageReads() - pinnedBefore == 1);
+    REQUIRE(binarySearch.GetPageReads() - binaryBefore > 3);
+
+    // Scans seek through the index, including from before the first key
+    for (auto* r : {&reader, &pinned, &binarySearch}) {
+        auto result = r->Scan(0, 10);
+        REQUIRE(result.size() == 5);
+        REQUIRE(result.front().first == 1);
+        result = r->Scan(50000, 60000);
+        REQUIRE(result.size() == 5000);
+        REQUIRE(result.front().first == 50001);
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(flatPath);
+}
+
+TEST_CASE("SST batched lookups read each page once", "[sst]") {
+    const std::string path = TempPath("sst_multi");
+    const std::string flatPath = TempPath("sst_multi_flat");
+    constexpr uint64_t kEntries = 60000;
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        p1::SSTWriter<uint64_t, uint64_t> flat(flatPath, {10, false});
+        for (uint64_t i = 0; i < kEntries; i++) {
+            if (i % 7 == 0) {
+                writer.AddTombstone(i * 2);
+                flat.AddTombstone(i * 2);
+            } else {
+                writer.Add(i * 2, i);
+                flat.Add(i * 2, i);
+            }
+        }
+        writer.Finish();
+        flat.Finish();
+    }
+
+    // Sorted, with keys that are missing, deleted, past the end and asked for twice
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < kEntries * 2 + 100; key += 1 + key % 37) {
+        keys.push_back(key);
+    }
+    keys.insert(keys.begin() + 100, keys[100]);
+
+    auto engine = p1::NewIOEngine(4);
+    p1::BufferPool pool(8);
+    p1::SSTReader<uint64_t, uint64_t> reader(path, nullptr, {true});
+    p1::SSTReader<uint64_t, uint64_t> pooled(path, &pool, {false, p1::SSTReadMode::kPread, engine.get()});
+    p1::SSTReader<uint64_t, uint64_t> mapped(path, nullptr, {true, p1::SSTReadMode::kMmap});
+    p1::SSTReader<uint64_t, uint64_t> direct(path, nullptr, {true, p1::SSTReadMode::kDirect, engine.get()});
+    p1::SSTReader<uint64_t, uint64_t> binarySearch(flatPath);
+    for (auto* r : {&reader, &pooled, &mapped, &direct, &binarySearch}) {
+        std::vector<p1::LookupStatus> statuses(keys.size(), p1::LookupStatus::kNotFound);
+        std::vector<uint64_t> values(keys.size());
+        statuses[1] = p1::LookupStatus::kDeleted;
+        r->MultiLookup(keys.data(), keys.size(), statuses.data(), values.data());
+        REQUIRE(statuses[1] == p1::LookupStatus::kDeleted);
+        for (size_t i = 2; i < keys.size(); i++) {
+            uint64_t value = 0;
+            REQUIRE(statuses[i] == r->Lookup(keys[i], &value));
+            if (statuses[i] == p1::LookupStatus::kFound) {
+                REQUIRE(values[i] == value);
+            }
+        }
+    }
+
+    // Ten keys on the first data page cost one read of it, the pinned index costs none
+    const std::vector<uint64_t> samePage = {0, 2, 4, 6, 8, 10, 12, 14, 16, 18};
+    std::vector<p1::LookupStatus> statuses(samePage.size(), p1::LookupStatus::kNotFound);
+    std::vector<uint64_t> values(samePage.size());
+    const uint64_t before = reader.GetPageReads();
+    reader.MultiLookup(samePage.data(), samePage.size(), statuses.data(), values.data());
+    REQUIRE(reader.GetPageReads() - before == 1);
+    REQUIRE(statuses[0] == p1::LookupStatus::kDeleted);
+    REQUIRE(statuses[9] == p1::LookupStatus::kFound);
+    REQUIRE(values[9] == 9);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(flatPath);
+}
+
+TEST_CASE("SST memory mapped reads", "[sst]") {
+    const std::string path = TempPath("sst_mmap");
+    constexpr uint64_t kEntries = 60000;
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        for (uint64_t i = 0; i < kEntries; i++) {
+            if (i % 10 == 3) {
+                writer.AddTombstone(i * 2);
+            } else {
+                writer.Add(i * 2, i);
+            }
+        }
+        writer.Finish();
+    }
+
+    // The mapping takes precedence over the pool, which never sees a page
+    p1::BufferPool pool(16);
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    p1::SSTReader<uint64_t, uint64_t> mapped(path, &pool, {false, p1::SSTReadMode::kMmap});
+    REQUIRE(mapped.IsMapped());
+    REQUIRE_FALSE(reader.IsMapped());
+
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < kEntries; i += 7) {
+        REQUIRE(mapped.Get(i * 2) == reader.Get(i * 2));
+        REQUIRE(mapped.Lookup(i * 2, &value) == reader.Lookup(i * 2, &value));
+        REQUIRE_FALSE(mapped.Get(i * 2 + 1).has_value());
+    }
+    const uint64_t before = mapped.GetPageReads();
+    REQUIRE(mapped.Get(77776) == 38888u);
+    REQUIRE(mapped.GetPageReads() - before == mapped.GetIndexLevels() + 1);
+
+    REQUIRE(mapped.Scan(0, kEntries * 2) == reader.Scan(0, kEntries * 2));
+    REQUIRE(mapped.Scan(50001, 60001) == reader.Scan(50001, 60001));
+
+    auto expected = reader.NewIterator();
+    auto it = mapped.NewIterator();
+    it->Seek(1001);
+    expected->Seek(1001);
+    for (; expected->Valid(); expected->Next(), it->Next()) {
+        REQUIRE(it->Valid());
+        REQUIRE(it->Key() == expected->Key());
+        REQUIRE(it->IsDeleted() == expected->IsDeleted());
+        REQUIRE(it->Value() == expected->Value());
+    }
+    REQUIRE_FALSE(it->Valid());
+    it->SeekToFirst();
+    REQUIRE(it->Key() == 0);
+
+    REQUIRE(pool.GetHits() + pool.GetMisses() == 0);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST direct I/O", "[sst]") {
+    const std::string path = TempPath("sst_direct");
+    constexpr uint64_t kEntries = 60000;
+    {
+        p1::SSTOptions options;
+        options.DirectIO_ = true;
+        p1::SSTWriter<uint64_t, uint64_t> writer(path, options);
+        for (uint64_t i = 0; i < kEntries; i++) {
+            writer.Add(i * 2, i);
+        }
+        writer.Finish();
+        REQUIRE(std::filesystem::file_size(path) == writer.GetFileSize());
+    }
+
+    // Whether the filesystem took O_DIRECT or the files fell back to buffered I/O, the results are the same
+    p1::BufferPool pool(16);
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    p1::SSTReader<uint64_t, uint64_t> direct(path, nullptr, {true, p1::SSTReadMode::kDirect});
+    p1::SSTReader<uint64_t, uint64_t> pooled(path, &pool, {false, p1::SSTReadMode::kDirect});
+    REQUIRE(direct.IsDirect() == pooled.IsDirect());
+    REQUIRE_FALSE(reader.IsDirect());
+
+    for (uint64_t i = 0; i < kEntries; i += 7) {
+        REQUIRE(direct.Get(i * 2) == i);
+        REQUIRE(pooled.Get(i * 2) == i);
+        REQUIRE_FALSE(direct.Get(i * 2 + 1).has_value());
+    }
+    REQUIRE(pool.GetMisses() > 0);
+
+    for (auto* r : {&direct, &pooled}) {
+        REQUIRE(r->Scan(0, kEntries * 2) == reader.Scan(0, kEntries * 2));
+        REQUIRE(r->Scan(50001, 60001) == reader.Scan(50001, 60001));
+        auto it = r->NewIterator();
+        uint64_t count = 0;
+        for (it->Seek(1001); it->Valid(); it->Next()) {
+            count++;
+        }
+        REQUIRE(count == kEntries - 501);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SST reads through an I/O engine", "[sst]") {
+    const std::string path = TempPath("sst_engine");
+    constexpr uint64_t kEntries = 60000;
+    {
+        p1::SSTWriter<uint64_t, uint64_t> writer(path);
+        for (uint64_t i = 0; i < kEntries; i++) {
+            writer.Add(i * 2, i);
+        }
+        writer.Finish();
+    }
+
+    auto engine = p1::NewIOEngine(4);
+    p1::SSTReader<uint64_t, uint64_t> reader(path);
+    for (p1::SSTReadMode mode : {p1::SSTReadMode::kPread, p1::SSTReadMode::kDirect, p1::SSTReadMode::kMmap}) {
+        p1::SSTReader<uint64_t, uint64_t> batched(path, nullptr, {false, mode, engine.get()});
+        REQUIRE(batched.Scan(0, kEntries * 2) == reader.Scan(0, kEntries * 2));
+        REQUIRE(batched.Scan(50001, 60001) == reader.Scan(50001, 60001));
+        auto it = batched.NewIterator();
+        uint64_t count = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            count += it->Value() == count;
+        }
+        REQUIRE(count == kEntries);
+
+        // Pages in any order, one of them twice
+        const uint64_t pageNos[] = {7, 0, batched.GetPageCount() - 1, 7, 100};
+        p1::AlignedBuffer pages(5 * p1::kPageSize);
+        const uint64_t before = batched.GetPageReads();
+        batched.ReadPages(pageNos, 5, pages.Data());
+        REQUIRE(batched.GetPageReads() - before == 5);
+        for (size_t i = 0; i < 5; i++) {
+            p1::DataPageView<uint64_t, uint64_t> view(pages.Data() + i * p1::kPageSize);
+            const uint64_t first = view.KeyAt(0);
+            REQUIRE(reader.Scan(first, first + 2 * view.Count() - 2).size() == view.Count());
+        }
+        REQUIRE(p1::DataPageView<uint64_t, uint64_t>(pages.Data()).KeyAt(0) ==
+                p1::DataPageView<uint64_t, uint64_t>(pages.Data() + 3 * p1::kPageSize).KeyAt(0));
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,171 @@
+#include "catch/catch.hpp"
+#include "p1/memtable.hpp"
+#include "p1/wal.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::string TempPath(const std::string& Name) {
+    return (std::filesystem::temp_directory_path() / (Name + "." + std::to_string(::getpid()))).string();
+}
+
+std::vector<std::string> ReadAll(const std::string& Path) {
+    std::vector<std::string> records;
+    p1::ReadLog(Path, [&records](std::string_view Payload) { records.emplace_back(Payload); });
+    return records;
+}
+
+}
+
+TEST_CASE("WAL records round trip", "[wal]") {
+    const std::string path = TempPath("wal_basic");
+    auto policy = GENERATE(p1::WALSyncPolicy::kEveryWrite, p1::WALSyncPolicy::kInterval, p1::WALSyncPolicy::kNone);
+    {
+        p1::WriteAheadLog log(path, {policy, 1});
+        log.AddRecord("first");
+        log.AddRecord("");
+        log.AddRecord(std::string(10000, 'x'));
+        const uint64_t sequence = log.Append("buffered");
+        REQUIRE(sequence == 4);
+        REQUIRE(log.GetRecords() == 4);
+        log.Close();
+        REQUIRE_THROWS_AS(log.Append("closed"), std::logic_error);
+    }
+    // A 0 ms interval would keep syncing nonstop, it is rejected before the old log is truncated
+    REQUIRE_THROWS_AS(p1::WriteAheadLog(path, {p1::WALSyncPolicy::kInterval, 0}), std::invalid_argument);
+    REQUIRE(ReadAll(path) == std::vector<std::string>{"first", "", std::string(10000, 'x'), "buffered"});
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("WAL group commit from many writers", "[wal]") {
+    const std::string path = TempPath("wal_group");
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 200;
+    {
+        p1::WriteAheadLog log(path);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++) {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < kPerThread; i++) {
+                    log.AddRecord(std::to_string(t) + ":" + std::to_string(i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(log.GetRecords() == kThreads * kPerThread);
+        // Every write was synced, and never more than once per record
+        REQUIRE(log.GetSyncs() == log.GetWrites());
+        REQUIRE(log.GetWrites() <= log.GetRecords());
+    }
+
+    // Each writer's records come back in the order it wrote them
+    const auto records = ReadAll(path);
+    REQUIRE(records.size() == kThreads * kPerThread);
+    std::vector<int> next(kThreads, 0);
+    for (const auto& record : records) {
+        const int thread = std::stoi(record.substr(0, record.find(':')));
+        REQUIRE(std::stoi(record.substr(record.find(':') + 1)) == next[thread]++);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("WAL reading stops at a torn or corrupt record", "[wal]") {
+    const std::string path = TempPath("wal_torn");
+    {
+        p1::WriteAheadLog log(path);
+        for (int i = 0; i < 10; i++) {
+            log.AddRecord("record " + std::to_string(i));
+        }
+    }
+    const uint64_t size = std::filesystem::file_size(path);
+
+    SECTION("Torn tail") {
+        std::filesystem::resize_file(path, size - 3);
+        REQUIRE(ReadAll(path).size() == 9);
+        std::filesystem::resize_file(path, size - 3 - 16);
+        REQUIRE(ReadAll(path).size() == 8);
+    }
+
+    SECTION("Flipped byte") {
+        p1::File file(path, O_RDWR);
+        // Each record is 8 bytes of header and 8 bytes of payload, hit the payload of the fifth one
+        const char junk = '#';
+        file.Write(&junk, 1, 4 * 16 + 8 + 2);
+        REQUIRE(ReadAll(path).size() == 4);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("WAL replay rebuilds a memtable", "[wal]") {
+    const std::string path = TempPath("wal_replay");
+    {
+        p1::WriteAheadLog log(path);
+        for (uint64_t i = 0; i < 100; i++) {
+            // Several entries per record, the way a batch would be logged
+            std::string record;
+            p1::EncodeLogPut(&record, "key" + std::to_string(i), "value" + std::to_string(i));
+            p1::EncodeLogPut(&record, "other" + std::to_string(i), std::to_string(i));
+            log.AddRecord(record);
+        }
+    }
+
+    p1::Memtable<std::string, std::string> memtable(1 << 20);
+    REQUIRE(p1::ReplayLog(path, memtable) == 200);
+    for (uint64_t i = 0; i < 100; i++) {
+        REQUIRE(memtable.Get("key" + std::to_string(i)) == "value" + std::to_string(i));
+        REQUIRE(memtable.Get("other" + std::to_string(i)) == std::to_string(i));
+    }
+
+    SECTION("Deletes are replayed as tombstones") {
+        const std::string deletePath = TempPath("wal_replay_delete");
+        {
+            p1::WriteAheadLog log(deletePath);
+            std::string record;
+            p1::EncodeLogPut(&record, std::string("a"), std::string("1"));
+            p1::EncodeLogDelete(&record, std::string("a"));
+            p1::EncodeLogDelete(&record, std::string("b"));
+            log.AddRecord(record);
+        }
+        p1::Memtable<std::string, std::string> replayed(1 << 20);
+        REQUIRE(p1::ReplayLog(deletePath, replayed) == 3);
+        REQUIRE_FALSE(replayed.Get("a").has_value());
+        REQUIRE(replayed.GetTombstoneCount() == 2);
+        std::filesystem::remove(deletePath);
+    }
+
+    SECTION("Lengths that run past the record are rejected") {
+        std::string record;
+        p1::EncodeLogPut(&record, std::string("a"), std::string("1"));
+        auto decode = [](const std::string& Record) {
+            p1::DecodeLogEntries<std::string, std::string>(Record, [](const std::string&, const std::string*) {});
+        };
+        decode(record);
+        // [type][key length]["a"][value length]["1"], the value claims 100 bytes
+        std::string tooLong = record;
+        tooLong[3] = 100;
+        REQUIRE_THROWS_AS(decode(tooLong), std::runtime_error);
+        // A length varint cut off by the end of the record
+        std::string cutOff = record.substr(0, 3) + std::string(1, '\x80');
+        REQUIRE_THROWS_AS(decode(cutOff), std::runtime_error);
+        // A fixed width key with bytes missing
+        std::string shortKey;
+        p1::EncodeLogDelete(&shortKey, uint64_t{7});
+        shortKey.pop_back();
+        auto decodeFixed = [](const std::string& Record) {
+            p1::DecodeLogEntries<uint64_t, uint64_t>(Record, [](const uint64_t&, const uint64_t*) {});
+        };
+        REQUIRE_THROWS_AS(decodeFixed(shortKey), std::runtime_error);
+    }
+
+    p1::Memtable<std::string, std::string> tooSmall(1024);
+    REQUIRE_THROWS_AS(p1::ReplayLog(path, tooSmall), std::runtime_error);
+    std::filesystem::remove(path);
+}